@@ -0,0 +1,17 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+// uploaded once per frame by the forward renderer
+layout(std140) uniform CameraData
+{
+    mat4 u_viewMatrix;
+    mat4 u_projMatrix;
+};
@@ -22,6 +22,9 @@ For more information see the LICENSE file
 #define SHADOW_SOFT 2
 #define SHADOW_VERYSOFT 3
 
+#pragma include <camera_data.glsl>
+#pragma include <scene_data.glsl>
+
 uniform sampler2D u_diffuseTexture;
 uniform bool u_useDiffuseTex;
 
@@ -43,7 +46,6 @@ in vec3 v_normal;
 in vec3 v_worldPos;
 in mat3 v_tanToWorld;
 
-const int MAX_LIGHTS = 8;
 const int TYPE_POINT = 0;
 const int TYPE_DIRECTIONAL = 1;
 const int TYPE_SPOT = 2;
@@ -56,42 +58,23 @@ const int TYPE_SPOT = 2;
 //in vec4 FragPosLightSpace;
 //uniform sampler2D u_shadowMap;
 //uniform bool u_shadowEnabled;
-struct Light {
-    int type;
-    vec3 position;
-    vec3 ambient;
-    vec4 color;
-    float distance;
-    float intensity;
-    vec3 direction;
-    float cutOffAngle;
-    float cutOffSoftness;
-
-	vec4 shadowColor;
-	float shadowAlpha;
-
-    sampler2D shadowMap;
-    bool shadowEnabled;
-    int shadowType;
-    mat4 shadowMatrix;
-};
 
-float SampleShadowMap(in sampler2D shadowMap, vec2 coords, float compare) {
+float SampleShadowMap(in sampler2DArray shadowMap, vec2 coords, float layer, float compare) {
     if (coords.x < 0.0 || coords.x > 1.0 || coords.y < 0.0 || coords.y > 1.0)
         return 1.0;
-    return step(compare, texture(shadowMap, coords.xy).r);
+    return step(compare, texture(shadowMap, vec3(coords.xy, layer)).r);
 }
 
-// todo: use sampler2DShadow, it does the same thing but faster
-float SampleShadowMapLinear(sampler2D shadowMap, vec2 coords, float compare, vec2 texelSize) {
+// todo: use sampler2DArrayShadow, it does the same thing but faster
+float SampleShadowMapLinear(sampler2DArray shadowMap, vec2 coords, float layer, float compare, vec2 texelSize) {
     vec2 pixelPos = coords / texelSize + vec2(0.5);
     vec2 fracPart = fract(pixelPos);
     vec2 startTexel = (pixelPos - fracPart) * texelSize;
 
-    float blTexel = SampleShadowMap(shadowMap, startTexel, compare);
-    float brTexel = SampleShadowMap(shadowMap, startTexel + vec2(texelSize.x, 0.0), compare);
-    float tlTexel = SampleShadowMap(shadowMap, startTexel + vec2(0.0, texelSize.y), compare);
-    float trTexel = SampleShadowMap(shadowMap, startTexel + texelSize, compare);
+    float blTexel = SampleShadowMap(shadowMap, startTexel, layer, compare);
+    float brTexel = SampleShadowMap(shadowMap, startTexel + vec2(texelSize.x, 0.0), layer, compare);
+    float tlTexel = SampleShadowMap(shadowMap, startTexel + vec2(0.0, texelSize.y), layer, compare);
+    float trTexel = SampleShadowMap(shadowMap, startTexel + texelSize, layer, compare);
 
     float mixA = mix(blTexel, tlTexel, fracPart.y);
     float mixB = mix(brTexel, trTexel, fracPart.y);
@@ -99,7 +82,7 @@ float SampleShadowMapLinear(sampler2D shadowMap, vec2 coords, float compare, vec
     return mix(mixA, mixB, fracPart.x);
 }
 
-float SampleShadowMapPCF(in sampler2D shadowMap, vec2 coords, float compare, vec2 texelSize) {
+float SampleShadowMapPCF(in sampler2DArray shadowMap, vec2 coords, float layer, float compare, vec2 texelSize) {
     float result = 0;
 
     const float NUM_SAMPLES = 7.0;
@@ -108,7 +91,7 @@ float SampleShadowMapPCF(in sampler2D shadowMap, vec2 coords, float compare, vec
     for(float y = -SAMPLES_START; y <= SAMPLES_START; y++) {
         for(float x = -SAMPLES_START; x <= SAMPLES_START; x++) {
             vec2 offset = vec2(x, y) * texelSize;
-            result += SampleShadowMapLinear(shadowMap, coords + offset, compare, texelSize);
+            result += SampleShadowMapLinear(shadowMap, coords + offset, layer, compare, texelSize);
         }
     }
 
@@ -116,7 +99,7 @@ float SampleShadowMapPCF(in sampler2D shadowMap, vec2 coords, float compare, vec
 }
 
 // it's technically 4x4...but it will do for now
-float SampleShadowMapPCF3x3(in sampler2D shadowMap, vec2 coords, float compare, vec2 texelSize) {
+float SampleShadowMapPCF3x3(in sampler2DArray shadowMap, vec2 coords, float layer, float compare, vec2 texelSize) {
     float result = 0;
 
     const float NUM_SAMPLES = 3.0;
@@ -125,69 +108,71 @@ float SampleShadowMapPCF3x3(in sampler2D shadowMap, vec2 coords, float compare,
     for(float y = -SAMPLES_START; y <= SAMPLES_START; y++) {
         for(float x = -SAMPLES_START; x <= SAMPLES_START; x++) {
             vec2 offset = vec2(x, y) * texelSize;
-            result += SampleShadowMapLinear(shadowMap, coords + offset, compare, texelSize);
+            result += SampleShadowMapLinear(shadowMap, coords + offset, layer, compare, texelSize);
         }
     }
 
     return result / (NUM_SAMPLES * NUM_SAMPLES);
 }
 
-
-float CalcShadowMap(in sampler2D shadowMap, vec4 fragPosLightSpace) {
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    projCoords = projCoords * 0.5 + 0.5;
-    vec2 texelSize = 1.0 / textureSize(shadowMap, 0);
-    return SampleShadowMapPCF(shadowMap, projCoords.xy, projCoords.z, texelSize);
-}
-
-float calcVerySoftShadowMap(in Light light, in vec4 lightSpacePos)
+float calcVerySoftShadowMap(in sampler2DArray shadowMap, in vec3 projCoords, float layer)
 {
-    return CalcShadowMap(light.shadowMap, lightSpacePos);
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
+    return SampleShadowMapPCF(shadowMap, projCoords.xy, layer, projCoords.z, texelSize);
 }
 
-float calcSoftShadowMap(in Light light, in vec4 fragPosLightSpace)
+float calcSoftShadowMap(in sampler2DArray shadowMap, in vec3 projCoords, float layer)
 {
-    vec3 projCoords = fragPosLightSpace.xyz / fragPosLightSpace.w;
-    projCoords = projCoords * 0.5 + 0.5;
-    vec2 texelSize = 1.0 / textureSize(light.shadowMap, 0);
-    return SampleShadowMapPCF3x3(light.shadowMap, projCoords.xy, projCoords.z, texelSize);
+    vec2 texelSize = 1.0 / textureSize(shadowMap, 0).xy;
+    return SampleShadowMapPCF3x3(shadowMap, projCoords.xy, layer, projCoords.z, texelSize);
 }
 
-float calcHardShadowMap(in Light light, in vec4 lightSpacePos)
+float calcHardShadowMap(in sampler2DArray shadowMap, in vec3 projCoords, float layer)
 {
-    vec3 projCoords = lightSpacePos.xyz / lightSpacePos.w;
-    projCoords = projCoords * 0.5 + 0.5;
-    //return SampleShadowMap(light.shadowMap,projCoords.xy,projCoords.z);
     if (projCoords.x < 0.0 || projCoords.x > 1.0 || projCoords.y < 0.0 || projCoords.y > 1.0)
         return 1.0;
-    if (projCoords.z > texture(light.shadowMap, projCoords.xy).r)
+    if (projCoords.z > texture(shadowMap, vec3(projCoords.xy, layer)).r)
         return 0.0;
     return 1.0;
 }
 
 
 //  Handles shadowing for lights with different shadowing types
-float calculateShadowFactor(in Light light, in vec3 worldPos)
+//  The first cascade that covers the fragment is used, they're ordered from the
+//  most detailed to the least. Fragments past the last cascade aren't shadowed
+float calculateShadowFactor(in Light light, in sampler2DArray shadowMap, in vec3 worldPos)
 {
-    vec4 lightSpacePos = light.shadowMatrix * vec4(v_worldPos, 1.0);
-    if (light.shadowType==SHADOW_HARD)
-        return calcHardShadowMap(light, lightSpacePos);
-    if (light.shadowType==SHADOW_SOFT)
-        return calcSoftShadowMap(light, lightSpacePos);
-	if (light.shadowType==SHADOW_VERYSOFT)
-        return calcVerySoftShadowMap(light, lightSpacePos);
-    return 1.0f;
-}
-
+    if (light.shadowType == SHADOW_NONE)
+        return 1.0;
 
+    // the filters read a few texels around the fragment so those have to be in the cascade too
+    float margin = 4.0 / textureSize(shadowMap, 0).x;
+
+    for (int c = 0; c < light.cascadeCount; c++) {
+        vec4 lightSpacePos = light.shadowMatrices[c] * vec4(worldPos, 1.0);
+        vec3 projCoords = (lightSpacePos.xyz / lightSpacePos.w) * 0.5 + 0.5;
+
+        bool lastCascade = c == light.cascadeCount - 1;
+        if (!lastCascade && (any(lessThan(projCoords.xy, vec2(margin))) ||
+                             any(greaterThan(projCoords.xy, vec2(1.0 - margin)))))
+            continue;
+        if (projCoords.z > 1.0)
+            continue;
+
+        float layer = float(c);
+        if (light.shadowType==SHADOW_HARD)
+            return calcHardShadowMap(shadowMap, projCoords, layer);
+        if (light.shadowType==SHADOW_SOFT)
+            return calcSoftShadowMap(shadowMap, projCoords, layer);
+        if (light.shadowType==SHADOW_VERYSOFT)
+            return calcVerySoftShadowMap(shadowMap, projCoords, layer);
+        return 1.0;
+    }
 
-uniform sampler2D shadowMaps[MAX_LIGHTS];
+    return 1.0;
+}
 
-uniform Light u_lights[MAX_LIGHTS];
-uniform int u_lightCount;
 
-uniform vec3 u_eyePos;
-uniform vec3 u_sceneAmbient; 
 
 struct Material
 {
@@ -201,16 +186,6 @@ struct Material
 
 uniform Material u_material;
 
-struct Fog
-{
-    bool enabled;
-    float start;
-    float end;
-    vec4 color;
-};
-
-uniform Fog u_fogData;
-
 out vec4 fragColor;
 
 vec2 envMapEquirect(vec3 wcNormal, float flipEnvMap) {
@@ -224,6 +199,63 @@ vec2 envMapEquirect(vec3 wcNormal) {
     return envMapEquirect(wcNormal, -1.0);
 }
 
+// adds the light's diffuse and specular terms, radiance is its color times intensity
+// shadow is 0 where the fragment is fully in the light's shadow and 1 where it's lit
+void addLight(int type, vec3 position, float range, vec3 direction,
+              float cutOffAngle, float cutOffSoftness, vec3 radiance,
+              vec3 shadowColor, float shadow,
+              vec3 n, vec3 v, inout vec3 diffuse, inout vec3 specular)
+{
+    float ndl = 0.0;
+    vec3 lightDir = position-v_worldPos;//unnormlaized
+    vec3 l = normalize(lightDir);
+    float atten = 1.0;
+    float spotCutoff = 1.0;
+
+    if(type!=TYPE_DIRECTIONAL)//point and spot
+    {
+        ndl = max(dot(n,l),0.0);
+
+        if(ndl>0)
+        {
+            float lightDist = length(lightDir);
+
+            //atten = 1.0-smoothstep(0.0,range,lightDist);
+            atten = clamp((lightDist-range)/(-range),0.0,1.0);
+            atten = atten*atten;
+
+            //attenuation
+            //https://developer.valvesoftware.com/wiki/Constant-Linear-Quadratic_Falloff
+            //http://brabl.com/light-attenuation/
+            //http://gamedev.stackexchange.com/questions/56897/glsl-light-attenuation-color-and-intensity-formula
+        }
+
+        if(type==TYPE_SPOT)
+        {
+            float cos_angle = degrees(acos(dot(-l, direction)));
+            spotCutoff = clamp((cos_angle-cutOffAngle)/(-cutOffSoftness), 0.0, 1.0);
+            ndl = ndl*spotCutoff;
+        }
+    }
+    else
+    {
+        //directional
+        l = normalize(-direction);
+        ndl = max(dot(l, n),0.0);
+    }
+
+    float spec = 0.0;
+
+    if (ndl > 0.0 && u_material.shininess > 0.0) {
+        float normFactor = (u_material.shininess + 2.0) / 2.0;//todo: find a better alternative
+        vec3 r = reflect(-l, n);
+        spec = normFactor*pow(max(dot(r, v), 0.0), u_material.shininess)*spotCutoff;
+    }
+
+    diffuse += mix(shadowColor, atten*ndl*radiance, shadow);
+    specular += mix(shadowColor, atten*spec*radiance, shadow);
+}
+
 void main()
 {
     vec3 diffuse = vec3(0);
@@ -242,73 +274,33 @@ void main()
     }
 
     vec3 v = normalize(u_eyePos-v_worldPos);
-    float spotCutoff = 1.0;
+    vec3 n = normalize(normal);
 
     for(int i=0;i<u_lightCount;i++)
     {
-        float ndl = 0.0;
-        vec3 n = normalize(normal);
-        vec3 lightDir = u_lights[i].position-v_worldPos;//unnormlaized
-        vec3 l = normalize(lightDir);
-        float atten = 1.0;
-
-        if(u_lights[i].type!=TYPE_DIRECTIONAL)//point and spot
-        {
-            ndl = max(dot(n,l),0.0);
-
-            if(ndl>0)
-            {
-                float lightDist = length(lightDir);
-
-                //atten = 1.0-smoothstep(0.0,u_lights[i].distance,lightDist);
-                atten = clamp((lightDist-u_lights[i].distance)/(-u_lights[i].distance),0.0,1.0);
-                atten = atten*atten;
-
-                //attenuation
-                //https://developer.valvesoftware.com/wiki/Constant-Linear-Quadratic_Falloff
-                //http://brabl.com/light-attenuation/
-                //http://gamedev.stackexchange.com/questions/56897/glsl-light-attenuation-color-and-intensity-formula
-
-            }
-
-            if(u_lights[i].type==TYPE_SPOT)
-            {
-                float cos_angle = degrees(acos(dot(-l, u_lights[i].direction)));
-                spotCutoff = clamp((cos_angle-u_lights[i].cutOffAngle)/
-                                   (-u_lights[i].cutOffSoftness)
-                                  ,
-                                  0.0,1.0);
-                ndl = ndl*spotCutoff;
-            }
-
-
-        }
-        else
-        {
-            //directional
-            l = normalize(-u_lights[i].direction);
-            ndl = max(dot(l, n),0.0);
-        }
-
-        float spec = 0.0;
-
-        if (ndl > 0.0 && u_material.shininess > 0.0) {
-            float normFactor = (u_material.shininess + 2.0) / 2.0;//todo: find a better alternative
-            vec3 r = reflect(-l, n);
-            spec = normFactor*pow(max(dot(r, v), 0.0), u_material.shininess)*spotCutoff;
-            //spec = pow(max(dot(r, v), 0.0), 0.7f);
-        }
-
         //vec4 FragPosLightSpace = u_lights[i].shadowMatrix * vec4(v_worldPos, 1.0);
         //float shadowFactor = u_lights[i].shadowEnabled ? CalcShadowMap(u_lights[i].shadowMap,FragPosLightSpace) : 1.0;
-        float shadowFactor = calculateShadowFactor(u_lights[i], v_worldPos);
-
+        float shadowFactor = calculateShadowFactor(u_lights[i], u_shadowMaps[i], v_worldPos);
 		float shadow = mix(1.0, shadowFactor, u_lights[i].shadowAlpha);
-        diffuse += mix(u_lights[i].shadowColor.rgb, atten*ndl*u_lights[i].intensity*u_lights[i].color.rgb, shadow);
-        specular += mix(u_lights[i].shadowColor.rgb, atten*spec* u_lights[i].intensity * u_lights[i].color.rgb, shadow);
 
-		//diffuse += atten*ndl*u_lights[i].intensity*u_lights[i].color.rgb*shadowFactor;
-        //specular += atten*spec* u_lights[i].intensity * u_lights[i].color.rgb*shadowFactor;
+        addLight(u_lights[i].type, u_lights[i].position, u_lights[i].distance, u_lights[i].direction,
+                 u_lights[i].cutOffAngle, u_lights[i].cutOffSoftness,
+                 u_lights[i].intensity * u_lights[i].color.rgb,
+                 u_lights[i].shadowColor.rgb, shadow,
+                 n, v, diffuse, specular);
+    }
+
+    // the other lights only come from the fragment's cluster
+    float viewDepth = -(u_viewMatrix * vec4(v_worldPos, 1.0)).z;
+    ivec2 clusterLights = getClusterLightRange(getClusterIndex(gl_FragCoord.xy, viewDepth));
+    for(int i = clusterLights.x; i < clusterLights.x + clusterLights.y; i++)
+    {
+        ClusterLight light = getClusterLight(i);
+        addLight(light.type, light.position, light.distance, light.direction,
+                 light.cutOffAngle, light.cutOffSoftness,
+                 light.intensity * light.color,
+                 vec3(0.0), 1.0,
+                 n, v, diffuse, specular);
     }
 
     vec3 col = u_material.diffuse;
@@ -339,7 +331,7 @@ void main()
         finalColor = mix(finalColor,reflCol,u_reflectionInfluence);
     }
 
-    if(u_fogData.enabled)
+    if(u_receiveFog && u_fogData.enabled)
     {
         float zDist = length(v_worldPos-u_eyePos);
         float fogFactor = clamp((zDist-u_fogData.start)/(u_fogData.end-u_fogData.start),0,1);
@@ -0,0 +1,45 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+// vertex shaders that include this file can be drawn instanced
+// INSTANCED is defined by Shader::getInstancedShader
+#ifdef INSTANCED
+// 256 mat4s is the smallest uniform block size gl guarantees
+const int MAX_INSTANCES = 256;
+
+layout(std140) uniform InstanceData
+{
+    mat4 u_instanceMatrices[MAX_INSTANCES];
+};
+
+mat4 getWorldMatrix()
+{
+    return u_instanceMatrices[gl_InstanceID];
+}
+
+mat3 getNormalMatrix()
+{
+    return transpose(inverse(mat3(u_instanceMatrices[gl_InstanceID])));
+}
+#else
+uniform mat4 u_worldMatrix;
+uniform mat3 u_normalMatrix;
+
+mat4 getWorldMatrix()
+{
+    return u_worldMatrix;
+}
+
+mat3 getNormalMatrix()
+{
+    return u_normalMatrix;
+}
+#endif
@@ -17,9 +17,24 @@ in vec2 a_texCoord;
 out vec2 o_texCoord;
 
 uniform mat4 projectionMatrix;
-uniform mat4 modelViewMatrix;
+uniform mat4 viewMatrix;
+
+// each particle starts with position and scale, then rotation in degrees in w
+// the gpu simulation stores more state after that
+uniform samplerBuffer u_particles;
+uniform int u_texelsPerParticle;
 
 void main() {
-    gl_Position = projectionMatrix * modelViewMatrix * vec4(a_pos, 1.0);
+    int first = gl_InstanceID * u_texelsPerParticle;
+    vec4 posScale = texelFetch(u_particles, first);
+    float rotation = radians(texelFetch(u_particles, first + 1).w);
+
+    // the quad is rotated and scaled in view space so it always faces the camera
+    float c = cos(rotation);
+    float s = sin(rotation);
+    vec2 corner = mat2(c, s, -s, c) * a_pos.xy * posScale.w;
+
+    vec4 viewPos = viewMatrix * vec4(posScale.xyz, 1.0);
+    gl_Position = projectionMatrix * (viewPos + vec4(corner, 0.0, 0.0));
     o_texCoord = a_texCoord;
 }
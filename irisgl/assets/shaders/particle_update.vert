@@ -0,0 +1,129 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#version 150 core
+
+// simulates one particle per vertex, the results are captured with transform feedback
+// a particle is dead once its age passes its life and is respawned when the emitter reaches its slot
+
+in vec4 a_posScale;
+in vec4 a_velRot;
+// age, life, gravity effect
+in vec4 a_ageLife;
+
+out vec4 o_posScale;
+out vec4 o_velRot;
+out vec4 o_ageLife;
+
+uniform float u_delta;
+uniform int u_capacity;
+// slots [u_emitStart, u_emitStart + u_emitCount) wrapped around u_capacity are respawned
+uniform int u_emitStart;
+uniform int u_emitCount;
+uniform uint u_seed;
+
+uniform vec3 u_emitterPos;
+uniform vec3 u_boundDimension;
+uniform vec3 u_direction;
+
+uniform float u_speed;
+uniform float u_speedError;
+uniform float u_particleScale;
+uniform float u_scaleError;
+uniform float u_lifeLength;
+uniform float u_lifeError;
+uniform float u_gravity;
+
+uniform bool u_randomRotation;
+uniform bool u_dissipate;
+uniform bool u_dissipateInv;
+
+const float GRAVITY = -50.0;
+const float PI = 3.14159265358979323846;
+
+uint rngState;
+
+// https://nullprogram.com/blog/2018/07/31/
+uint hash(uint x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352dU;
+    x ^= x >> 15;
+    x *= 0x846ca68bU;
+    x ^= x >> 16;
+    return x;
+}
+
+// random value between 0 and 1
+float random()
+{
+    rngState = hash(rngState);
+    return float(rngState) / 4294967295.0;
+}
+
+float generateValue(float average, float errorMargin)
+{
+    return average + (random() - 0.5) * 2.0 * errorMargin;
+}
+
+vec3 generateRandomUnitVector()
+{
+    float theta = random() * 2.0 * PI;
+    float z = random() * 2.0 - 1.0;
+    float rootOneMinusZSquared = sqrt(1.0 - z * z);
+    return vec3(rootOneMinusZSquared * cos(theta), rootOneMinusZSquared * sin(theta), z);
+}
+
+void main()
+{
+    vec3 pos = a_posScale.xyz;
+    float scale = a_posScale.w;
+    vec3 vel = a_velRot.xyz;
+    float rotation = a_velRot.w;
+    float age = a_ageLife.x;
+    float life = a_ageLife.y;
+    float gravityEffect = a_ageLife.z;
+
+    int slot = gl_VertexID;
+    if ((slot - u_emitStart + u_capacity) % u_capacity < u_emitCount) {
+        rngState = hash(uint(slot) ^ hash(u_seed));
+
+        vel = u_direction * generateValue(u_speed, u_speedError);
+        scale = generateValue(u_particleScale, u_scaleError);
+        life = generateValue(u_lifeLength, u_lifeError);
+        pos = u_emitterPos + u_boundDimension * generateRandomUnitVector();
+        rotation = u_randomRotation ? random() * 360.0 : 0.0;
+        gravityEffect = u_gravity;
+        age = 0.0;
+    }
+
+    if (age < life) {
+        vel.y += GRAVITY * gravityEffect * u_delta;
+        pos += vel * u_delta;
+        age += u_delta;
+
+        if (u_dissipate && age > 0.0) {
+            if (u_dissipateInv) {
+                scale = u_particleScale * (age / life);
+            } else {
+                scale *= 1.0 - (age / life);
+            }
+        }
+    }
+
+    // dead particles are drawn with no size
+    if (age > life)
+        scale = 0.0;
+
+    o_posScale = vec4(pos, scale);
+    o_velRot = vec4(vel, rotation);
+    o_ageLife = vec4(age, life, gravityEffect, 0.0);
+}
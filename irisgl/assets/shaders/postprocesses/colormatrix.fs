@@ -0,0 +1,13 @@
+#version 150
+
+in vec2 v_texCoord;
+
+uniform sampler2D u_sceneTexture;
+uniform mat4 u_colorMatrix;
+
+out vec4 fragColor;
+
+void main()
+{
+	fragColor = u_colorMatrix * texture(u_sceneTexture, v_texCoord);
+}
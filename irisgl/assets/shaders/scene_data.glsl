@@ -0,0 +1,120 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+// uploaded once per frame by the forward renderer
+// the layout has to match SceneUniformData in forwardrenderer.cpp
+
+// directional and shadowed spot lights, other lights are in the clusters
+const int MAX_LIGHTS = 6;
+// has to match SHADOW_MAX_CASCADES in shadowmap.h
+const int MAX_CASCADES = 4;
+
+struct Light {
+    vec3 position;
+    float distance;
+    vec3 direction;
+    float intensity;
+    vec4 color;
+    vec4 shadowColor;
+    // spot lights only have one, directional lights have one per cascade
+    mat4 shadowMatrices[MAX_CASCADES];
+    int type;
+    float cutOffAngle;
+    float cutOffSoftness;
+    float shadowAlpha;
+    int shadowType;
+    int cascadeCount;
+};
+
+struct Fog
+{
+    bool enabled;
+    float start;
+    float end;
+    vec4 color;
+};
+
+layout(std140) uniform SceneData
+{
+    vec3 u_eyePos;
+    float u_time;
+    vec3 u_sceneAmbient;
+    int u_lightCount;
+    Fog u_fogData;
+    // tiles across, tiles down and depth slices of the light clusters
+    ivec4 u_clusterCount;
+    // x, y, width and height of the viewport in pixels
+    vec4 u_clusterViewport;
+    // scale and bias mapping view depth to a slice, z is 1 if the depth is logarithmic
+    vec4 u_clusterDepth;
+    Light u_lights[MAX_LIGHTS];
+};
+
+// samplers cant be put in a uniform block
+// each light's cascades are layers of its shadow map
+uniform sampler2DArray u_shadowMaps[MAX_LIGHTS];
+
+// fog can be turned off per object
+uniform bool u_receiveFog;
+
+// four texels per light, see LightClusters::build
+uniform samplerBuffer u_clusterLights;
+// an offset and count per cluster followed by the light indices they point into
+uniform usamplerBuffer u_clusterData;
+
+struct ClusterLight {
+    vec3 position;
+    float distance;
+    vec3 direction;
+    float intensity;
+    vec3 color;
+    int type;
+    float cutOffAngle;
+    float cutOffSoftness;
+};
+
+// viewDepth is the fragment's distance in front of the camera
+int getClusterIndex(vec2 fragCoord, float viewDepth)
+{
+    vec2 tile = (fragCoord - u_clusterViewport.xy) / u_clusterViewport.zw * vec2(u_clusterCount.xy);
+    float depth = u_clusterDepth.z > 0.5 ? log(max(viewDepth, 0.0001)) : viewDepth;
+    int slice = int(floor(depth * u_clusterDepth.x + u_clusterDepth.y));
+
+    ivec3 cluster = clamp(ivec3(ivec2(tile), slice), ivec3(0), u_clusterCount.xyz - 1);
+    return (cluster.z * u_clusterCount.y + cluster.y) * u_clusterCount.x + cluster.x;
+}
+
+// returns the offset of the cluster's light indices in u_clusterData in x and their count in y
+ivec2 getClusterLightRange(int cluster)
+{
+    return ivec2(texelFetch(u_clusterData, cluster * 2).r,
+                 texelFetch(u_clusterData, cluster * 2 + 1).r);
+}
+
+ClusterLight getClusterLight(int index)
+{
+    int lightIndex = int(texelFetch(u_clusterData, index).r);
+    vec4 t0 = texelFetch(u_clusterLights, lightIndex * 4);
+    vec4 t1 = texelFetch(u_clusterLights, lightIndex * 4 + 1);
+    vec4 t2 = texelFetch(u_clusterLights, lightIndex * 4 + 2);
+    vec4 t3 = texelFetch(u_clusterLights, lightIndex * 4 + 3);
+
+    ClusterLight light;
+    light.position = t0.xyz;
+    light.distance = t0.w;
+    light.direction = t1.xyz;
+    light.intensity = t1.w;
+    light.color = t2.rgb;
+    light.type = int(t2.w);
+    light.cutOffAngle = t3.x;
+    light.cutOffSoftness = t3.y;
+    return light;
+}
@@ -14,8 +14,8 @@ For more information see the LICENSE file
 in vec3 a_pos;
 
 uniform mat4 u_lightSpaceMatrix;
-uniform mat4 u_worldMatrix;
+#pragma include <instancing.glsl>
 
 void main() {
-    gl_Position = u_lightSpaceMatrix * u_worldMatrix * vec4(a_pos, 1.0);
+    gl_Position = u_lightSpaceMatrix * getWorldMatrix() * vec4(a_pos, 1.0);
 }
@@ -19,8 +19,7 @@ in vec4 a_boneWeights;
 in vec4 a_boneIndices;
 
 uniform mat4 matrix;
-uniform mat4 u_viewMatrix;
-uniform mat4 u_projMatrix;
+#pragma include <camera_data.glsl>
 uniform mat4 u_worldMatrix;
 uniform mat3 u_normalMatrix;
 uniform float u_textureScale;
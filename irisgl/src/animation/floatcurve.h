@@ -1,22 +1,27 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
 #ifndef FLOATCURVE_H
 #define FLOATCURVE_H
 
-namespace iris
-{
+#include <QString>
+#include <QVector>
 
+#include <algorithm>
 
-enum class TangentType
-{
-    Free,
-    Linear,
-    Constant
-};
+#include "keyframeanimation.h"
+#include "../math/bezierhelper.h"
 
-enum class HandleMode
+namespace iris
 {
-    Joined,
-    Broken
-};
 
 class CurveKey
 {
@@ -32,37 +37,44 @@ public:
 
     HandleMode handleMode;
 
-    inline bool operator< ( const T& rhs)
+    CurveKey()
+    {
+        value = 0;
+        time = 0;
+        leftTangent = TangentType::Free;
+        rightTangent = TangentType::Free;
+        leftSlope = 0;
+        rightSlope = 0;
+        handleMode = HandleMode::Joined;
+    }
+
+    inline bool operator< (const CurveKey& rhs) const
     {
         return this->time < rhs.time;
     }
 };
 
-bool CurveKeyCompare(const CurveKey * const & a, const CurveKey * const & b)
-{
-   return a->time < b->time;
-}
-
-
+/**
+ * A curve of bezier keys
+ * Keys are stored by value and sorted by time so sampling is a search over one block of memory
+ */
 class FloatCurve
 {
 public:
     QString name;
-    std::vector<CurveKey*> keys;
+    QVector<CurveKey> keys;
     float length;
 
-    KeyFrame()
+    FloatCurve()
     {
         length = 10;//default value
+        cursor = 0;
     }
 
     void clear()
     {
-        for (size_t i=0;i<keys.size();i++)
-        {
-            delete keys[i];
-        }
         keys.clear();
+        cursor = 0;
     }
 
     float getLength()
@@ -83,26 +95,35 @@ public:
         //sort keys
         this->sortKeys();
         //get last key and use that to determine length
-        auto last = keys.end().c;
-        length = last->time;
+        length = keys.last().time;
     }
 
-    CurveKey* addKey(float value,float time)
+    /**
+     * Adds a key and returns its index
+     * Indices of the keys after it shift, so dont hold on to them across calls
+     */
+    int addKey(float value,float time)
     {
-        auto key = new CurveKey();
-        key->value = value;
-        key->time = time;
-        keys.push_back(key);
+        CurveKey key;
+        key.value = value;
+        key.time = time;
 
-        // if the new key's time isnt greater than the last key's time,
-        // do a sort
-        if(keys.size() >= 2 &&
-           keys[keys.size()-2]->time > keys[keys.size()-1]->time)
+        // keys are usually added in order so this is almost always an append
+        if(keys.isEmpty() || keys.last().time <= time)
         {
-            this->sortKeys();
+            keys.append(key);
+            return keys.size() - 1;
         }
 
-        return key;
+        auto iter = std::upper_bound(keys.begin(), keys.end(), key);
+        int index = int(iter - keys.begin());
+        keys.insert(index, key);
+        return index;
+    }
+
+    void removeKey(int index)
+    {
+        keys.remove(index);
     }
 
     bool hasKeys()
@@ -117,39 +138,46 @@ public:
 
     float getValueAt(float time, float defaultVal)
     {
-        CurveKey* leftKey = Q_NULLPTR;
-        CurveKey* rightKey = Q_NULLPTR;
+        int leftIndex = -1;
+        int rightIndex = -1;
 
-        //why bother with a copy?
-        float val = defaultVal;
+        this->getKeyFramesAtTime(leftIndex,rightIndex,time);
 
-        this->getKeyFramesAtTime(&leftKey,&rightKey,time);
+        if(leftIndex<0)
+            return defaultVal;
 
-        if(leftKey!=Q_NULLPTR && rightKey==Q_NULLPTR)
-        {
-            val = leftKey->value;
+        const CurveKey& leftKey = keys[leftIndex];
+        if(rightIndex<0)
+            return leftKey.value;
+
+        const CurveKey& rightKey = keys[rightIndex];
+        if(leftKey.rightTangent == TangentType::Constant ||
+           rightKey.leftTangent == TangentType::Constant) {
+            return leftKey.value;
         }
 
-        if(leftKey->rightTangent == TangentType::Constant ||
-           rightKey->leftTangent == TangentType::Constant) {
-            val = leftKey->value;
-        } else {
+        float timeDiff = rightKey.time - leftKey.time;
 
-            // 1D beziers are a third of the distance apart
-            float third = timeDiff * 0.333333f;
+        //frameDiff could be 0!!
+        float t = 0;
+        if(timeDiff != 0)
+            t = (time-leftKey.time)/timeDiff;
 
-            val = BezierHelper::calculateBezier(leftKey->value,
-                                                leftKey->value + (leftKey->rightSlope * third * timeDiff),
-                                                rightKey->value - (rightKey->leftSlope * third * timeDiff),
-                                                rightKey->value,
-                                                t);
-            //val = interpolate(leftKey->value,rightKey->value,t2);
-        }
+        // 1D beziers are a third of the distance apart
+        float third = timeDiff * 0.333333f;
 
-        return val;
+        return BezierHelper::calculateBezier(leftKey.value,
+                                             leftKey.value + (leftKey.rightSlope * third),
+                                             rightKey.value - (rightKey.leftSlope * third),
+                                             rightKey.value,
+                                             t);
     }
 
-    void getKeyFramesAtTime(Key<T>** firstKey,Key<T>** lastKey,float time)
+    /**
+     * Finds the indices of the keys on either side of time
+     * rightIndex is left at -1 if time is outside of the curve's keys
+     */
+    void getKeyFramesAtTime(int& leftIndex,int& rightIndex,float time)
     {
         int numKeys = keys.size();
 
@@ -158,71 +186,81 @@ public:
 
         if(numKeys==1)
         {
-            *firstKey = keys[0];
+            leftIndex = 0;
             return;
         }
 
         //before first key
         //todo: wrap around
-        if(time<=keys[0]->time)
+        if(time<=keys[0].time)
         {
-            *firstKey = keys[0];
+            leftIndex = 0;
             return;
         }
 
         //after last key
         //todo: wrap around
-        if(time>=keys[numKeys-1]->time)
+        if(time>=keys[numKeys-1].time)
         {
-            *firstKey = keys[numKeys-1];
+            leftIndex = numKeys-1;
             return;
         }
 
-        //find first key and last key
-        for(size_t k = 0;k<keys.size();k++)
-        {
-            Key<T>* key = keys[k];
-
-            if(key->time<=time)
-                *firstKey = key;
-            else
-            {
-                *lastKey = key;
-                break;
-            }
-        }
-
+        leftIndex = findKeyIndex(time);
+        rightIndex = leftIndex + 1;
     }
 
     void sortKeys()
     {
-        std::sort(keys.begin(),keys.end(),KeyCompare<T>);
+        std::stable_sort(keys.begin(),keys.end());
     }
 
     float getFirstKeyTime()
     {
         Q_ASSERT(keys.size()>0);
 
-        return keys.begin().time;
+        return keys.first().time;
     }
 
     float getLastKeyTime()
     {
         Q_ASSERT(keys.size()>0);
 
-        return keys.end().time;
+        return keys.last().time;
     }
 
-    virtual ~KeyFrame()
+private:
+    // index of the left key found by the last lookup, see KeyFrame
+    int cursor;
+
+    static bool KeyTimeCompare(float time, const CurveKey& key)
     {
-        for(auto iter = keys.begin();iter!=keys.end();iter++)
-            delete *iter;
+        return time < key.time;
     }
 
-protected:
-    float interpolate(float a,float b,float t)
+    /**
+     * Returns the index of the last key at or before time
+     * Assumes there are at least two keys and time is between the first and last key
+     */
+    int findKeyIndex(float time)
     {
-        return a+(b-a)*t;
+        const int lastIndex = keys.size() - 2;
+        const CurveKey* data = keys.constData();
+        if (cursor >= 0 && cursor <= lastIndex && data[cursor].time <= time) {
+            // step over the few keys passed since the last lookup, clips sampled
+            // faster than the frame rate skip keys every frame
+            const int lastStep = qMin(cursor + 4, lastIndex);
+            for (int i = cursor; i <= lastStep; i++) {
+                if (time < data[i + 1].time) {
+                    cursor = i;
+                    return cursor;
+                }
+            }
+        }
+
+        auto iter = std::upper_bound(keys.constBegin(), keys.constEnd(), time, KeyTimeCompare);
+        cursor = int(iter - keys.constBegin()) - 1;
+        return cursor;
     }
 };
 
@@ -13,11 +13,15 @@ For more information see the LICENSE file
 #define KEYFRAMEANIMATION_H
 
 #include <QString>
+#include <QVector>
 #include <QVector2D>
 #include <QVector3D>
 #include <QVector4D>
 #include <QQuaternion>
 #include <QColor>
+#include <QAtomicInt>
+
+#include <algorithm>
 
 #include "../math/bezierhelper.h"
 
@@ -76,21 +80,25 @@ class KeyFrame
 {
 public:
     QString name;
+    // sorted by time
+    // the editor holds on to keys while they're being edited so they stay heap allocated
     QVector<Key<T>*> keys;
     float length;//in seconds
 
     KeyFrame()
     {
         length = 15;//for now
+        cursor.store(0);
     }
 
     void clear()
     {
-        for (size_t i=0;i<keys.size();i++)
+        for (int i=0;i<keys.size();i++)
         {
             delete keys[i];
         }
         keys.clear();
+        cursor.store(0);
     }
 
     float getLength()
@@ -106,8 +114,7 @@ public:
         //sort keys
         this->sortKeys();
         //get last key and use that to determine length
-        auto last = keys.end().c;
-        length = last->time;
+        length = keys.last()->time;
     }
 
     void removeKey(Key<T>* key)
@@ -120,18 +127,20 @@ public:
         auto key = new Key<T>();
         key->value = value;
         key->time = time;
-        keys.push_back(key);
 
-        // if the new key's time isnt greater than the last key's time,
-        // do a sort
-        if(keys.size() >= 2 &&
-           keys[keys.size()-2]->time > keys[keys.size()-1]->time)
+        // keys are usually added in order so this is almost always an append
+        if(keys.isEmpty() || keys.last()->time <= time)
+        {
+            keys.append(key);
+        }
+        else
         {
-            this->sortKeys();
+            auto iter = std::upper_bound(keys.begin(), keys.end(), time, KeyTimeCompare);
+            keys.insert(iter, key);
         }
 
         // update length
-        length = keys[keys.size() - 1]->time;
+        length = keys.last()->time;
 
         return key;
     }
@@ -222,38 +231,28 @@ public:
         }
 
         //find first key and last key
-        for(size_t k = 0;k<keys.size();k++)
-        {
-            Key<T>* key = keys[k];
-
-            if(key->time<=time)
-                *firstKey = key;
-            else
-            {
-                *lastKey = key;
-                break;
-            }
-        }
-
+        int index = findKeyIndex(time);
+        *firstKey = keys[index];
+        *lastKey = keys[index + 1];
     }
 
     void sortKeys()
     {
-        std::sort(keys.begin(),keys.end(),KeyCompare<T>);
+        std::stable_sort(keys.begin(),keys.end(),KeyCompare<T>);
     }
 
     double getFirstKeyTime()
     {
         Q_ASSERT(keys.size()>0);
 
-        return keys.begin().time;
+        return keys.first()->time;
     }
 
     double getLastKeyTime()
     {
         Q_ASSERT(keys.size()>0);
 
-        return keys.end().time;
+        return keys.last()->time;
     }
 
     virtual ~KeyFrame()
@@ -264,6 +263,48 @@ public:
 
 protected:
     virtual T interpolate(T a,T b,float t)=0;
+
+private:
+    // index of the left key found by the last lookup
+    // playback mostly moves forward by less than a key per frame so the next
+    // lookup almost always lands on the same key or the one after it
+    // characters sharing a track can be sampled on different threads, at worst
+    // they overwrite each other's cursor and the lookup falls back to a search
+    QAtomicInt cursor;
+
+    static bool KeyTimeCompare(double time, const Key<T>* key)
+    {
+        return time < key->time;
+    }
+
+    /**
+     * Returns the index of the last key at or before time
+     * Assumes there are at least two keys and time is between the first and last key
+     */
+    int findKeyIndex(double time)
+    {
+        // the cursor is only a hint, keys can be added, removed or moved
+        // between lookups so it's checked against the keys every time
+        const int lastIndex = keys.size() - 2;
+        int index = cursor.load();
+        if (index >= 0 && index <= lastIndex && keys[index]->time <= time) {
+            // step over the few keys passed since the last lookup, clips sampled
+            // faster than the frame rate skip keys every frame
+            const int lastStep = qMin(index + 4, lastIndex);
+            for (int i = index; i <= lastStep; i++) {
+                if (time < keys[i + 1]->time) {
+                    cursor.store(i);
+                    return i;
+                }
+            }
+        }
+
+        // jumped somewhere else in the track, eg. scrubbing or looping
+        auto iter = std::upper_bound(keys.constBegin(), keys.constEnd(), time, KeyTimeCompare);
+        index = int(iter - keys.constBegin()) - 1;
+        cursor.store(index);
+        return index;
+    }
 };
 
 
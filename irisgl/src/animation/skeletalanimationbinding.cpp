@@ -0,0 +1,187 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "skeletalanimationbinding.h"
+#include "skeletalanimation.h"
+#include "../graphics/mesh.h"
+#include "../graphics/skeleton.h"
+#include "../math/mathhelper.h"
+#include "../scenegraph/meshnode.h"
+
+#include <QHash>
+
+namespace iris
+{
+
+SkeletalAnimationBinding::SkeletalAnimationBinding()
+{
+
+}
+
+void SkeletalAnimationBinding::bind(SceneNode* root, SkeletalAnimationPtr anim)
+{
+    animation = anim;
+
+    nodes.clear();
+    parents.clear();
+    boneAnimations.clear();
+    skinnedMeshes.clear();
+
+    if (!anim)
+        return;
+
+    addNode(root, -1);
+    positions.resize(nodes.size());
+    rotations.resize(nodes.size());
+    scales.resize(nodes.size());
+    skeletonTransforms.resize(nodes.size());
+
+    // when names repeat the last node wins, same as the old name lookups did
+    QHash<QString, int> nodeIndices;
+    for (int i = 0; i < nodes.size(); i++)
+        nodeIndices.insert(nodes[i]->name, i);
+
+    for (int i = 0; i < nodes.size(); i++) {
+        auto node = nodes[i];
+        if (node->getSceneNodeType() != SceneNodeType::Mesh)
+            continue;
+
+        auto mesh = static_cast<MeshNode*>(node)->getMesh();
+        if (mesh == nullptr || !mesh->hasSkeleton())
+            continue;
+
+        SkinnedMesh skinned;
+        skinned.nodeIndex = i;
+        skinned.skeleton = mesh->getSkeleton();
+
+        const auto& bones = skinned.skeleton->bones;
+        skinned.boneNodes.resize(bones.size());
+        for (int b = 0; b < bones.size(); b++)
+            skinned.boneNodes[b] = nodeIndices.value(bones[b]->name, -1);
+        skinned.boneTransforms.resize(bones.size());
+
+        skinnedMeshes.append(skinned);
+    }
+}
+
+void SkeletalAnimationBinding::addNode(SceneNode* node, int parentIndex)
+{
+    const int index = nodes.size();
+    nodes.append(node);
+    parents.append(parentIndex);
+    boneAnimations.append(animation->boneAnimations.value(node->name).data());
+
+    for (auto& child : node->children)
+        addNode(child.data(), index);
+}
+
+void SkeletalAnimationBinding::evaluate(float time)
+{
+    sample(time);
+    writePose();
+}
+
+void SkeletalAnimationBinding::sample(float time)
+{
+    for (int i = 0; i < nodes.size(); i++) {
+        auto boneAnim = boneAnimations[i];
+        if (boneAnim) {
+            positions[i] = boneAnim->posKeys->getValueAt(time);
+            rotations[i] = boneAnim->rotKeys->getValueAt(time).normalized();
+            scales[i] = boneAnim->scaleKeys->getValueAt(time);
+        } else {
+            auto node = nodes[i];
+            positions[i] = node->getLocalPos();
+            rotations[i] = node->getLocalRot();
+            scales[i] = node->getLocalScale();
+        }
+    }
+
+    calculateBoneTransforms();
+}
+
+void SkeletalAnimationBinding::writePose()
+{
+    for (int i = 0; i < nodes.size(); i++) {
+        if (!boneAnimations[i])
+            continue;
+
+        auto node = nodes[i];
+        node->setLocalPos(positions[i]);
+        node->setLocalRot(rotations[i]);
+        node->setLocalScale(scales[i]);
+    }
+
+    writeBoneTransforms();
+}
+
+void SkeletalAnimationBinding::applyPose()
+{
+    if (skinnedMeshes.isEmpty())
+        return;
+
+    for (int i = 0; i < nodes.size(); i++) {
+        auto node = nodes[i];
+        positions[i] = node->getLocalPos();
+        rotations[i] = node->getLocalRot();
+        scales[i] = node->getLocalScale();
+    }
+
+    calculateBoneTransforms();
+    writeBoneTransforms();
+}
+
+// https://github.com/acgessler/open3mod/blob/master/open3mod/SceneAnimator.cs#L338
+void SkeletalAnimationBinding::calculateBoneTransforms()
+{
+    if (skinnedMeshes.isEmpty())
+        return;
+
+    // parents always come before their children
+    for (int i = 0; i < nodes.size(); i++) {
+        QMatrix4x4 local;
+        MathHelper::composeTransform(positions[i], rotations[i], scales[i], local);
+
+        const int parent = parents[i];
+        if (parent >= 0)
+            skeletonTransforms[i] = skeletonTransforms[parent] * local;
+        else
+            skeletonTransforms[i] = local;
+    }
+
+    for (auto& skinned : skinnedMeshes) {
+        auto inverseMeshMatrix = skeletonTransforms[skinned.nodeIndex].inverted();
+
+        const auto& bones = skinned.skeleton->bones;
+        for (int b = 0; b < bones.size(); b++) {
+            const int boneNode = skinned.boneNodes[b];
+            if (boneNode >= 0) {
+                // https://github.com/acgessler/open3mod/blob/master/open3mod/SceneAnimator.cs#L356
+                skinned.boneTransforms[b] = inverseMeshMatrix * skeletonTransforms[boneNode] * bones[b]->inversePoseMatrix;
+            } else {
+                skinned.boneTransforms[b].setToIdentity();
+            }
+        }
+    }
+}
+
+void SkeletalAnimationBinding::writeBoneTransforms()
+{
+    for (auto& skinned : skinnedMeshes) {
+        // assigning would share the storage and make the next sample reallocate it
+        auto& boneTransforms = skinned.skeleton->boneTransforms;
+        const int count = qMin(boneTransforms.size(), skinned.boneTransforms.size());
+        for (int b = 0; b < count; b++)
+            boneTransforms[b] = skinned.boneTransforms[b];
+    }
+}
+
+}
@@ -0,0 +1,115 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef SKELETALANIMATIONBINDING_H
+#define SKELETALANIMATIONBINDING_H
+
+#include <QVector>
+#include <QMatrix4x4>
+#include <QVector3D>
+#include <QQuaternion>
+#include "../irisglfwd.h"
+
+namespace iris
+{
+
+class BoneAnimation;
+
+/**
+ * Connects a skeletal animation to the node hierarchy it animates.
+ * Bone names are resolved to node indices once so evaluating the animation
+ * is a linear pass over flat arrays instead of name lookups every frame.
+ */
+class SkeletalAnimationBinding
+{
+    struct SkinnedMesh
+    {
+        int nodeIndex;
+        SkeletonPtr skeleton;
+        // node driving each of the skeleton's bones, -1 if there isnt one
+        QVector<int> boneNodes;
+        // copied to the skeleton by writePose, meshes can share a skeleton
+        QVector<QMatrix4x4> boneTransforms;
+    };
+
+    SkeletalAnimationPtr animation;
+
+    // the animated node followed by its descendants in depth-first order
+    QVector<SceneNode*> nodes;
+    QVector<int> parents;
+    // null for nodes without keys
+    QVector<BoneAnimation*> boneAnimations;
+    // local transform of each node, sampled from the keys or copied from the node
+    QVector<QVector3D> positions;
+    QVector<QQuaternion> rotations;
+    QVector<QVector3D> scales;
+    // skeleton-space transform of each node
+    QVector<QMatrix4x4> skeletonTransforms;
+
+    QVector<SkinnedMesh> skinnedMeshes;
+
+public:
+    SkeletalAnimationBinding();
+
+    /**
+     * Flattens the hierarchy under root and resolves the animation's bones against it
+     * The binding has to be rebuilt if the hierarchy, node names or meshes change
+     */
+    void bind(SceneNode* root, SkeletalAnimationPtr anim);
+
+    bool isBoundTo(const SkeletalAnimationPtr& anim) const
+    {
+        return animation == anim;
+    }
+
+    /**
+     * Samples the animation's keys at time into the bound nodes, then updates
+     * the bone transforms of the skinned meshes
+     */
+    void evaluate(float time);
+
+    /**
+     * Samples the keys at time and calculates the bone transforms without writing
+     * to the nodes or skeletons, so different bindings can be sampled on different threads
+     * writePose has to be called afterwards from the thread that owns the scene
+     */
+    void sample(float time);
+
+    /**
+     * Writes the pose calculated by the last call to sample to the nodes and skeletons
+     */
+    void writePose();
+
+    /**
+     * Updates the bone transforms from the nodes' current transforms without sampling keys
+     */
+    void applyPose();
+
+private:
+    void addNode(SceneNode* node, int parentIndex);
+    void calculateBoneTransforms();
+    void writeBoneTransforms();
+};
+
+/**
+ * A skeletal animation found while updating a scene's animations, sampled after the walk
+ */
+struct SkeletalAnimationJob
+{
+    SkeletalAnimationBinding* binding;
+    float time;
+    // the skeleton is inside another job's skeleton so it has to be sampled after that one
+    bool nested;
+};
+
+}
+
+#endif // SKELETALANIMATIONBINDING_H
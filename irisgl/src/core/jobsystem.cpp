@@ -0,0 +1,110 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "jobsystem.h"
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QAtomicInt>
+#include <QSemaphore>
+#include <QSharedPointer>
+
+namespace iris
+{
+
+namespace
+{
+
+// shared by the threads working through one parallelFor call
+struct JobBatch
+{
+    const std::function<void(int)>* job;
+    int count;
+    QAtomicInt nextIndex;
+    QSemaphore finishedWorkers;
+
+    void run()
+    {
+        int index;
+        while ((index = nextIndex.fetchAndAddRelaxed(1)) < count)
+            (*job)(index);
+    }
+};
+
+class JobWorker : public QRunnable
+{
+    // shared so the batch outlives a worker that's still returning from release()
+    QSharedPointer<JobBatch> batch;
+
+public:
+    JobWorker(QSharedPointer<JobBatch> batch) : batch(batch)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        batch->run();
+        batch->finishedWorkers.release();
+    }
+};
+
+}
+
+void JobSystem::parallelFor(int count, const std::function<void(int)>& job)
+{
+    if (count <= 0)
+        return;
+
+    auto pool = getThreadPool();
+    const int workerCount = qMin(count, getThreadCount()) - 1;
+
+    if (workerCount <= 0) {
+        for (int i = 0; i < count; i++)
+            job(i);
+        return;
+    }
+
+    auto batch = QSharedPointer<JobBatch>(new JobBatch());
+    batch->job = &job;
+    batch->count = count;
+    batch->nextIndex.store(0);
+
+    for (int i = 0; i < workerCount; i++)
+        pool->start(new JobWorker(batch));
+
+    // workers that start after the jobs have run out return straight away,
+    // so this never waits on a busy pool for longer than one job
+    batch->run();
+    batch->finishedWorkers.acquire(workerCount);
+}
+
+int JobSystem::getThreadCount()
+{
+    return qMax(1, QThread::idealThreadCount());
+}
+
+QThreadPool* JobSystem::getThreadPool()
+{
+    static QThreadPool* pool = []() {
+        auto threadPool = new QThreadPool();
+        // the calling thread is the last worker
+        threadPool->setMaxThreadCount(qMax(1, getThreadCount() - 1));
+        // keep workers alive between frames
+        threadPool->setExpiryTimeout(-1);
+        return threadPool;
+    }();
+
+    return pool;
+}
+
+}
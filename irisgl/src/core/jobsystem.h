@@ -0,0 +1,48 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <functional>
+
+class QThreadPool;
+
+namespace iris
+{
+
+/**
+ * Runs short, independent per-frame jobs on a pool of worker threads
+ * The pool is separate from QThreadPool::globalInstance() so long running
+ * background tasks (asset loading, thumbnails) can't hold up a frame
+ */
+class JobSystem
+{
+public:
+    /**
+     * Calls job(i) for every i in [0, count) and returns once they've all finished
+     * Workers take the next unclaimed index as they go, so uneven jobs balance out
+     * The calling thread works through the jobs as well
+     */
+    static void parallelFor(int count, const std::function<void(int)>& job);
+
+    /**
+     * Number of threads, including the caller, that parallelFor spreads jobs over
+     */
+    static int getThreadCount();
+
+private:
+    static QThreadPool* getThreadPool();
+};
+
+}
+
+#endif // JOBSYSTEM_H
@@ -44,6 +44,13 @@ QVector3D AABB::getMax(const QVector3D& a, const QVector3D& b) const
 	return result;
 }
 
+bool AABB::isEmpty() const
+{
+	return minPos.x() > maxPos.x() ||
+		minPos.y() > maxPos.y() ||
+		minPos.z() > maxPos.z();
+}
+
 QVector3D AABB::getCenter() const
 {
 	return (minPos + maxPos) * 0.5f;
@@ -61,6 +68,14 @@ QVector3D AABB::getHalfSize() const
 	return getSize() * 0.5f;
 }
 
+float AABB::getSurfaceArea() const
+{
+	if (isEmpty()) return 0.0f;
+
+	auto size = getSize();
+	return 2.0f * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+}
+
 void AABB::offset(QVector3D offset)
 {
 	minPos += offset;
@@ -91,4 +106,26 @@ BoundingSphere AABB::getMinimalEnclosingSphere() const
 	return { getCenter(), getSize().length() * 0.5f };
 }
 
+AABB AABB::fromPoints(const QVector<QVector3D>& points)
+{
+	AABB aabb;
+	aabb.merge(points);
+	return aabb;
+}
+
+AABB AABB::transformed(const QMatrix4x4& matrix) const
+{
+	AABB result;
+	if (isEmpty()) return result;
+
+	for (int i = 0; i < 8; i++) {
+		QVector3D corner(i & 1 ? maxPos.x() : minPos.x(),
+			i & 2 ? maxPos.y() : minPos.y(),
+			i & 4 ? maxPos.z() : minPos.z());
+		result.merge(matrix * corner);
+	}
+
+	return result;
+}
+
 }
\ No newline at end of file
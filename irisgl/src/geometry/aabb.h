@@ -1,6 +1,7 @@
 #pragma once
 #include <QVector>
 #include <QVector3D>
+#include <QMatrix4x4>
 #include "boundingsphere.h"
 
 namespace iris
@@ -16,12 +17,16 @@ public:
 
 	void setNegativeInfinity();
 
-	QVector3D getMin() { return minPos; }
-	QVector3D getMax() { return maxPos; }
+	QVector3D getMin() const { return minPos; }
+	QVector3D getMax() const { return maxPos; }
+
+	// true if nothing has been merged into the box yet
+	bool isEmpty() const;
 
 	QVector3D getCenter() const;
 	QVector3D getSize() const;
 	QVector3D getHalfSize() const;
+	float getSurfaceArea() const;
 
 	void offset(QVector3D offset);
 
@@ -31,6 +36,9 @@ public:
 
 	BoundingSphere getMinimalEnclosingSphere() const;
 
+	// returns the box enclosing this box's corners after being transformed
+	AABB transformed(const QMatrix4x4& matrix) const;
+
 	static AABB fromPoints(const QVector<QVector3D>& points);
 
 private:
@@ -0,0 +1,184 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "bvh.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace iris
+{
+
+// leaves can only be bigger than this if all of their centroids are the same
+#define BVH_MAX_LEAF_SIZE 16
+#define BVH_SAH_BINS 12
+
+namespace
+{
+
+struct SahBin
+{
+    AABB bounds;
+    int count = 0;
+};
+
+float getAxis(const QVector3D& v, int axis)
+{
+    return v[axis];
+}
+
+}
+
+void BoundingVolumeHierarchy::build(const QVector<AABB>& primitiveBounds, int minLeafSize)
+{
+    clear();
+    this->minLeafSize = minLeafSize;
+
+    const int count = primitiveBounds.size();
+    if (count == 0)
+        return;
+
+    QVector<QVector3D> centroids(count);
+    primitiveIndices.resize(count);
+    for (int i = 0; i < count; i++) {
+        centroids[i] = primitiveBounds[i].getCenter();
+        primitiveIndices[i] = i;
+    }
+
+    // a binary tree has at most 2n - 1 nodes
+    nodes.reserve(count * 2 - 1);
+    buildNode(primitiveBounds, centroids, 0, count);
+    nodes.squeeze();
+}
+
+void BoundingVolumeHierarchy::clear()
+{
+    nodes.clear();
+    primitiveIndices.clear();
+}
+
+int BoundingVolumeHierarchy::buildNode(const QVector<AABB>& bounds, const QVector<QVector3D>& centroids, int start, int count)
+{
+    const int nodeIndex = nodes.size();
+    nodes.append(BvhNode());
+
+    AABB nodeBounds;
+    AABB centroidBounds;
+    for (int i = start; i < start + count; i++) {
+        const int prim = primitiveIndices[i];
+        nodeBounds.merge(bounds[prim]);
+        centroidBounds.merge(centroids[prim]);
+    }
+
+    // the node array can be reallocated by the recursive calls, so it's always indexed
+    nodes[nodeIndex].boundsMin = nodeBounds.getMin();
+    nodes[nodeIndex].boundsMax = nodeBounds.getMax();
+    nodes[nodeIndex].start = start;
+    nodes[nodeIndex].count = count;
+
+    if (count <= minLeafSize)
+        return nodeIndex;
+
+    // split along the axis where the centroids are the most spread out
+    auto extent = centroidBounds.getSize();
+    int axis = 0;
+    if (extent.y() > extent.x()) axis = 1;
+    if (extent.z() > getAxis(extent, axis)) axis = 2;
+
+    const float axisMin = getAxis(centroidBounds.getMin(), axis);
+    const float axisExtent = getAxis(extent, axis);
+
+    // all centroids are at the same spot, nothing to split
+    if (axisExtent <= 0.0f)
+        return nodeIndex;
+
+    // binned surface area heuristic
+    SahBin bins[BVH_SAH_BINS];
+    const float binScale = BVH_SAH_BINS / axisExtent;
+    auto getBin = [&](int prim) {
+        int bin = (int)((getAxis(centroids[prim], axis) - axisMin) * binScale);
+        return qBound(0, bin, BVH_SAH_BINS - 1);
+    };
+
+    for (int i = start; i < start + count; i++) {
+        const int prim = primitiveIndices[i];
+        auto& bin = bins[getBin(prim)];
+        bin.bounds.merge(bounds[prim]);
+        bin.count++;
+    }
+
+    // sweep from the right to get the cost of every right side
+    float rightArea[BVH_SAH_BINS];
+    int rightCount[BVH_SAH_BINS];
+    AABB rightBounds;
+    int rightTotal = 0;
+    for (int i = BVH_SAH_BINS - 1; i > 0; i--) {
+        rightBounds.merge(bins[i].bounds);
+        rightTotal += bins[i].count;
+        rightArea[i] = rightBounds.getSurfaceArea();
+        rightCount[i] = rightTotal;
+    }
+
+    // then from the left to find the cheapest split plane
+    AABB leftBounds;
+    int leftTotal = 0;
+    int bestSplit = -1;
+    float bestCost = std::numeric_limits<float>::max();
+    for (int i = 1; i < BVH_SAH_BINS; i++) {
+        leftBounds.merge(bins[i - 1].bounds);
+        leftTotal += bins[i - 1].count;
+
+        if (leftTotal == 0 || rightCount[i] == 0)
+            continue;
+
+        float cost = leftBounds.getSurfaceArea() * leftTotal + rightArea[i] * rightCount[i];
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestSplit = i;
+        }
+    }
+
+    // splitting costs a traversal step, compare against intersecting everything in this node
+    const float nodeArea = nodeBounds.getSurfaceArea();
+    const float leafCost = (float)count;
+    const float splitCost = nodeArea > 0.0f ? 1.0f + bestCost / nodeArea : leafCost;
+    if (splitCost >= leafCost && count <= BVH_MAX_LEAF_SIZE)
+        return nodeIndex;
+
+    auto begin = primitiveIndices.begin() + start;
+    auto end = begin + count;
+    int leftCount = 0;
+
+    if (bestSplit > 0) {
+        auto mid = std::partition(begin, end, [&](int prim) {
+            return getBin(prim) < bestSplit;
+        });
+        leftCount = (int)(mid - begin);
+    }
+
+    // fall back to a median split if the heuristic couldn't separate the primitives
+    if (leftCount == 0 || leftCount == count) {
+        leftCount = count / 2;
+        std::nth_element(begin, begin + leftCount, end, [&](int a, int b) {
+            return getAxis(centroids[a], axis) < getAxis(centroids[b], axis);
+        });
+    }
+
+    buildNode(bounds, centroids, start, leftCount);
+    const int rightIndex = buildNode(bounds, centroids, start + leftCount, count - leftCount);
+
+    nodes[nodeIndex].start = rightIndex;
+    nodes[nodeIndex].count = 0;
+
+    return nodeIndex;
+}
+
+}
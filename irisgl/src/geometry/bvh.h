@@ -0,0 +1,204 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QVarLengthArray>
+#include "aabb.h"
+
+namespace iris
+{
+
+/**
+ * Node of a BoundingVolumeHierarchy
+ * Interior nodes have their first child directly after them in the node array
+ */
+struct BvhNode
+{
+    QVector3D boundsMin;
+    QVector3D boundsMax;
+
+    // first index into primitiveIndices for leaves, second child's index for interior nodes
+    int start;
+    // number of primitives in a leaf, 0 for interior nodes
+    int count;
+
+    bool isLeaf() const
+    {
+        return count > 0;
+    }
+};
+
+/**
+ * Bounding volume hierarchy over a set of boxes, built using the surface area heuristic.
+ * It doesn't know what the boxes hold, queries pass the primitive indices back to a visitor.
+ * Nodes are stored flat in depth-first order.
+ */
+class BoundingVolumeHierarchy
+{
+public:
+    QVector<BvhNode> nodes;
+    QVector<int> primitiveIndices;
+
+    BoundingVolumeHierarchy()
+    {
+        minLeafSize = 2;
+    }
+
+    /**
+     * Builds the hierarchy. The primitive indices given to visitors
+     * are indices into primitiveBounds.
+     * Leaves are only split if they have more than minLeafSize primitives
+     */
+    void build(const QVector<AABB>& primitiveBounds, int minLeafSize = 2);
+    void clear();
+
+    bool isEmpty() const
+    {
+        return nodes.isEmpty();
+    }
+
+    /**
+     * Visits the primitives whose leaves are hit by the segment, nearest leaves first.
+     * The visitor is called as bool visitor(int primitiveIndex, float& maxT) where maxT
+     * is the furthest point along the segment (0 to 1) still worth looking at. Lowering it
+     * culls everything behind, which is how closest hit queries are done.
+     * Returning false stops the traversal.
+     */
+    template<typename Visitor>
+    void traverseSegment(const QVector3D& segmentStart, const QVector3D& segmentEnd, Visitor visitor) const;
+
+    /**
+     * Same as traverseSegment but the visitor gets whole leaves as
+     * bool visitor(int start, int count, float& maxT) where start and count
+     * give the leaf's range in primitiveIndices
+     */
+    template<typename Visitor>
+    void traverseSegmentLeaves(const QVector3D& segmentStart, const QVector3D& segmentEnd, Visitor visitor) const;
+
+private:
+    int minLeafSize;
+
+    int buildNode(const QVector<AABB>& bounds, const QVector<QVector3D>& centroids, int start, int count);
+
+    // slab test, returns the entry distance in tNear
+    static bool intersectsNode(const BvhNode& node,
+                               const QVector3D& origin,
+                               const QVector3D& invDir,
+                               float maxT,
+                               float& tNear)
+    {
+        float t1 = (node.boundsMin.x() - origin.x()) * invDir.x();
+        float t2 = (node.boundsMax.x() - origin.x()) * invDir.x();
+        float tmin = qMin(t1, t2);
+        float tmax = qMax(t1, t2);
+
+        t1 = (node.boundsMin.y() - origin.y()) * invDir.y();
+        t2 = (node.boundsMax.y() - origin.y()) * invDir.y();
+        tmin = qMax(tmin, qMin(t1, t2));
+        tmax = qMin(tmax, qMax(t1, t2));
+
+        t1 = (node.boundsMin.z() - origin.z()) * invDir.z();
+        t2 = (node.boundsMax.z() - origin.z()) * invDir.z();
+        tmin = qMax(tmin, qMin(t1, t2));
+        tmax = qMin(tmax, qMax(t1, t2));
+
+        tNear = tmin;
+        return tmax >= qMax(tmin, 0.0f) && tmin <= maxT;
+    }
+};
+
+template<typename Visitor>
+void BoundingVolumeHierarchy::traverseSegment(const QVector3D& segmentStart, const QVector3D& segmentEnd, Visitor visitor) const
+{
+    traverseSegmentLeaves(segmentStart, segmentEnd, [&](int start, int count, float& maxT) {
+        for (int i = start; i < start + count; i++) {
+            if (!visitor(primitiveIndices[i], maxT))
+                return false;
+        }
+        return true;
+    });
+}
+
+template<typename Visitor>
+void BoundingVolumeHierarchy::traverseSegmentLeaves(const QVector3D& segmentStart, const QVector3D& segmentEnd, Visitor visitor) const
+{
+    if (nodes.isEmpty())
+        return;
+
+    auto dir = segmentEnd - segmentStart;
+    // division by zero gives infinity which the slab test handles
+    QVector3D invDir(1.0f / dir.x(), 1.0f / dir.y(), 1.0f / dir.z());
+    float maxT = 1.0f;
+
+    float tNear;
+    if (!intersectsNode(nodes[0], segmentStart, invDir, maxT, tNear))
+        return;
+
+    // entry distances are kept so nodes behind a closer hit found
+    // after they were pushed can be skipped
+    QVarLengthArray<int, 64> stack;
+    QVarLengthArray<float, 64> stackNear;
+    stack.append(0);
+    stackNear.append(tNear);
+
+    while (!stack.isEmpty()) {
+        const int nodeIndex = stack.last();
+        const float nodeNear = stackNear.last();
+        stack.removeLast();
+        stackNear.removeLast();
+
+        if (nodeNear > maxT)
+            continue;
+
+        const BvhNode& node = nodes[nodeIndex];
+        if (node.isLeaf()) {
+            if (!visitor(node.start, node.count, maxT))
+                return;
+            continue;
+        }
+
+        const int left = nodeIndex + 1;
+        const int right = node.start;
+
+        float tLeft, tRight;
+        bool hitLeft = intersectsNode(nodes[left], segmentStart, invDir, maxT, tLeft);
+        bool hitRight = intersectsNode(nodes[right], segmentStart, invDir, maxT, tRight);
+
+        // push the further child first so the nearer one is visited first
+        if (hitLeft && hitRight) {
+            if (tLeft <= tRight) {
+                stack.append(right);
+                stackNear.append(tRight);
+                stack.append(left);
+                stackNear.append(tLeft);
+            } else {
+                stack.append(left);
+                stackNear.append(tLeft);
+                stack.append(right);
+                stackNear.append(tRight);
+            }
+        } else if (hitLeft) {
+            stack.append(left);
+            stackNear.append(tLeft);
+        } else if (hitRight) {
+            stack.append(right);
+            stackNear.append(tRight);
+        }
+    }
+}
+
+}
+
+#endif // BVH_H
@@ -0,0 +1,281 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "dynamicaabbtree.h"
+
+namespace iris
+{
+
+static QVector3D minVector(const QVector3D& a, const QVector3D& b)
+{
+    return QVector3D(qMin(a.x(), b.x()), qMin(a.y(), b.y()), qMin(a.z(), b.z()));
+}
+
+static QVector3D maxVector(const QVector3D& a, const QVector3D& b)
+{
+    return QVector3D(qMax(a.x(), b.x()), qMax(a.y(), b.y()), qMax(a.z(), b.z()));
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+{
+    this->margin = margin;
+    clear();
+}
+
+void DynamicAabbTree::clear()
+{
+    nodes.clear();
+    root = -1;
+    freeList = -1;
+    proxyCount = 0;
+}
+
+int DynamicAabbTree::allocateNode()
+{
+    int index;
+    if (freeList != -1) {
+        index = freeList;
+        freeList = nodes[index].parent;
+    } else {
+        index = nodes.size();
+        nodes.append(DynamicAabbTreeNode());
+    }
+
+    auto& node = nodes[index];
+    node.parent = -1;
+    node.child1 = -1;
+    node.child2 = -1;
+    node.height = 0;
+    node.userData = nullptr;
+    return index;
+}
+
+void DynamicAabbTree::freeNode(int index)
+{
+    nodes[index].parent = freeList;
+    nodes[index].height = -1;
+    freeList = index;
+}
+
+int DynamicAabbTree::createProxy(const AABB& bounds, void* userData)
+{
+    int proxy = allocateNode();
+
+    // the margin grows with the box so large objects don't get reinserted for tiny moves
+    auto fat = bounds.getHalfSize() * 0.2f + QVector3D(margin, margin, margin);
+    nodes[proxy].boundsMin = bounds.getMin() - fat;
+    nodes[proxy].boundsMax = bounds.getMax() + fat;
+    nodes[proxy].userData = userData;
+
+    insertLeaf(proxy);
+    proxyCount++;
+    return proxy;
+}
+
+void DynamicAabbTree::destroyProxy(int proxy)
+{
+    removeLeaf(proxy);
+    freeNode(proxy);
+    proxyCount--;
+}
+
+bool DynamicAabbTree::moveProxy(int proxy, const AABB& bounds)
+{
+    if (contains(nodes[proxy], bounds.getMin(), bounds.getMax()))
+        return false;
+
+    removeLeaf(proxy);
+
+    auto fat = bounds.getHalfSize() * 0.2f + QVector3D(margin, margin, margin);
+    nodes[proxy].boundsMin = bounds.getMin() - fat;
+    nodes[proxy].boundsMax = bounds.getMax() + fat;
+
+    insertLeaf(proxy);
+    return true;
+}
+
+AABB DynamicAabbTree::getFatBounds(int proxy) const
+{
+    AABB bounds;
+    bounds.merge(nodes[proxy].boundsMin);
+    bounds.merge(nodes[proxy].boundsMax);
+    return bounds;
+}
+
+void DynamicAabbTree::updateNode(int index)
+{
+    auto& node = nodes[index];
+    const auto& child1 = nodes[node.child1];
+    const auto& child2 = nodes[node.child2];
+
+    node.boundsMin = minVector(child1.boundsMin, child2.boundsMin);
+    node.boundsMax = maxVector(child1.boundsMax, child2.boundsMax);
+    node.height = 1 + qMax(child1.height, child2.height);
+}
+
+// http://box2d.org/files/GDC2019/ErinCatto_DynamicBVH_Full.pdf
+void DynamicAabbTree::insertLeaf(int leaf)
+{
+    if (root == -1) {
+        root = leaf;
+        nodes[root].parent = -1;
+        return;
+    }
+
+    const auto leafMin = nodes[leaf].boundsMin;
+    const auto leafMax = nodes[leaf].boundsMax;
+
+    // walk down to the sibling where the leaf adds the least surface area
+    int index = root;
+    while (!nodes[index].isLeaf()) {
+        const auto& node = nodes[index];
+        int child1 = node.child1;
+        int child2 = node.child2;
+
+        float area = getArea(node.boundsMin, node.boundsMax);
+        float combinedArea = getArea(minVector(node.boundsMin, leafMin), maxVector(node.boundsMax, leafMax));
+
+        // cost of making a new parent for this node and the leaf
+        float cost = 2.0f * combinedArea;
+        // every ancestor grows by this much if the leaf goes further down
+        float inheritanceCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child) {
+            const auto& c = nodes[child];
+            float grown = getArea(minVector(c.boundsMin, leafMin), maxVector(c.boundsMax, leafMax));
+            if (c.isLeaf())
+                return grown + inheritanceCost;
+            return grown - getArea(c.boundsMin, c.boundsMax) + inheritanceCost;
+        };
+
+        float cost1 = descendCost(child1);
+        float cost2 = descendCost(child2);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+
+        index = cost1 < cost2 ? child1 : child2;
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+
+    nodes[newParent].parent = oldParent;
+    nodes[newParent].child1 = sibling;
+    nodes[newParent].child2 = leaf;
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    if (oldParent != -1) {
+        if (nodes[oldParent].child1 == sibling)
+            nodes[oldParent].child1 = newParent;
+        else
+            nodes[oldParent].child2 = newParent;
+    } else {
+        root = newParent;
+    }
+
+    // refit and rebalance the ancestors
+    index = newParent;
+    while (index != -1) {
+        index = balance(index);
+        updateNode(index);
+        index = nodes[index].parent;
+    }
+}
+
+void DynamicAabbTree::removeLeaf(int leaf)
+{
+    if (leaf == root) {
+        root = -1;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+    // the sibling takes the parent's place
+    if (grandParent != -1) {
+        if (nodes[grandParent].child1 == parent)
+            nodes[grandParent].child1 = sibling;
+        else
+            nodes[grandParent].child2 = sibling;
+        nodes[sibling].parent = grandParent;
+        freeNode(parent);
+
+        int index = grandParent;
+        while (index != -1) {
+            index = balance(index);
+            updateNode(index);
+            index = nodes[index].parent;
+        }
+    } else {
+        root = sibling;
+        nodes[sibling].parent = -1;
+        freeNode(parent);
+    }
+}
+
+// swaps the shorter child with a grandchild of the taller one
+int DynamicAabbTree::balance(int indexA)
+{
+    const auto& a = nodes[indexA];
+    if (a.isLeaf() || a.height < 2)
+        return indexA;
+
+    int indexB = a.child1;
+    int indexC = a.child2;
+    int difference = nodes[indexC].height - nodes[indexB].height;
+
+    if (difference > 1 || difference < -1) {
+        // the taller child moves up into a's place
+        int indexTall = difference > 1 ? indexC : indexB;
+
+        int indexF = nodes[indexTall].child1;
+        int indexG = nodes[indexTall].child2;
+
+        nodes[indexTall].child1 = indexA;
+        nodes[indexTall].parent = nodes[indexA].parent;
+        nodes[indexA].parent = indexTall;
+
+        int tallParent = nodes[indexTall].parent;
+        if (tallParent != -1) {
+            if (nodes[tallParent].child1 == indexA)
+                nodes[tallParent].child1 = indexTall;
+            else
+                nodes[tallParent].child2 = indexTall;
+        } else {
+            root = indexTall;
+        }
+
+        // the taller grandchild stays with the moved up node, the other goes down to a
+        int keep = nodes[indexF].height > nodes[indexG].height ? indexF : indexG;
+        int give = keep == indexF ? indexG : indexF;
+
+        nodes[indexTall].child2 = keep;
+        if (difference > 1) {
+            nodes[indexA].child2 = give;
+        } else {
+            nodes[indexA].child1 = give;
+        }
+        nodes[give].parent = indexA;
+
+        updateNode(indexA);
+        updateNode(indexTall);
+        return indexTall;
+    }
+
+    return indexA;
+}
+
+}
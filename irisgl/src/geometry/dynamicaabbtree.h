@@ -0,0 +1,378 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef DYNAMICAABBTREE_H
+#define DYNAMICAABBTREE_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QVarLengthArray>
+#include "aabb.h"
+#include "boundingsphere.h"
+#include "frustum.h"
+
+namespace iris
+{
+
+struct DynamicAabbTreeNode
+{
+    // leaves hold their proxy's fattened bounds, interior nodes the union of their children
+    QVector3D boundsMin;
+    QVector3D boundsMax;
+
+    // next free node while the node is unused
+    int parent;
+    int child1;
+    int child2;
+
+    // 0 for leaves, -1 for free nodes
+    int height;
+
+    void* userData;
+
+    bool isLeaf() const
+    {
+        return child1 == -1;
+    }
+};
+
+/**
+ * Bounding volume hierarchy that's updated as its boxes move instead of being rebuilt
+ * Each box is a proxy whose id stays valid until it's destroyed. Leaves store the box
+ * enlarged by a margin so small movements don't touch the tree, larger ones remove the
+ * leaf and insert it again where it adds the least area. Subtrees are rotated on the way
+ * back up to keep the tree balanced
+ *
+ * Queries call visitors with the user data given when the proxy was created
+ */
+class DynamicAabbTree
+{
+public:
+    /**
+     * @param margin added to each side of a proxy's bounds, on top of a tenth of its size
+     */
+    DynamicAabbTree(float margin = 0.1f);
+
+    int createProxy(const AABB& bounds, void* userData);
+    void destroyProxy(int proxy);
+
+    /**
+     * Updates the bounds of proxy
+     * Returns true if it moved outside of its fattened bounds and had to be reinserted
+     */
+    bool moveProxy(int proxy, const AABB& bounds);
+
+    void* getUserData(int proxy) const
+    {
+        return nodes[proxy].userData;
+    }
+
+    AABB getFatBounds(int proxy) const;
+
+    int getProxyCount() const
+    {
+        return proxyCount;
+    }
+
+    int getHeight() const
+    {
+        return root == -1 ? 0 : nodes[root].height;
+    }
+
+    void clear();
+
+    /**
+     * Visits the proxies whose fattened bounds overlap bounds
+     * The visitor is called as bool visitor(void* userData), returning false stops the query
+     */
+    template<typename Visitor>
+    void queryAABB(const AABB& bounds, Visitor visitor) const;
+
+    // same as queryAABB for the proxies touching sphere
+    template<typename Visitor>
+    void querySphere(const BoundingSphere& sphere, Visitor visitor) const;
+
+    /**
+     * Visits the proxies inside or touching frustum
+     * Subtrees entirely inside are visited without testing their children
+     */
+    template<typename Visitor>
+    void queryFrustum(const Frustum& frustum, Visitor visitor) const;
+
+    /**
+     * Visits the proxies hit by the segment, nearest first, with the same visitor as
+     * BoundingVolumeHierarchy::traverseSegment except it gets user data instead of an index
+     * bool visitor(void* userData, float& maxT)
+     */
+    template<typename Visitor>
+    void traverseSegment(const QVector3D& segmentStart, const QVector3D& segmentEnd, Visitor visitor) const;
+
+private:
+    QVector<DynamicAabbTreeNode> nodes;
+    int root;
+    int freeList;
+    int proxyCount;
+    float margin;
+
+    int allocateNode();
+    void freeNode(int node);
+
+    void insertLeaf(int leaf);
+    void removeLeaf(int leaf);
+
+    // rotates the subtree at index if its children's heights differ by more than one
+    // returns the index of the subtree's new root
+    int balance(int index);
+
+    void updateNode(int index);
+
+    static bool overlaps(const DynamicAabbTreeNode& node, const QVector3D& boundsMin, const QVector3D& boundsMax)
+    {
+        return node.boundsMin.x() <= boundsMax.x() && node.boundsMax.x() >= boundsMin.x() &&
+               node.boundsMin.y() <= boundsMax.y() && node.boundsMax.y() >= boundsMin.y() &&
+               node.boundsMin.z() <= boundsMax.z() && node.boundsMax.z() >= boundsMin.z();
+    }
+
+    static bool contains(const DynamicAabbTreeNode& node, const QVector3D& boundsMin, const QVector3D& boundsMax)
+    {
+        return node.boundsMin.x() <= boundsMin.x() && node.boundsMax.x() >= boundsMax.x() &&
+               node.boundsMin.y() <= boundsMin.y() && node.boundsMax.y() >= boundsMax.y() &&
+               node.boundsMin.z() <= boundsMin.z() && node.boundsMax.z() >= boundsMax.z();
+    }
+
+    static float getArea(const QVector3D& boundsMin, const QVector3D& boundsMax)
+    {
+        auto size = boundsMax - boundsMin;
+        return 2.0f * (size.x() * size.y() + size.y() * size.z() + size.z() * size.x());
+    }
+
+    // slab test, returns the entry distance in tNear
+    static bool intersectsNode(const DynamicAabbTreeNode& node,
+                               const QVector3D& origin,
+                               const QVector3D& invDir,
+                               float maxT,
+                               float& tNear)
+    {
+        float t1 = (node.boundsMin.x() - origin.x()) * invDir.x();
+        float t2 = (node.boundsMax.x() - origin.x()) * invDir.x();
+        float tmin = qMin(t1, t2);
+        float tmax = qMax(t1, t2);
+
+        t1 = (node.boundsMin.y() - origin.y()) * invDir.y();
+        t2 = (node.boundsMax.y() - origin.y()) * invDir.y();
+        tmin = qMax(tmin, qMin(t1, t2));
+        tmax = qMin(tmax, qMax(t1, t2));
+
+        t1 = (node.boundsMin.z() - origin.z()) * invDir.z();
+        t2 = (node.boundsMax.z() - origin.z()) * invDir.z();
+        tmin = qMax(tmin, qMin(t1, t2));
+        tmax = qMin(tmax, qMax(t1, t2));
+
+        tNear = tmin;
+        return tmax >= qMax(tmin, 0.0f) && tmin <= maxT;
+    }
+};
+
+template<typename Visitor>
+void DynamicAabbTree::queryAABB(const AABB& bounds, Visitor visitor) const
+{
+    if (root == -1 || bounds.isEmpty())
+        return;
+
+    const auto boundsMin = bounds.getMin();
+    const auto boundsMax = bounds.getMax();
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(root);
+
+    while (!stack.isEmpty()) {
+        const auto& node = nodes[stack.last()];
+        stack.removeLast();
+
+        if (!overlaps(node, boundsMin, boundsMax))
+            continue;
+
+        if (node.isLeaf()) {
+            if (!visitor(node.userData))
+                return;
+        } else {
+            stack.append(node.child1);
+            stack.append(node.child2);
+        }
+    }
+}
+
+template<typename Visitor>
+void DynamicAabbTree::querySphere(const BoundingSphere& sphere, Visitor visitor) const
+{
+    if (root == -1)
+        return;
+
+    const float radiusSqrd = sphere.radius * sphere.radius;
+
+    QVarLengthArray<int, 64> stack;
+    stack.append(root);
+
+    while (!stack.isEmpty()) {
+        const auto& node = nodes[stack.last()];
+        stack.removeLast();
+
+        // distance from the center to the closest point of the box
+        float distSqrd = 0;
+        for (int i = 0; i < 3; i++) {
+            float c = sphere.pos[i];
+            if (c < node.boundsMin[i])
+                distSqrd += (node.boundsMin[i] - c) * (node.boundsMin[i] - c);
+            else if (c > node.boundsMax[i])
+                distSqrd += (c - node.boundsMax[i]) * (c - node.boundsMax[i]);
+        }
+
+        if (distSqrd > radiusSqrd)
+            continue;
+
+        if (node.isLeaf()) {
+            if (!visitor(node.userData))
+                return;
+        } else {
+            stack.append(node.child1);
+            stack.append(node.child2);
+        }
+    }
+}
+
+template<typename Visitor>
+void DynamicAabbTree::queryFrustum(const Frustum& frustum, Visitor visitor) const
+{
+    if (root == -1)
+        return;
+
+    // each entry carries the planes its box still straddles, children of a box
+    // that's inside a plane are inside it too so it isn't tested again
+    const int allPlanes = (1 << 6) - 1;
+    QVarLengthArray<int, 64> stack;
+    QVarLengthArray<int, 64> stackPlanes;
+    stack.append(root);
+    stackPlanes.append(allPlanes);
+
+    while (!stack.isEmpty()) {
+        const int index = stack.last();
+        int planeMask = stackPlanes.last();
+        stack.removeLast();
+        stackPlanes.removeLast();
+
+        const auto& node = nodes[index];
+        bool outside = false;
+
+        for (int p = 0; p < 6 && planeMask != 0; p++) {
+            if ((planeMask & (1 << p)) == 0)
+                continue;
+
+            const auto& plane = frustum.planes[p];
+            const auto& n = plane.normal;
+
+            // the corners furthest along and against the plane's normal
+            QVector3D positive(n.x() >= 0 ? node.boundsMax.x() : node.boundsMin.x(),
+                               n.y() >= 0 ? node.boundsMax.y() : node.boundsMin.y(),
+                               n.z() >= 0 ? node.boundsMax.z() : node.boundsMin.z());
+            QVector3D negative(n.x() >= 0 ? node.boundsMin.x() : node.boundsMax.x(),
+                               n.y() >= 0 ? node.boundsMin.y() : node.boundsMax.y(),
+                               n.z() >= 0 ? node.boundsMin.z() : node.boundsMax.z());
+
+            if (QVector3D::dotProduct(n, positive) + plane.d < 0) {
+                outside = true;
+                break;
+            }
+
+            if (QVector3D::dotProduct(n, negative) + plane.d >= 0)
+                planeMask &= ~(1 << p);
+        }
+
+        if (outside)
+            continue;
+
+        if (node.isLeaf()) {
+            if (!visitor(node.userData))
+                return;
+        } else {
+            stack.append(node.child1);
+            stackPlanes.append(planeMask);
+            stack.append(node.child2);
+            stackPlanes.append(planeMask);
+        }
+    }
+}
+
+template<typename Visitor>
+void DynamicAabbTree::traverseSegment(const QVector3D& segmentStart, const QVector3D& segmentEnd, Visitor visitor) const
+{
+    if (root == -1)
+        return;
+
+    auto dir = segmentEnd - segmentStart;
+    // division by zero gives infinity which the slab test handles
+    QVector3D invDir(1.0f / dir.x(), 1.0f / dir.y(), 1.0f / dir.z());
+    float maxT = 1.0f;
+
+    float tNear;
+    if (!intersectsNode(nodes[root], segmentStart, invDir, maxT, tNear))
+        return;
+
+    QVarLengthArray<int, 64> stack;
+    QVarLengthArray<float, 64> stackNear;
+    stack.append(root);
+    stackNear.append(tNear);
+
+    while (!stack.isEmpty()) {
+        const int index = stack.last();
+        const float nodeNear = stackNear.last();
+        stack.removeLast();
+        stackNear.removeLast();
+
+        if (nodeNear > maxT)
+            continue;
+
+        const auto& node = nodes[index];
+        if (node.isLeaf()) {
+            if (!visitor(node.userData, maxT))
+                return;
+            continue;
+        }
+
+        float t1, t2;
+        bool hit1 = intersectsNode(nodes[node.child1], segmentStart, invDir, maxT, t1);
+        bool hit2 = intersectsNode(nodes[node.child2], segmentStart, invDir, maxT, t2);
+
+        // push the further child first so the nearer one is visited first
+        if (hit1 && hit2) {
+            if (t1 <= t2) {
+                stack.append(node.child2);
+                stackNear.append(t2);
+                stack.append(node.child1);
+                stackNear.append(t1);
+            } else {
+                stack.append(node.child1);
+                stackNear.append(t1);
+                stack.append(node.child2);
+                stackNear.append(t2);
+            }
+        } else if (hit1) {
+            stack.append(node.child1);
+            stackNear.append(t1);
+        } else if (hit2) {
+            stack.append(node.child2);
+            stackNear.append(t2);
+        }
+    }
+}
+
+}
+
+#endif // DYNAMICAABBTREE_H
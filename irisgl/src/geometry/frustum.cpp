@@ -3,37 +3,33 @@
 #include "boundingsphere.h"
 #include <QMatrix4x4>
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_USE_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace iris {
 
+static Plane normalizePlane(const QVector4D& plane)
+{
+    auto length = plane.toVector3D().length();
+    return Plane(plane.toVector3D() / length, plane.w() / length);
+}
+
 // https://github.com/playcanvas/engine/blob/master/src/shape/frustum.js#L27
 void Frustum::build(QMatrix4x4 viewProj)
 {
-    planes.clear();
-
-    // left
-    auto plane = viewProj.row(3) + viewProj.row(0);
-    planes.append(Plane(plane.toVector3D().normalized(), plane.w()/plane.toVector3D().length()));
-
-    // right
-    plane = viewProj.row(3) - viewProj.row(0);
-    planes.append(Plane(plane.toVector3D().normalized(), plane.w()/plane.toVector3D().length()));
-
-    // top
-    plane = viewProj.row(3) + viewProj.row(1);
-    planes.append(Plane(plane.toVector3D().normalized(), plane.w()/plane.toVector3D().length()));
-
-    // bottom
-    plane = viewProj.row(3) - viewProj.row(1);
-    planes.append(Plane(plane.toVector3D().normalized(), plane.w()/plane.toVector3D().length()));
-
-    // front
-    plane = viewProj.row(3) + viewProj.row(2);
-    planes.append(Plane(plane.toVector3D().normalized(), plane.w()/plane.toVector3D().length()));
-
-    // back
-    plane = viewProj.row(3) - viewProj.row(2);
-    planes.append(Plane(plane.toVector3D().normalized(), plane.w()/plane.toVector3D().length()));
+    auto row0 = viewProj.row(0);
+    auto row1 = viewProj.row(1);
+    auto row2 = viewProj.row(2);
+    auto row3 = viewProj.row(3);
 
+    planes[0] = normalizePlane(row3 + row0); // left
+    planes[1] = normalizePlane(row3 - row0); // right
+    planes[2] = normalizePlane(row3 + row1); // top
+    planes[3] = normalizePlane(row3 - row1); // bottom
+    planes[4] = normalizePlane(row3 + row2); // front
+    planes[5] = normalizePlane(row3 - row2); // back
 }
 
 bool Frustum::isSphereInside(BoundingSphere *sphere)
@@ -46,6 +42,56 @@ bool Frustum::isSphereInside(BoundingSphere *sphere)
     return true;
 }
 
+int Frustum::cullSpheres(const float* x, const float* y, const float* z, const float* radius,
+                         int count, quint8* visible) const
+{
+    int visibleCount = 0;
+    int i = 0;
 
+#ifdef FRUSTUM_USE_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeD[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(planes[p].normal.x());
+        planeY[p] = _mm_set1_ps(planes[p].normal.y());
+        planeZ[p] = _mm_set1_ps(planes[p].normal.z());
+        planeD[p] = _mm_set1_ps(planes[p].d);
+    }
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 negRadius = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(radius + i));
+
+        // a sphere is outside once it's entirely behind any of the planes
+        __m128 outside = _mm_setzero_ps();
+        for (int p = 0; p < 6; p++) {
+            __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                     _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeD[p]));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(dist, negRadius));
+        }
+
+        int mask = _mm_movemask_ps(outside);
+        for (int k = 0; k < 4; k++) {
+            visible[i + k] = (mask >> k) & 1 ? 0 : 1;
+            visibleCount += visible[i + k];
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        bool inside = true;
+        for (int p = 0; p < 6 && inside; p++) {
+            auto& normal = planes[p].normal;
+            float dist = normal.x() * x[i] + normal.y() * y[i] + normal.z() * z[i] + planes[p].d;
+            inside = dist >= -radius[i];
+        }
+
+        visible[i] = inside ? 1 : 0;
+        visibleCount += visible[i];
+    }
+
+    return visibleCount;
+}
 
 }
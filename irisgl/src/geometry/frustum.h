@@ -1,7 +1,6 @@
 #ifndef FRUSTUM_H
 #define FRUSTUM_H
 
-#include <QList>
 #include <QMatrix4x4>
 #include "plane.h"
 
@@ -11,13 +10,23 @@ class BoundingSphere;
 class Frustum
 {
 public:
-    QList<Plane> planes;
+    // left, right, top, bottom, front, back
+    Plane planes[6];
 
     // projection x view
     void build(QMatrix4x4 viewProj);
 
     // checks if the sphere is inside or touches the bounding sphere
     bool isSphereInside(BoundingSphere* sphere);
+
+    /**
+     * Checks count spheres at once, their centers and radii are given as separate arrays
+     * visible[i] is set to 1 if sphere i is inside or touches the frustum and 0 if it isn't
+     * Four spheres are tested against each plane at a time where SSE is available
+     * Returns the number of visible spheres
+     */
+    int cullSpheres(const float* x, const float* y, const float* z, const float* radius,
+                    int count, quint8* visible) const;
 };
 
 }
@@ -11,9 +11,42 @@ For more information see the LICENSE file
 
 #include "trimesh.h"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define TRIMESH_USE_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace iris
 {
 
+// the bvh leaves are tested four triangles at a time
+#define TRIMESH_PACKET_SIZE 4
+
+// streams in packedTriangles
+enum PackedComponent
+{
+    AX, AY, AZ,
+    ABX, ABY, ABZ,
+    ACX, ACY, ACZ,
+    NX, NY, NZ,
+    PackedComponentCount
+};
+
+TriMesh::TriMesh()
+{
+    bvhDirty = true;
+    packedStride = 0;
+}
+
+void TriMesh::setTriangles(const QVector<QVector3D>& vertices, const QVector<unsigned int>& indices)
+{
+    this->vertices = vertices;
+    this->indices = indices;
+    if (indices.size() % 3 != 0)
+        this->indices.resize(indices.size() - indices.size() % 3);
+    bvhDirty = true;
+}
+
 /**
  * Adds points for triangle. Assumes points are in a counter-clockwise rotation.
  * @param a
@@ -22,9 +55,16 @@ namespace iris
  */
 void TriMesh::addTriangle(const QVector3D& a,const QVector3D& b,const QVector3D& c)
 {
-    Triangle tri = {a,b,c,QVector3D::crossProduct(b-a,c-a)};
+    unsigned int index = vertices.size();
+    vertices.append(a);
+    vertices.append(b);
+    vertices.append(c);
 
-    triangles.append(tri);
+    indices.append(index);
+    indices.append(index + 1);
+    indices.append(index + 2);
+
+    bvhDirty = true;
 }
 
 //https://github.com/qt/qt3d/blob/5476bc6b4b6a12c921da502c24c4e078b04dd3b3/src/render/jobs/pickboundingvolumejob.cpp
@@ -32,106 +72,244 @@ void TriMesh::addTriangle(const QVector3D& a,const QVector3D& b,const QVector3D&
 //no need to get uvw, just return true at the first sign of a hit
 bool TriMesh::isHitBySegment(const QVector3D& segmentStart,const QVector3D& segmentEnd,QVector3D& hitPoint)
 {
-    for(auto tri:triangles)
-    {
-        auto ab = tri.b - tri.a;
-        auto ac = tri.c - tri.a;
-        auto qp = segmentStart-segmentEnd;
+    buildBvh();
+
+    auto qp = segmentStart - segmentEnd;
+    bool hit = false;
+
+    bvh.traverseSegmentLeaves(segmentStart, segmentEnd, [&](int start, int count, float& maxT) {
+        for (int i = 0; i < count; i += TRIMESH_PACKET_SIZE) {
+            float t[TRIMESH_PACKET_SIZE];
+            int mask = intersectPacket(start + i, qMin(TRIMESH_PACKET_SIZE, count - i), segmentStart, qp, t);
+            if (!mask)
+                continue;
+
+            for (int lane = 0; lane < TRIMESH_PACKET_SIZE; lane++) {
+                if (mask & (1 << lane)) {
+                    //t is in range 0 and 1 and denotes how far along the distance the hit is
+                    hitPoint = segmentStart + (segmentEnd-segmentStart)*t[lane];
+                    hit = true;
+                    return false;
+                }
+            }
+        }
+        return true;
+    });
 
-        //auto normal = tri.normal;
-        auto normal = QVector3D::crossProduct(ab, ac);
-        float d = QVector3D::dotProduct(qp, normal);
+    return hit;
+}
 
-        //if (d <= 0)
-        //    continue;
-        if (d == 0) continue;
+/**
+ * Does a segment-mesh intersection test
+ * Returns number of intersections
+ * @return
+ */
+int TriMesh::getSegmentIntersections(const QVector3D& segmentStart,const QVector3D& segmentEnd,QList<TriangleIntersectionResult>& results)
+{
+    buildBvh();
 
-        auto ap = segmentStart - tri.a;
-        auto t = QVector3D::dotProduct(ap, normal);
+    auto qp = segmentStart - segmentEnd;
+    int hits = 0;
 
-        if (t < 0 || t > d)
-            continue;
+    bvh.traverseSegmentLeaves(segmentStart, segmentEnd, [&](int start, int count, float& maxT) {
+        for (int i = 0; i < count; i += TRIMESH_PACKET_SIZE) {
+            float t[TRIMESH_PACKET_SIZE];
+            int mask = intersectPacket(start + i, qMin(TRIMESH_PACKET_SIZE, count - i), segmentStart, qp, t);
+            if (!mask)
+                continue;
+
+            for (int lane = 0; lane < TRIMESH_PACKET_SIZE; lane++) {
+                if (mask & (1 << lane)) {
+                    TriangleIntersectionResult result;
+                    result.triangleIndex = bvh.primitiveIndices[start + i + lane];
+                    result.hitPoint = segmentStart + (segmentEnd-segmentStart)*t[lane];
+                    result.t = t[lane];
+                    results.append(result);
+                    hits++;
+                }
+            }
+        }
+        return true;
+    });
 
-        auto e = QVector3D::crossProduct(qp, ap);
-        auto v = QVector3D::dotProduct(ac, e);
+    return hits;
+}
 
-        if (v < 0.0f || v > d)
-            continue;
+bool TriMesh::getClosestSegmentIntersection(const QVector3D& segmentStart, const QVector3D& segmentEnd, TriangleIntersectionResult& result)
+{
+    buildBvh();
+
+    auto qp = segmentStart - segmentEnd;
+    bool hit = false;
+
+    bvh.traverseSegmentLeaves(segmentStart, segmentEnd, [&](int start, int count, float& maxT) {
+        for (int i = 0; i < count; i += TRIMESH_PACKET_SIZE) {
+            float t[TRIMESH_PACKET_SIZE];
+            int mask = intersectPacket(start + i, qMin(TRIMESH_PACKET_SIZE, count - i), segmentStart, qp, t);
+            if (!mask)
+                continue;
+
+            for (int lane = 0; lane < TRIMESH_PACKET_SIZE; lane++) {
+                // anything further than the closest hit so far can be skipped
+                if ((mask & (1 << lane)) && t[lane] < maxT) {
+                    maxT = t[lane];
+                    result.triangleIndex = bvh.primitiveIndices[start + i + lane];
+                    result.t = t[lane];
+                    hit = true;
+                }
+            }
+        }
+        return true;
+    });
 
-        auto w = -QVector3D::dotProduct(ab, e);
+    if (hit)
+        result.hitPoint = segmentStart + (segmentEnd-segmentStart)*result.t;
 
-        if (w < 0.0f || v + w > d)
-            continue;
+    return hit;
+}
 
-        t /= d;
+AABB TriMesh::getBounds()
+{
+    return AABB::fromPoints(vertices);
+}
 
-        //all conditions have been met
-        //todo: fix please. return t instead
-        hitPoint = segmentStart + (segmentEnd-segmentStart)*t;//t is in range 0 and 1 and denotes how far along the distance the hit is
-        return true;
+void TriMesh::buildBvh()
+{
+    if (!bvhDirty)
+        return;
+
+    const int triCount = getTriangleCount();
+
+    QVector<AABB> bounds(triCount);
+    for (int i = 0; i < triCount; i++) {
+        QVector3D a, b, c;
+        getTriangle(i, a, b, c);
+        bounds[i].merge(a);
+        bounds[i].merge(b);
+        bounds[i].merge(c);
     }
 
-    return false;
+    // leaves are tested a packet at a time so there's no point splitting them further
+    bvh.build(bounds, TRIMESH_PACKET_SIZE);
+
+    // the streams are padded so the last packet can always be loaded whole
+    packedStride = triCount + TRIMESH_PACKET_SIZE;
+    packedTriangles.fill(0.0f, packedStride * PackedComponentCount);
+
+    float* data = packedTriangles.data();
+    for (int i = 0; i < triCount; i++) {
+        QVector3D a, b, c;
+        getTriangle(bvh.primitiveIndices[i], a, b, c);
+
+        auto ab = b - a;
+        auto ac = c - a;
+        auto normal = QVector3D::crossProduct(ab, ac);
+
+        data[AX * packedStride + i] = a.x();
+        data[AY * packedStride + i] = a.y();
+        data[AZ * packedStride + i] = a.z();
+        data[ABX * packedStride + i] = ab.x();
+        data[ABY * packedStride + i] = ab.y();
+        data[ABZ * packedStride + i] = ab.z();
+        data[ACX * packedStride + i] = ac.x();
+        data[ACY * packedStride + i] = ac.y();
+        data[ACZ * packedStride + i] = ac.z();
+        data[NX * packedStride + i] = normal.x();
+        data[NY * packedStride + i] = normal.y();
+        data[NZ * packedStride + i] = normal.z();
+    }
+
+    bvhDirty = false;
 }
 
-/**
- * Does a segment-mesh intersection test
- * Returns number of intersections
- * @return
- */
-int TriMesh::getSegmentIntersections(const QVector3D& segmentStart,const QVector3D& segmentEnd,QList<TriangleIntersectionResult>& results)
+// segment-triangle test from realtime rendering page 192 with the cross product precomputed
+// back faces and triangles parallel to the segment are never hit
+#ifdef TRIMESH_USE_SSE
+int TriMesh::intersectPacket(int first, int count, const QVector3D& segmentStart, const QVector3D& qp, float t[4]) const
 {
-    int hits = 0;
-    for(auto i=0;i<triangles.size();i++)
-    {
-        //auto tri = triangles[i];
-        const Triangle& tri = triangles[i];
-        auto ab = tri.b - tri.a;
-        auto ac = tri.c - tri.a;
-        auto qp = segmentStart-segmentEnd;
-
-        //auto normal = tri.normal;
-        auto normal = QVector3D::crossProduct(ab, ac);
-        float d = QVector3D::dotProduct(qp, normal);
+    const float* data = packedTriangles.constData() + first;
+    auto load = [data, this](PackedComponent comp) {
+        return _mm_loadu_ps(data + comp * packedStride);
+    };
+
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 qpx = _mm_set1_ps(qp.x());
+    const __m128 qpy = _mm_set1_ps(qp.y());
+    const __m128 qpz = _mm_set1_ps(qp.z());
+
+    const __m128 nx = load(NX);
+    const __m128 ny = load(NY);
+    const __m128 nz = load(NZ);
+
+    // d = qp . normal
+    __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(qpx, nx), _mm_mul_ps(qpy, ny)), _mm_mul_ps(qpz, nz));
+    __m128 valid = _mm_cmpgt_ps(d, zero);
+
+    // ap = segmentStart - a
+    const __m128 apx = _mm_sub_ps(_mm_set1_ps(segmentStart.x()), load(AX));
+    const __m128 apy = _mm_sub_ps(_mm_set1_ps(segmentStart.y()), load(AY));
+    const __m128 apz = _mm_sub_ps(_mm_set1_ps(segmentStart.z()), load(AZ));
+
+    __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(apx, nx), _mm_mul_ps(apy, ny)), _mm_mul_ps(apz, nz));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(dist, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(dist, d));
+
+    // e = qp x ap
+    const __m128 ex = _mm_sub_ps(_mm_mul_ps(qpy, apz), _mm_mul_ps(qpz, apy));
+    const __m128 ey = _mm_sub_ps(_mm_mul_ps(qpz, apx), _mm_mul_ps(qpx, apz));
+    const __m128 ez = _mm_sub_ps(_mm_mul_ps(qpx, apy), _mm_mul_ps(qpy, apx));
+
+    __m128 v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(load(ACX), ex), _mm_mul_ps(load(ACY), ey)), _mm_mul_ps(load(ACZ), ez));
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(v, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(v, d));
+
+    __m128 w = _mm_add_ps(_mm_add_ps(_mm_mul_ps(load(ABX), ex), _mm_mul_ps(load(ABY), ey)), _mm_mul_ps(load(ABZ), ez));
+    w = _mm_sub_ps(zero, w);
+    valid = _mm_and_ps(valid, _mm_cmpge_ps(w, zero));
+    valid = _mm_and_ps(valid, _mm_cmple_ps(_mm_add_ps(v, w), d));
+
+    int mask = _mm_movemask_ps(valid) & ((1 << count) - 1);
+    if (mask)
+        _mm_storeu_ps(t, _mm_div_ps(dist, d));
+
+    return mask;
+}
+#else
+int TriMesh::intersectPacket(int first, int count, const QVector3D& segmentStart, const QVector3D& qp, float t[4]) const
+{
+    const float* data = packedTriangles.constData() + first;
+    int mask = 0;
 
+    for (int i = 0; i < count; i++) {
+        auto get = [data, i, this](PackedComponent comp) {
+            return data[comp * packedStride + i];
+        };
+
+        QVector3D normal(get(NX), get(NY), get(NZ));
+        float d = QVector3D::dotProduct(qp, normal);
         if (d <= 0)
             continue;
 
-        auto ap = segmentStart - tri.a;
-        auto t = QVector3D::dotProduct(ap, normal);
-
-        if (t < 0 || t > d)
+        auto ap = segmentStart - QVector3D(get(AX), get(AY), get(AZ));
+        float dist = QVector3D::dotProduct(ap, normal);
+        if (dist < 0 || dist > d)
             continue;
 
         auto e = QVector3D::crossProduct(qp, ap);
-        auto v = QVector3D::dotProduct(ac, e);
-
-        if (v < 0 || v > d)
+        auto v = QVector3D::dotProduct(QVector3D(get(ACX), get(ACY), get(ACZ)), e);
+        if (v < 0.0f || v > d)
             continue;
 
-        auto w = -QVector3D::dotProduct(ab, e);
-
+        auto w = -QVector3D::dotProduct(QVector3D(get(ABX), get(ABY), get(ABZ)), e);
         if (w < 0.0f || v + w > d)
             continue;
 
-        t /= d;
-
-        //all conditions have been met
-        hits++;
-
-        auto dist = segmentStart.distanceToPoint(segmentEnd);
-        auto hitPoint = segmentStart + (segmentEnd-segmentStart)*t;
-
-        TriangleIntersectionResult result;
-        result.triangleIndex = i;
-        result.hitPoint = hitPoint;
-        result.t = t;
-        //result.hitPoint = tri.a*u + tri.b*v + tri.c*w;
-        results.append(result);
-        hits++;
+        t[i] = dist / d;
+        mask |= 1 << i;
     }
 
-    return hits;
+    return mask;
 }
+#endif
 
 }
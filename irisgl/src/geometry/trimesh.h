@@ -13,7 +13,9 @@ For more information see the LICENSE file
 #define TRIMESH_H
 
 #include <QVector3D>
+#include <QVector>
 #include <QList>
+#include "bvh.h"
 
 namespace iris
 {
@@ -30,23 +32,36 @@ struct TriangleIntersectionResult
     }
 };
 
-class Triangle
-{
-public:
-    //triangle's points in counter-clockwise order
-    QVector3D a,b,c;
-    QVector3D normal;
-};
-
 
 /**
  * This class defines a mesh using triangles. It's used for ray-casting and intersection tests
+ * Triangles are stored as indices into a shared vertex array
  */
 class TriMesh
 {
+    // built on the first segment query and rebuilt if triangles are added afterwards
+    BoundingVolumeHierarchy bvh;
+    bool bvhDirty;
+
+    // the triangles in bvh order with their first point, edges and normal precomputed
+    // each component is a separate stream of packedStride floats so four triangles can be
+    // loaded with one instruction
+    QVector<float> packedTriangles;
+    int packedStride;
+
 public:
-    QList<Triangle> triangles;
+    QVector<QVector3D> vertices;
+    // three indices per triangle, counter-clockwise
+    QVector<unsigned int> indices;
 
+    TriMesh();
+
+    /**
+     * Replaces the mesh's triangles
+     * @param vertices
+     * @param indices three per triangle, assumed to be in counter-clockwise order
+     */
+    void setTriangles(const QVector<QVector3D>& vertices, const QVector<unsigned int>& indices);
 
     /**
      * Adds points for triangle. Assumes points are in a counter-clockwise rotation.
@@ -56,6 +71,18 @@ public:
      */
     void addTriangle(const QVector3D& a, const QVector3D& b, const QVector3D& c);
 
+    int getTriangleCount() const
+    {
+        return indices.size() / 3;
+    }
+
+    void getTriangle(int index, QVector3D& a, QVector3D& b, QVector3D& c) const
+    {
+        a = vertices[indices[index * 3]];
+        b = vertices[indices[index * 3 + 1]];
+        c = vertices[indices[index * 3 + 2]];
+    }
+
     //https://github.com/qt/qt3d/blob/5476bc6b4b6a12c921da502c24c4e078b04dd3b3/src/render/jobs/pickboundingvolumejob.cpp
     //realtime rendering page 192
     //no need to get uvw, just return true at the first sign of a hit
@@ -68,7 +95,25 @@ public:
      */
     int getSegmentIntersections(const QVector3D& segmentStart, const QVector3D& segmentEnd, QList<TriangleIntersectionResult>& results);
 
+    /**
+     * Finds the hit closest to segmentStart without collecting every intersection
+     * Returns false if the segment doesnt hit the mesh
+     */
+    bool getClosestSegmentIntersection(const QVector3D& segmentStart, const QVector3D& segmentEnd, TriangleIntersectionResult& result);
 
+    /**
+     * Returns the bounds of all the triangles
+     */
+    AABB getBounds();
+
+private:
+    void buildBvh();
+
+    /**
+     * Tests up to four packed triangles starting at first against the segment
+     * Returns a bitmask of the ones that were hit, their distances along the segment are written to t
+     */
+    int intersectPacket(int first, int count, const QVector3D& segmentStart, const QVector3D& qp, float t[4]) const;
 };
 
 
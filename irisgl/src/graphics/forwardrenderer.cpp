@@ -25,6 +25,7 @@ For more information see the LICENSE file
 #include "material.h"
 #include "renderitem.h"
 #include "shadowmap.h"
+#include "lightclusters.h"
 #include <QOpenGLContext>
 #include <QOpenGLShaderProgram>
 #include <QOpenGLFunctions>
@@ -32,10 +33,15 @@ For more information see the LICENSE file
 #include <QSharedPointer>
 #include <QOpenGLTexture>
 #include <QMatrix4x4>
+#include <QVector4D>
+#include <QtMath>
+#include <cstring>
+#include <algorithm>
 #include "viewport.h"
 #include "utils/billboard.h"
 #include "utils/fullscreenquad.h"
 #include "texture2d.h"
+#include "textureloader.h"
 #include "rendertarget.h"
 #include "renderlist.h"
 #include "graphicsdevice.h"
@@ -91,7 +97,6 @@ ForwardRenderer::ForwardRenderer(bool supportsVr, bool physicsEnabled)
     renderTarget = RenderTarget::create(800, 800);
     sceneRenderTexture = Texture2D::create(800, 800);
     depthRenderTexture = Texture2D::createDepth(800, 800);
-    finalRenderTexture = Texture2D::create(800, 800);
     renderTarget->addTexture(sceneRenderTexture);
     renderTarget->setDepthTexture(depthRenderTexture);
 
@@ -101,7 +106,18 @@ ForwardRenderer::ForwardRenderer(bool supportsVr, bool physicsEnabled)
     perfTimer = new PerformanceTimer();
 
     renderLightBillboards = true;
-	generateLightUnformNames();
+    shadowCastersPrepared = false;
+	generateUniformHandles();
+
+    cameraDataBuffer = UniformBuffer::create();
+    sceneDataBuffer = UniformBuffer::create();
+    graphics->registerUniformBlock("CameraData", CAMERA_DATA_BINDING);
+    graphics->registerUniformBlock("SceneData", SCENE_DATA_BINDING);
+    lightClusters = new LightClusters();
+
+    instanceDataBuffer = UniformBuffer::create();
+    instanceBlockData.fill(0.0f, MAX_INSTANCES_PER_DRAW * 16);
+    graphics->registerUniformBlock("InstanceData", INSTANCE_DATA_BINDING);
 
 }
 
@@ -144,6 +160,10 @@ GraphicsDevicePtr ForwardRenderer::getGraphicsDevice()
 void ForwardRenderer::renderSceneToRenderTarget(RenderTargetPtr rt, CameraNodePtr cam, bool clearRenderLists, bool applyPostProcesses)
 {
     auto ctx = QOpenGLContext::currentContext();
+    renderStats.reset();
+
+    // textures finished loading in the background
+    TextureLoader::update();
 
     // reset states
     graphics->setBlendState(BlendState::Opaque, true);
@@ -167,15 +187,12 @@ void ForwardRenderer::renderSceneToRenderTarget(RenderTargetPtr rt, CameraNodePt
     renderData->fogEnd = scene->fogEnd;
     renderData->fogEnabled = scene->fogEnabled;
 
-    if (scene->shadowEnabled) {
-        renderShadows(scene);
-    }
+    renderShadows(scene);
 
     gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     //todo: remember to remove this!
     renderTarget->resize(rt->getWidth(), rt->getHeight(), true);
-    finalRenderTexture->resize(rt->getWidth(), rt->getHeight());
 
     renderTarget->bind();
 	graphics->setViewport(QRect(0, 0, rt->getWidth(), rt->getHeight()));
@@ -201,7 +218,6 @@ void ForwardRenderer::renderSceneToRenderTarget(RenderTargetPtr rt, CameraNodePt
     if (applyPostProcesses) {
         postContext->sceneTexture = sceneRenderTexture;
         postContext->depthTexture = depthRenderTexture;
-        postContext->finalTexture = finalRenderTexture;
         postMan->process(postContext);
     }
 
@@ -240,6 +256,10 @@ void ForwardRenderer::renderScene(float delta, Viewport* vp)
     //perfTimer->start("total");
     auto ctx = QOpenGLContext::currentContext();
     auto cam = scene->camera;
+    renderStats.reset();
+
+    // textures finished loading in the background
+    TextureLoader::update();
 
     // reset states
     graphics->setBlendState(BlendState::Opaque, true);
@@ -264,16 +284,13 @@ void ForwardRenderer::renderScene(float delta, Viewport* vp)
     renderData->fogEnd = scene->fogEnd;
     renderData->fogEnabled = scene->fogEnabled;
 
-    if (scene->shadowEnabled) {
-        renderShadows(scene);
-    }
+    renderShadows(scene);
 
     gl->glViewport(0, 0, vp->width * vp->pixelRatioScale, vp->height * vp->pixelRatioScale);
 
     gl->glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
     renderTarget->resize(vp->width * vp->pixelRatioScale, vp->height * vp->pixelRatioScale, true);
-    finalRenderTexture->resize(vp->width * vp->pixelRatioScale, vp->height * vp->pixelRatioScale);
 
     renderTarget->bind();
     graphics->setViewport(QRect(0, 0, vp->width * vp->pixelRatioScale, vp->height * vp->pixelRatioScale));
@@ -301,7 +318,6 @@ void ForwardRenderer::renderScene(float delta, Viewport* vp)
 
     postContext->sceneTexture = sceneRenderTexture;
     postContext->depthTexture = depthRenderTexture;
-    postContext->finalTexture = finalRenderTexture;
     postMan->process(postContext);
 
     gl->glBindFramebuffer(GL_FRAMEBUFFER, ctx->defaultFramebufferObject());
@@ -319,6 +335,9 @@ void ForwardRenderer::renderScene(float delta, Viewport* vp)
     fsQuad->draw(graphics);
     gl->glBindTexture(GL_TEXTURE_2D, 0);
 
+    // the viewer preview and screenshots were processed before this
+    postMan->endFrame();
+
     graphics->clear(GL_DEPTH_BUFFER_BIT);
     // STEP 5: RENDER SELECTED OBJECT
     //if (!!selectedSceneNode && selectedSceneNode->isVisible())
@@ -337,82 +356,284 @@ void ForwardRenderer::renderScene(float delta, Viewport* vp)
 
 void ForwardRenderer::renderShadows(ScenePtr node)
 {
+    // the casters are only sorted once a shadow map actually needs them
+    shadowCastersPrepared = false;
+
     for (auto light : scene->lights) {
-		if (light->getShadowMapType() != iris::ShadowMapType::None) {
-			if (light->lightType == iris::LightType::Directional) {
-				renderDirectionalShadow(light, scene);
-			}
-			else if (light->lightType == iris::LightType::Spot) {
-				renderSpotlightShadow(light, scene);
-			}
-		}
+        // changes aren't tracked for maps that aren't drawn so they start over when they are
+        if (!scene->shadowEnabled || light->getShadowMapType() == iris::ShadowMapType::None) {
+            light->shadowMap->invalidate();
+            continue;
+        }
+
+        if (light->lightType == iris::LightType::Directional) {
+            renderDirectionalShadow(light, scene);
+        }
+        else if (light->lightType == iris::LightType::Spot) {
+            renderSpotlightShadow(light, scene);
+        }
     }
+
+    scene->clearShadowDirtyState();
+
+	graphics->setRasterizerState(RasterizerState::CullCounterClockwise);
+    graphics->clearRenderTarget();
 }
 
-void ForwardRenderer::renderDirectionalShadow(LightNodePtr light, ScenePtr node)
+bool ForwardRenderer::isShadowLayerCached(ShadowMap* shadowMap, int layer, const QMatrix4x4& lightSpaceMatrix)
 {
-    graphics->setRenderTarget(QList<Texture2DPtr>(),light->shadowMap->shadowTexture);
-	graphics->setRasterizerState(RasterizerState::CullClockwise);
+    if (scene->areShadowsDirty() ||
+        !shadowMap->layerCached[layer] ||
+        shadowMap->renderedMatrices[layer] != lightSpaceMatrix)
+        return false;
+
+    auto& dirtyBounds = scene->getShadowDirtyBounds();
+    if (dirtyBounds.isEmpty())
+        return true;
+
+    Frustum frustum;
+    frustum.build(lightSpaceMatrix);
+    for (auto bounds : dirtyBounds) {
+        if (frustum.isSphereInside(&bounds))
+            return false;
+    }
 
-    int shadowSize = light->shadowMap->resolution;
+    return true;
+}
+
+void ForwardRenderer::renderShadowLayer(ShadowMap* shadowMap, int layer, const QMatrix4x4& lightSpaceMatrix)
+{
+    if (isShadowLayerCached(shadowMap, layer, lightSpaceMatrix)) {
+        renderStats.shadowLayersReused++;
+        return;
+    }
+
+    if (!shadowCastersPrepared) {
+        // the shadow shader is the same for all static meshes so
+        // copies of a mesh can be drawn together
+        // sorting and batching is done once, each light only culls the casters
+        scene->shadowRenderList->sortByMesh();
+        scene->shadowRenderList->batchInstances(false);
+        shadowCastersPrepared = true;
+    }
+
+    int shadowSize = shadowMap->resolution;
+    graphics->setRenderTarget(QList<Texture2DPtr>(), shadowMap->shadowTexture, layer);
+	graphics->setRasterizerState(RasterizerState::CullClockwise);
     graphics->setViewport(QRect(0, 0, shadowSize, shadowSize));
     graphics->clear(QColor());
-    //gl->glClear(COLOR_BUFFER_BIT|DEPTH_BUFFER_BIT);
-    QMatrix4x4 lightProjection, lightView;
-    QOpenGLShaderProgram* shader;
 
-    lightProjection.ortho(-128.0f, 128.0f, -64.0f, 64.0f, -64.0f, 128.0f);
+    renderShadowCasters(lightSpaceMatrix);
+
+    shadowMap->renderedMatrices[layer] = lightSpaceMatrix;
+    shadowMap->layerCached[layer] = true;
+}
+
+void ForwardRenderer::renderDirectionalShadow(LightNodePtr light, ScenePtr node)
+{
+    auto shadowMap = light->shadowMap;
+    const int cascadeCount = shadowMap->cascadeCount;
+    shadowMap->setLayerCount(cascadeCount);
 
+    int shadowSize = shadowMap->resolution;
+
+    QMatrix4x4 lightView;
     lightView.lookAt(QVector3D(0, 0, 0),
                      light->getLightDir(),
                      QVector3D(0.0001f, 1.0001f, 0.0001f));
-    QMatrix4x4 lightSpaceMatrix = lightProjection * lightView;
-    light->shadowMap->shadowMatrix = lightSpaceMatrix;
 
-    for (auto& item : scene->shadowRenderList->getItems()) {
+    // corners of the camera's frustum, the near plane's first
+    QMatrix4x4 invViewProj = (renderData->projMatrix * renderData->viewMatrix).inverted();
+    QVector3D corners[8];
+    int cornerIndex = 0;
+    for (int z = -1; z <= 1; z += 2)
+        for (int y = -1; y <= 1; y += 2)
+            for (int x = -1; x <= 1; x += 2)
+                corners[cornerIndex++] = (invViewProj * QVector4D(x, y, z, 1)).toVector3DAffine();
+
+    // view depth changes linearly along the edges from the near to the far plane
+    auto viewDepth = [this](const QVector3D& point) {
+        return -renderData->viewMatrix.map(point).z();
+    };
+    const float nearDepth = viewDepth((corners[0] + corners[3]) * 0.5f);
+    const float farDepth = viewDepth((corners[4] + corners[7]) * 0.5f);
+    const float shadowFar = qMin(farDepth, nearDepth + shadowMap->shadowDistance);
+
+    // splits are a blend of logarithmic and even spacing, even spacing wastes
+    // resolution up close and logarithmic spacing makes the nearest cascade tiny
+    // orthographic cameras can have a negative near plane so they get even splits
+    const float lambda = nearDepth > 0.0f ? 0.75f : 0.0f;
+    float splits[SHADOW_MAX_CASCADES + 1];
+    for (int i = 0; i <= cascadeCount; i++) {
+        float fraction = i / (float)cascadeCount;
+        float evenSplit = nearDepth + (shadowFar - nearDepth) * fraction;
+        float logSplit = lambda > 0.0f ? nearDepth * qPow(shadowFar / nearDepth, fraction) : evenSplit;
+        splits[i] = lambda * logSplit + (1.0f - lambda) * evenSplit;
+    }
 
+    for (int cascade = 0; cascade < cascadeCount; cascade++) {
+        float start = (splits[cascade] - nearDepth) / (farDepth - nearDepth);
+        float end = (splits[cascade + 1] - nearDepth) / (farDepth - nearDepth);
+
+        QVector3D center;
+        QVector3D sliceCorners[8];
+        for (int i = 0; i < 4; i++) {
+            QVector3D edge = corners[i + 4] - corners[i];
+            sliceCorners[i] = corners[i] + edge * start;
+            sliceCorners[i + 4] = corners[i] + edge * end;
+            center += sliceCorners[i] + sliceCorners[i + 4];
+        }
+        center /= 8.0f;
+
+        // a sphere's bounds don't change as the camera turns so the shadow
+        // edges don't swim, the radius is rounded to keep it from flickering
+        float radius = 0.0f;
+        for (int i = 0; i < 8; i++)
+            radius = qMax(radius, (sliceCorners[i] - center).length());
+        radius = qCeil(radius * 16.0f) / 16.0f;
+
+        // only moving the cascade in whole texels keeps it stable as the camera moves
+        QVector3D lightCenter = lightView.map(center);
+        float texelSize = (radius * 2.0f) / shadowSize;
+        lightCenter.setX(qFloor(lightCenter.x() / texelSize) * texelSize);
+        lightCenter.setY(qFloor(lightCenter.y() / texelSize) * texelSize);
+
+        // the near plane is pulled back so casters between the light and the slice still get drawn
+        QMatrix4x4 lightProjection;
+        lightProjection.ortho(lightCenter.x() - radius, lightCenter.x() + radius,
+                              lightCenter.y() - radius, lightCenter.y() + radius,
+                              -lightCenter.z() - radius - shadowMap->shadowDistance,
+                              -lightCenter.z() + radius);
+
+        QMatrix4x4 lightSpaceMatrix = lightProjection * lightView;
+        shadowMap->cascadeMatrices[cascade] = lightSpaceMatrix;
+        if (cascade == 0)
+            shadowMap->shadowMatrix = lightSpaceMatrix;
+
+        renderShadowLayer(shadowMap, cascade, lightSpaceMatrix);
+    }
+}
 
-        if (item->type == iris::RenderItemType::Mesh && !!item->mesh) {
-            if  (item->mesh->hasSkeleton()) {
-                auto boneTransforms = item->mesh->getSkeleton()->boneTransforms;
-                skinnedShadowShader->bind();
-                skinnedShadowShader->setUniformValue("u_lightSpaceMatrix", lightSpaceMatrix);
-                skinnedShadowShader->setUniformValue("u_worldMatrix", item->worldMatrix);
-                skinnedShadowShader->setUniformValueArray("u_bones", boneTransforms.data(), boneTransforms.size());
-                shader = skinnedShadowShader;
+void ForwardRenderer::renderShadowCasters(const QMatrix4x4& lightSpaceMatrix)
+{
+    auto renderList = scene->shadowRenderList;
+    auto items = renderList->getItems();
+
+    Frustum frustum;
+    frustum.build(lightSpaceMatrix);
+    renderStats.shadowCastersCulled += renderList->cull(frustum);
+
+    // the list is sorted with static meshes before skinned ones and static meshes
+    // all go through the instanced shader, even when alone, so there's at most one
+    // shader switch per light
+    QOpenGLShaderProgram* boundShader = nullptr;
+    auto bindShadowShader = [&](QOpenGLShaderProgram* shader) {
+        if (boundShader == shader)
+            return;
+
+        shader->bind();
+        shader->setUniformValue("u_lightSpaceMatrix", lightSpaceMatrix);
+        boundShader = shader;
+    };
+
+    for (int i = 0; i < items.size(); i++) {
+        auto item = items[i];
+        int batchSize = renderList->getInstanceCount(i);
+
+        // drawn as part of an earlier batch
+        if (batchSize == 0)
+            continue;
+
+        if (item->type != iris::RenderItemType::Mesh || !item->mesh)
+            continue;
+
+        // skinned meshes can be animated out of their bind pose bounds so they aren't culled
+        if (item->mesh->hasSkeleton()) {
+            auto& boneTransforms = item->mesh->getSkeleton()->boneTransforms;
+            bindShadowShader(skinnedShadowShader);
+            skinnedShadowShader->setUniformValue("u_worldMatrix", item->worldMatrix);
+            skinnedShadowShader->setUniformValueArray("u_bones", boneTransforms.data(), boneTransforms.size());
 
-            } else {
-                shadowShader->bind();
-                shadowShader->setUniformValue("u_lightSpaceMatrix", lightSpaceMatrix);
-                shadowShader->setUniformValue("u_worldMatrix", item->worldMatrix);
-                shader = shadowShader;
-            }
+            item->mesh->draw(graphics);
+            renderStats.drawCalls++;
+            continue;
+        }
 
+        if (gatherInstances(items, i, batchSize) == 0)
+            continue;
 
+        bindShadowShader(instancedShadowShader);
+        drawInstances(item->mesh);
+    }
+}
 
-            //item->mesh->draw(gl, shader);
-            item->mesh->draw(graphics);
+// lights of a batch's instances, which are all drawn with the same uniforms
+// each instance's most relevant lights are taken first
+static int gatherBatchLights(const QVector<RenderItem*>& items, int start, int count, int* lights)
+{
+    int lightCount = 0;
+    for (int rank = 0; rank < RENDER_ITEM_MAX_LIGHTS; rank++) {
+        for (int i = start; i < start + count; i++) {
+            auto item = items[i];
+            if (rank >= item->lightCount)
+                continue;
+
+            int light = item->lights[rank];
+            if (std::find(lights, lights + lightCount, light) != lights + lightCount)
+                continue;
+
+            lights[lightCount++] = light;
+            if (lightCount == RENDER_ITEM_MAX_LIGHTS)
+                return lightCount;
         }
     }
-	graphics->setRasterizerState(RasterizerState::CullCounterClockwise);
-    graphics->clearRenderTarget();
+
+    return lightCount;
+}
+
+int ForwardRenderer::gatherInstances(const QVector<RenderItem*>& items, int start, int count)
+{
+    instanceMatrices.clear();
+    for (int i = start; i < start + count; i++) {
+        auto item = items[i];
+        if (item->culled) continue;
+
+        instanceMatrices.append(item->worldMatrix);
+    }
+
+    return instanceMatrices.size();
+}
+
+void ForwardRenderer::drawInstances(MeshPtr mesh)
+{
+    int drawn = 0;
+    while (drawn < instanceMatrices.size()) {
+        int count = qMin(instanceMatrices.size() - drawn, MAX_INSTANCES_PER_DRAW);
+
+        // the block is always sent whole, gl requires the bound
+        // range to be at least as big as the block
+        float* blockData = instanceBlockData.data();
+        for (int i = 0; i < count; i++)
+            memcpy(blockData + i * 16, instanceMatrices[drawn + i].constData(), sizeof(float) * 16);
+
+        instanceDataBuffer->setData(blockData, sizeof(float) * instanceBlockData.size());
+        graphics->setUniformBuffer(INSTANCE_DATA_BINDING, instanceDataBuffer);
+
+        mesh->drawInstanced(graphics, count);
+        renderStats.drawCalls++;
+        drawn += count;
+    }
 }
 
 void ForwardRenderer::renderSpotlightShadow(LightNodePtr light, ScenePtr node)
 {
-    graphics->setRenderTarget(QList<Texture2DPtr>(),light->shadowMap->shadowTexture);
-	graphics->setRasterizerState(RasterizerState::CullClockwise);
+    light->shadowMap->setLayerCount(1);
     //gl->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadowFBO);
     //gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, light->shadowMap->shadowTexture->getTextureId(), 0);
     //gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, light->shadowMap->shadowTexId, 0);
     //gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowDepthMap, 0);
 
-    int shadowSize = light->shadowMap->resolution;
-    graphics->setViewport(QRect(0, 0, shadowSize, shadowSize));
-    graphics->clear(QColor());
-
     QMatrix4x4 lightProjection, lightView;
-    QOpenGLShaderProgram* shader;
 
     lightProjection.perspective(light->spotCutOff*2, 1,0.1f,light->distance);
 
@@ -421,33 +642,9 @@ void ForwardRenderer::renderSpotlightShadow(LightNodePtr light, ScenePtr node)
                      QVector3D(0.0f, 1.0f, 0.0f));
     QMatrix4x4 lightSpaceMatrix = lightProjection * lightView;
     light->shadowMap->shadowMatrix = lightSpaceMatrix;
+    light->shadowMap->cascadeMatrices[0] = lightSpaceMatrix;
 
-    for (auto& item : scene->shadowRenderList->getItems()) {
-
-
-        if (item->type == iris::RenderItemType::Mesh && !!item->mesh) {
-            if  (item->mesh->hasSkeleton()) {
-                auto boneTransforms = item->mesh->getSkeleton()->boneTransforms;
-                skinnedShadowShader->bind();
-                skinnedShadowShader->setUniformValue("u_lightSpaceMatrix", lightSpaceMatrix);
-                skinnedShadowShader->setUniformValue("u_worldMatrix", item->worldMatrix);
-                skinnedShadowShader->setUniformValueArray("u_bones", boneTransforms.data(), boneTransforms.size());
-                shader = skinnedShadowShader;
-
-            } else {
-                shadowShader->bind();
-                shadowShader->setUniformValue("u_lightSpaceMatrix", lightSpaceMatrix);
-                shadowShader->setUniformValue("u_worldMatrix", item->worldMatrix);
-                shader = shadowShader;
-            }
-
-            //item->mesh->draw(gl, shader);
-            item->mesh->draw(graphics);
-        }
-    }
-
-	graphics->setRasterizerState(RasterizerState::CullCounterClockwise);
-    graphics->clearRenderTarget();
+    renderShadowLayer(light->shadowMap, 0, lightSpaceMatrix);
 }
 
 void ForwardRenderer::renderSceneVr(float delta, Viewport* vp, bool useViewer)
@@ -455,6 +652,10 @@ void ForwardRenderer::renderSceneVr(float delta, Viewport* vp, bool useViewer)
     auto ctx = QOpenGLContext::currentContext();
     if(!vrDevice->isVrSupported())
         return;
+    renderStats.reset();
+
+    // textures finished loading in the background
+    TextureLoader::update();
 
     QVector3D viewerPos = scene->camera->getGlobalPosition();
     QMatrix4x4 viewTransform = scene->camera->globalTransform;
@@ -471,9 +672,11 @@ void ForwardRenderer::renderSceneVr(float delta, Viewport* vp, bool useViewer)
     graphics->setDepthState(DepthState::Default);
     graphics->setRasterizerState(RasterizerState::CullCounterClockwise);
 
-    if (scene->shadowEnabled) {
-        renderShadows(scene);
-    }
+    // cascades are fitted to the viewer, the eyes are close enough
+    // together that they fit in the same cascades
+    renderData->viewMatrix = viewTransform.inverted();
+    renderData->projMatrix = vrDevice->getEyeProjMatrix(0, 0.1f, 1000.0f);
+    renderShadows(scene);
 
     vrDevice->beginFrame();
 
@@ -487,6 +690,8 @@ void ForwardRenderer::renderSceneVr(float delta, Viewport* vp, bool useViewer)
 		graphics->setRasterizerState(RasterizerState::CullCounterClockwise);
 
         vrDevice->beginEye(eye);
+        // beginEye sets the gl viewport itself, the device's copy is used to map fragments to light clusters
+        graphics->setViewport(QRect(0, 0, vrDevice->getEyeWidth(), vrDevice->getEyeHeight()));
 
         auto view = vrDevice->getEyeViewMatrix(eye, viewerPos, viewTransform);
         renderData->eyePos = view.column(3).toVector3D();
@@ -494,6 +699,7 @@ void ForwardRenderer::renderSceneVr(float delta, Viewport* vp, bool useViewer)
 
         auto proj = vrDevice->getEyeProjMatrix(eye,0.1f,1000.0f);
         renderData->projMatrix = proj;
+        renderData->frustum.build(proj * view);
 
         //STEP 1: RENDER SCENE
         renderData->scene = scene;
@@ -565,19 +771,61 @@ void ForwardRenderer::renderNode(RenderData* renderData, ScenePtr scene)
         }
     }
 
-    auto lightCount = renderData->scene->lights.size();
-
-    scene->geometryRenderList->sort();
+    auto& handles = sceneUniformHandles;
+
+    // camera, fog and light data only changes once per frame so it's
+    // sent to shaders with the CameraData and SceneData blocks in one go
+    updateUniformBuffers(renderData, scene);
+
+    auto renderList = scene->geometryRenderList;
+
+    // the whole list is tested in one go before anything is drawn
+    int culled = renderList->cull(renderData->frustum);
+    renderStats.itemsCulled += culled;
+    renderStats.itemsVisible += renderList->getItems().size() - culled;
+
+    // shaders that don't use the scene block are only sent the lights reaching each item
+    renderStats.lightsAssigned += renderList->assignLights(scene->lights);
+
+    renderList->sort(renderData->eyePos);
+    // copies of the same mesh and material end up next to each other
+    // after sorting and get drawn with a single instanced call
+    renderList->batchInstances();
+
+    // the list is sorted by shader and material so neighbouring items
+    // usually share them. these track what the previous item left bound
+    // so redundant binds and uniform uploads can be skipped
+    MaterialPtr lastMaterial;
+    ShaderPtr lastShader;
+    bool lastInstanced = false;
+    bool lastFogEnabled = false;
+    bool lastReceiveLighting = false;
+    bool usesSceneBlock = false;
+    // lights in the per-light uniforms of the bound shader
+    int lastLights[RENDER_ITEM_MAX_LIGHTS];
+    int lastLightCount = 0;
+
+    auto items = renderList->getItems();
+    for (int itemIndex = 0; itemIndex < items.size(); itemIndex++) {
+        auto item = items[itemIndex];
+        int batchSize = renderList->getInstanceCount(itemIndex);
+
+        // drawn as part of an earlier batch
+        if (batchSize == 0)
+            continue;
 
-    for (auto& item : scene->geometryRenderList->getItems()) {
         if (item->type == iris::RenderItemType::Mesh && !!item->mesh) {
-            if (item->cullable) {
-                auto sphere = item->boundingSphere;
-                if (!renderData->frustum.isSphereInside(&sphere)) continue;
+            bool instanced = batchSize > 1;
+            if (instanced) {
+                if (gatherInstances(items, itemIndex, batchSize) == 0) continue;
+            } else if (item->culled) {
+                continue;
             }
 
             QOpenGLShaderProgram* program = nullptr;
             iris::MaterialPtr mat;
+            bool materialChanged = true;
+            bool shaderChanged = true;
 
             // if a material is set then use it and get its shaderprogram
 
@@ -585,41 +833,110 @@ void ForwardRenderer::renderNode(RenderData* renderData, ScenePtr scene)
                 mat = item->material;
                 //program = mat->getProgram();
 
-                mat->begin(graphics, scene);
-				graphics->setShader(mat->shader);
+                if (mat != lastMaterial || instanced != lastInstanced) {
+                    if (!!lastMaterial)
+                        lastMaterial->end(graphics, scene);
+
+                    // begin() also sets the material's shader
+                    mat->setInstanced(instanced);
+                    mat->begin(graphics, scene);
+                    mat->setInstanced(false);
+                    lastMaterial = mat;
+                    lastInstanced = instanced;
+                    renderStats.materialChanges++;
+                } else {
+                    materialChanged = false;
+                    renderStats.stateChangesAvoided++;
+                }
+
+                auto shader = instanced ? mat->shader->getInstancedShader() : mat->shader;
+                shaderChanged = shader != lastShader;
+                lastShader = shader;
             } else {
+                if (!!lastMaterial) {
+                    lastMaterial->end(graphics, scene);
+                    lastMaterial.clear();
+                }
+                lastShader.clear();
+
                 program = item->shaderProgram;
                 program->bind();
             }
 
-            // send transform and light data
-			graphics->setShaderUniform("u_worldMatrix",   item->worldMatrix);
-			graphics->setShaderUniform("u_viewMatrix",    renderData->viewMatrix);
-			graphics->setShaderUniform("u_projMatrix",    renderData->projMatrix);
+            if (shaderChanged) {
+                renderStats.shaderChanges++;
+                usesSceneBlock = !!lastShader && lastShader->hasUniformBlock("SceneData");
+            }
 
-			graphics->setShaderUniform("u_time", scene->getRunningTime());
+            // send transform data
+            // instances get theirs from the instance block
+            if (!instanced) {
+                graphics->setShaderUniform(handles.worldMatrix, item->worldMatrix);
 
-            if  (item->mesh->hasSkeleton()) {
-                auto& boneTransforms = item->mesh->getSkeleton()->boneTransforms;
-                graphics->setShaderUniformArray("u_bones", boneTransforms.data(), boneTransforms.size());
-				
-			}
+                if  (item->mesh->hasSkeleton()) {
+                    auto& boneTransforms = item->mesh->getSkeleton()->boneTransforms;
+                    graphics->setShaderUniformArray(handles.bones, boneTransforms.data(), boneTransforms.size());
+                }
 
-			graphics->setShaderUniform("u_normalMatrix",  item->worldMatrix.normalMatrix());
+                graphics->setShaderUniform(handles.normalMatrix, item->worldMatrix.normalMatrix());
+            }
 
-			graphics->setShaderUniform("u_eyePos",        renderData->eyePos);
-			graphics->setShaderUniform("u_sceneAmbient",  QVector3D(scene->ambientColor.redF(),
-                                                                  scene->ambientColor.greenF(),
-                                                                  scene->ambientColor.blueF()));
+            // uniforms are part of the program's state so the frame data only
+            // has to be sent again when the shader or the item's flags change
+            bool uploadFrameData = shaderChanged ||
+                                   lastFogEnabled != item->renderStates.fogEnabled ||
+                                   lastReceiveLighting != item->renderStates.receiveLighting;
+            lastFogEnabled = item->renderStates.fogEnabled;
+            lastReceiveLighting = item->renderStates.receiveLighting;
+
+            if (usesSceneBlock) {
+                // everything else is in the uniform blocks
+                if (uploadFrameData) {
+                    graphics->setShaderUniform(handles.receiveFog, item->renderStates.fogEnabled);
+
+                    if (shaderChanged) {
+                        GLint shadowUnits[SCENE_DATA_MAX_LIGHTS];
+                        for (int i = 0; i < SCENE_DATA_MAX_LIGHTS; i++)
+                            shadowUnits[i] = 8 + i;
+                        graphics->setShaderUniformArray(handles.shadowMaps, shadowUnits, SCENE_DATA_MAX_LIGHTS);
+                        graphics->setShaderUniform(handles.clusterLights, LIGHT_DATA_TEXTURE_UNIT);
+                        graphics->setShaderUniform(handles.clusterData, CLUSTER_DATA_TEXTURE_UNIT);
+                    }
+                } else {
+                    renderStats.stateChangesAvoided++;
+                }
 
-            if (item->renderStates.fogEnabled && scene->fogEnabled ) {
-				graphics->setShaderUniform("u_fogData.color", renderData->fogColor);
-				graphics->setShaderUniform("u_fogData.start", renderData->fogStart);
-				graphics->setShaderUniform("u_fogData.end",   renderData->fogEnd);
+                // texture units are cleared when the shader or material changes
+                if (item->renderStates.receiveLighting && (shaderChanged || materialChanged)) {
+                    if (scene->shadowEnabled) {
+                        for (int i = 0; i < blockLights.size(); i++)
+                            graphics->setTexture(8 + i, blockLights[i]->shadowMap->shadowTexture);
+                    }
 
-				graphics->setShaderUniform("u_fogData.enabled", true);
+                    lightClusters->bind(graphics, LIGHT_DATA_TEXTURE_UNIT, CLUSTER_DATA_TEXTURE_UNIT);
+                }
+            } else if (uploadFrameData) {
+                graphics->setShaderUniform(handles.viewMatrix,    renderData->viewMatrix);
+                graphics->setShaderUniform(handles.projMatrix,    renderData->projMatrix);
+
+                graphics->setShaderUniform(handles.time, scene->getRunningTime());
+
+                graphics->setShaderUniform(handles.eyePos,        renderData->eyePos);
+                graphics->setShaderUniform(handles.sceneAmbient,  QVector3D(scene->ambientColor.redF(),
+                                                                          scene->ambientColor.greenF(),
+                                                                          scene->ambientColor.blueF()));
+
+                if (item->renderStates.fogEnabled && scene->fogEnabled ) {
+                    graphics->setShaderUniform(handles.fogColor, renderData->fogColor);
+                    graphics->setShaderUniform(handles.fogStart, renderData->fogStart);
+                    graphics->setShaderUniform(handles.fogEnd,   renderData->fogEnd);
+
+                    graphics->setShaderUniform(handles.fogEnabled, true);
+                } else {
+                    graphics->setShaderUniform(handles.fogEnabled, false);
+                }
             } else {
-				graphics->setShaderUniform("u_fogData.enabled", false);
+                renderStats.stateChangesAvoided++;
             }
             /*
             if (item->renderStates.receiveShadows && scene->shadowEnabled) {
@@ -635,66 +952,67 @@ void ForwardRenderer::renderNode(RenderData* renderData, ScenePtr scene)
 
             program->setUniformValue("u_lightSpaceMatrix",  lightSpaceMatrix);
             */
-			graphics->setShaderUniform("u_lightCount",        lightCount);
-            int shadowIndex = 8;
             // only materials get lights passed to it
-            if ( item->renderStates.receiveLighting ) {
-                for (int i=0;i<lightCount;i++)
-                {
-					auto& lightNames = this->lightUniformNames[i];
-                    //QString lightPrefix = QString("u_lights[%0].").arg(i);
+            // each item gets the lights assigned to it, slots still holding the light
+            // they held for the previous item aren't sent again
+            if (!usesSceneBlock && item->renderStates.receiveLighting) {
+                int itemLights[RENDER_ITEM_MAX_LIGHTS];
+                int itemLightCount;
+                if (instanced) {
+                    itemLightCount = gatherBatchLights(items, itemIndex, batchSize, itemLights);
+                } else {
+                    itemLightCount = item->lightCount;
+                    memcpy(itemLights, item->lights, itemLightCount * sizeof(int));
+                }
+
+                if (uploadFrameData || itemLightCount != lastLightCount)
+                    graphics->setShaderUniform(handles.lightCount, itemLightCount);
 
-                    auto light = renderData->scene->lights[i];
-                    if(!light->isVisible())
-                    {
-                        //quick hack for now
-						graphics->setShaderUniform(lightNames.color.c_str(), QColor(0,0,0));
+                for (int i=0;i<itemLightCount;i++)
+                {
+                    if (!uploadFrameData && i < lastLightCount && lastLights[i] == itemLights[i]) {
+                        renderStats.stateChangesAvoided++;
                         continue;
                     }
 
-					graphics->setShaderUniform(lightNames.type.c_str(), (int)light->lightType);
-					graphics->setShaderUniform(lightNames.position.c_str(), light->globalTransform.column(3).toVector3D());
-                    //mat->setUniformValue(lightPrefix+"direction", light->getDirection());
-					graphics->setShaderUniform(lightNames.distance.c_str(), light->distance);
-					graphics->setShaderUniform(lightNames.direction.c_str(), light->getLightDir());
-					graphics->setShaderUniform(lightNames.cutOffAngle.c_str(), light->spotCutOff);
-					graphics->setShaderUniform(lightNames.cutOffSoftness.c_str(), light->spotCutOffSoftness);
-					graphics->setShaderUniform(lightNames.intensity.c_str(), light->intensity);
-					graphics->setShaderUniform(lightNames.color.c_str(), light->color);
+					auto& lightHandles = this->lightUniformHandles[i];
+                    //QString lightPrefix = QString("u_lights[%0].").arg(i);
+
+                    auto light = renderData->scene->lights[itemLights[i]];
 
-					graphics->setShaderUniform(lightNames.shadowColor.c_str(), light->shadowColor);
-					graphics->setShaderUniform(lightNames.shadowAlpha.c_str(), light->shadowAlpha);
+					graphics->setShaderUniform(lightHandles.type, (int)light->lightType);
+					graphics->setShaderUniform(lightHandles.position, light->globalTransform.column(3).toVector3D());
+					//mat->setUniformValue(lightPrefix+"direction", light->getDirection());
+					graphics->setShaderUniform(lightHandles.distance, light->distance);
+					graphics->setShaderUniform(lightHandles.direction, light->getLightDir());
+					graphics->setShaderUniform(lightHandles.cutOffAngle, light->spotCutOff);
+					graphics->setShaderUniform(lightHandles.cutOffSoftness, light->spotCutOffSoftness);
+					graphics->setShaderUniform(lightHandles.intensity, light->intensity);
+					graphics->setShaderUniform(lightHandles.color, light->color);
 
-					graphics->setShaderUniform(lightNames.constantAtten.c_str(), 1.0f);
-					graphics->setShaderUniform(lightNames.linearAtten.c_str(), 0.0f);
-					graphics->setShaderUniform(lightNames.quadAtten.c_str(), 1.0f);
+					graphics->setShaderUniform(lightHandles.shadowColor, light->shadowColor);
+					graphics->setShaderUniform(lightHandles.shadowAlpha, light->shadowAlpha);
+
+					graphics->setShaderUniform(lightHandles.constantAtten, 1.0f);
+					graphics->setShaderUniform(lightHandles.linearAtten, 0.0f);
+					graphics->setShaderUniform(lightHandles.quadAtten, 1.0f);
 
                     // shadow data
 //                    mat->setUniformValue(lightPrefix+"shadowEnabled",
 //                                         item->renderStates.receiveShadows &&
 //                                         scene->shadowEnabled &&
 //                                         light->lightType != iris::LightType::Point);
-					if (!scene->shadowEnabled) {
-						graphics->setShaderUniform(lightNames.shadowType.c_str(), (int)iris::ShadowMapType::None);
-					}
-					else {
-						graphics->setShaderUniform(lightNames.shadowMap.c_str(), shadowIndex);
-						//mat->setUniformValue(QString("shadowMaps[%0].").arg(i), 8);
-						graphics->setShaderUniform(lightNames.shadowMatrix.c_str(), light->shadowMap->shadowMatrix);
-						if (light->lightType == iris::LightType::Point)
-							graphics->setShaderUniform(lightNames.shadowType.c_str(), (int)iris::ShadowMapType::None);
-						else
-							graphics->setShaderUniform(lightNames.shadowType.c_str(), (int)light->shadowMap->shadowType);
-
-
-						graphics->setTexture(shadowIndex, light->shadowMap->shadowTexture);
-						shadowIndex++;
-					}
+					// shadow maps are texture arrays which only shaders using the
+					// scene block can sample, these shaders are left unshadowed
+					graphics->setShaderUniform(lightHandles.shadowType, (int)iris::ShadowMapType::None);
                     //shadowDepthMap
                     //gl->glActiveTexture(GL_TEXTURE8);
                     //gl->glBindTexture(GL_TEXTURE_2D, light->shadowMap->shadowTexId);
                     //gl->glBindTexture(GL_TEXTURE_2D, shadowDepthMap);
                 }
+
+                memcpy(lastLights, itemLights, itemLightCount * sizeof(int));
+                lastLightCount = itemLightCount;
             }
 
             // set render states
@@ -702,19 +1020,30 @@ void ForwardRenderer::renderNode(RenderData* renderData, ScenePtr scene)
             graphics->setDepthState(item->renderStates.depthState);
             graphics->setBlendState(item->renderStates.blendState);
 
-            //item->mesh->draw(gl, program);
-			item->mesh->draw(graphics);
-
-            if (!!mat) {
-                mat->end(graphics, scene);
+            if (instanced) {
+                drawInstances(item->mesh);
+            } else {
+                //item->mesh->draw(gl, program);
+                item->mesh->draw(graphics);
+                renderStats.drawCalls++;
             }
         }
         else if(item->type == iris::RenderItemType::ParticleSystem) {
+            // the particle renderer binds its own shader and textures
+            if (!!lastMaterial) {
+                lastMaterial->end(graphics, scene);
+                lastMaterial.clear();
+            }
+            lastShader.clear();
+
             auto ps = item->sceneNode.staticCast<ParticleSystemNode>();
             ps->renderParticles(graphics, renderData, particleShader);
         }
     }
 
+    if (!!lastMaterial) {
+        lastMaterial->end(graphics, scene);
+    }
 }
 
 void ForwardRenderer::renderSky(RenderData* renderData)
@@ -899,6 +1228,14 @@ void ForwardRenderer::createShadowShader()
     shadowShader = GraphicsHelper::loadShader(":assets/shaders/shadow_map.vert",
                                               ":assets/shaders/shadow_map.frag");
 
+    instancedShadowShader = GraphicsHelper::loadShader(":assets/shaders/shadow_map.vert",
+                                                       ":assets/shaders/shadow_map.frag",
+                                                       QStringList() << "INSTANCED");
+    auto programId = instancedShadowShader->programId();
+    gl->glUniformBlockBinding(programId,
+                              gl->glGetUniformBlockIndex(programId, "InstanceData"),
+                              INSTANCE_DATA_BINDING);
+
     shadowShader->bind();
 }
 
@@ -928,34 +1265,204 @@ void ForwardRenderer::createEmitterShader()
                                                ":/assets/shaders/emitter.frag");
 }
 
-void ForwardRenderer::generateLightUnformNames()
+void ForwardRenderer::generateUniformHandles()
 {
 	for (int i = 0; i < 16; i++) {
-		LightUniformNames names;
+		LightUniformHandles handles;
 		QString lightPrefix = QString("u_lights[%0].").arg(i);
-		names.color = (lightPrefix + "color").toStdString();
-		names.type = (lightPrefix + "type").toStdString();
-		names.position = (lightPrefix + "position").toStdString();
-		names.distance = (lightPrefix + "distance").toStdString();
-		names.direction = (lightPrefix + "direction").toStdString();
-		names.cutOffAngle = (lightPrefix + "cutOffAngle").toStdString();
-		names.cutOffSoftness = (lightPrefix + "cutOffSoftness").toStdString();
-		names.intensity = (lightPrefix + "intensity").toStdString();
-		names.shadowColor = (lightPrefix + "shadowColor").toStdString();
-		names.shadowAlpha = (lightPrefix + "shadowAlpha").toStdString();
-		names.constantAtten = (lightPrefix + "constantAtten").toStdString();
-		names.linearAtten = (lightPrefix + "linearAtten").toStdString();
-		names.quadAtten = (lightPrefix + "quadtraticAtten").toStdString();
-		names.shadowType = (lightPrefix + "shadowType").toStdString();
-		names.shadowMap = (lightPrefix + "shadowMap").toStdString();
-		names.shadowMatrix = (lightPrefix + "shadowMatrix").toStdString();
-		lightUniformNames.append(names);
+		handles.color = Shader::getUniformHandle((lightPrefix + "color").toStdString());
+		handles.type = Shader::getUniformHandle((lightPrefix + "type").toStdString());
+		handles.position = Shader::getUniformHandle((lightPrefix + "position").toStdString());
+		handles.distance = Shader::getUniformHandle((lightPrefix + "distance").toStdString());
+		handles.direction = Shader::getUniformHandle((lightPrefix + "direction").toStdString());
+		handles.cutOffAngle = Shader::getUniformHandle((lightPrefix + "cutOffAngle").toStdString());
+		handles.cutOffSoftness = Shader::getUniformHandle((lightPrefix + "cutOffSoftness").toStdString());
+		handles.intensity = Shader::getUniformHandle((lightPrefix + "intensity").toStdString());
+		handles.shadowColor = Shader::getUniformHandle((lightPrefix + "shadowColor").toStdString());
+		handles.shadowAlpha = Shader::getUniformHandle((lightPrefix + "shadowAlpha").toStdString());
+		handles.constantAtten = Shader::getUniformHandle((lightPrefix + "constantAtten").toStdString());
+		handles.linearAtten = Shader::getUniformHandle((lightPrefix + "linearAtten").toStdString());
+		handles.quadAtten = Shader::getUniformHandle((lightPrefix + "quadtraticAtten").toStdString());
+		handles.shadowType = Shader::getUniformHandle((lightPrefix + "shadowType").toStdString());
+		handles.shadowMap = Shader::getUniformHandle((lightPrefix + "shadowMap").toStdString());
+		handles.shadowMatrix = Shader::getUniformHandle((lightPrefix + "shadowMatrix").toStdString());
+		lightUniformHandles.append(handles);
+	}
+
+	auto& handles = sceneUniformHandles;
+	handles.worldMatrix = Shader::getUniformHandle("u_worldMatrix");
+	handles.normalMatrix = Shader::getUniformHandle("u_normalMatrix");
+	handles.bones = Shader::getUniformHandle("u_bones");
+	handles.viewMatrix = Shader::getUniformHandle("u_viewMatrix");
+	handles.projMatrix = Shader::getUniformHandle("u_projMatrix");
+	handles.time = Shader::getUniformHandle("u_time");
+	handles.eyePos = Shader::getUniformHandle("u_eyePos");
+	handles.sceneAmbient = Shader::getUniformHandle("u_sceneAmbient");
+	handles.fogColor = Shader::getUniformHandle("u_fogData.color");
+	handles.fogStart = Shader::getUniformHandle("u_fogData.start");
+	handles.fogEnd = Shader::getUniformHandle("u_fogData.end");
+	handles.fogEnabled = Shader::getUniformHandle("u_fogData.enabled");
+	handles.lightCount = Shader::getUniformHandle("u_lightCount");
+	handles.receiveFog = Shader::getUniformHandle("u_receiveFog");
+	handles.shadowMaps = Shader::getUniformHandle("u_shadowMaps");
+	handles.clusterLights = Shader::getUniformHandle("u_clusterLights");
+	handles.clusterData = Shader::getUniformHandle("u_clusterData");
+}
+
+// std140 layouts of the blocks in camera_data.glsl and scene_data.glsl
+// vec3s are padded to 16 bytes and structs are rounded up to 16 bytes
+struct CameraUniformData
+{
+	float viewMatrix[16];
+	float projMatrix[16];
+};
+
+struct LightUniformData
+{
+	float position[3];
+	float distance;
+	float direction[3];
+	float intensity;
+	float color[4];
+	float shadowColor[4];
+	float shadowMatrices[SHADOW_MAX_CASCADES][16];
+	int type;
+	float cutOffAngle;
+	float cutOffSoftness;
+	float shadowAlpha;
+	int shadowType;
+	int cascadeCount;
+	int padding[2];
+};
+
+struct SceneUniformData
+{
+	float eyePos[3];
+	float time;
+	float sceneAmbient[3];
+	int lightCount;
+	int fogEnabled;
+	float fogStart;
+	float fogEnd;
+	float padding;
+	float fogColor[4];
+	int clusterCount[4];
+	float clusterViewport[4];
+	float clusterDepth[4];
+	LightUniformData lights[SCENE_DATA_MAX_LIGHTS];
+};
+
+static void copyVector(float* dest, const QVector3D& vec)
+{
+	dest[0] = vec.x();
+	dest[1] = vec.y();
+	dest[2] = vec.z();
+}
+
+static void copyColor(float* dest, const QColor& color)
+{
+	dest[0] = color.redF();
+	dest[1] = color.greenF();
+	dest[2] = color.blueF();
+	dest[3] = color.alphaF();
+}
+
+void ForwardRenderer::updateUniformBuffers(RenderData* renderData, ScenePtr scene)
+{
+	CameraUniformData cameraData;
+	memcpy(cameraData.viewMatrix, renderData->viewMatrix.constData(), sizeof(cameraData.viewMatrix));
+	memcpy(cameraData.projMatrix, renderData->projMatrix.constData(), sizeof(cameraData.projMatrix));
+	cameraDataBuffer->setData(&cameraData, sizeof(CameraUniformData));
+
+	SceneUniformData sceneData;
+	memset(&sceneData, 0, sizeof(SceneUniformData));
+	copyVector(sceneData.eyePos, renderData->eyePos);
+	sceneData.time = scene->getRunningTime();
+	copyVector(sceneData.sceneAmbient, QVector3D(scene->ambientColor.redF(),
+												 scene->ambientColor.greenF(),
+												 scene->ambientColor.blueF()));
+
+	sceneData.fogEnabled = scene->fogEnabled ? 1 : 0;
+	sceneData.fogStart = renderData->fogStart;
+	sceneData.fogEnd = renderData->fogEnd;
+	copyColor(sceneData.fogColor, renderData->fogColor);
+
+	// directional lights reach everything and shadowed lights need their shadow map
+	// bound so both stay in the block, other lights are only shaded where they reach
+	blockLights.clear();
+	clusteredLights.clear();
+	for (auto light : scene->lights) {
+		if (!light->isVisible())
+			continue;
+
+		bool shadowed = scene->shadowEnabled &&
+						light->lightType == iris::LightType::Spot &&
+						light->getShadowMapType() != iris::ShadowMapType::None;
+
+		if (light->lightType == iris::LightType::Directional || shadowed) {
+			// the block is full, spot lights still get clustered without their shadows
+			if (blockLights.size() < SCENE_DATA_MAX_LIGHTS)
+				blockLights.append(light);
+			else if (shadowed)
+				clusteredLights.append(light);
+		} else {
+			clusteredLights.append(light);
+		}
+	}
+
+	lightClusters->build(clusteredLights, renderData->viewMatrix, renderData->projMatrix);
+	renderStats.lightsClustered += lightClusters->getLightCount();
+	renderStats.clusterLightIndices += lightClusters->getIndexCount();
+
+	auto viewport = graphics->getViewport();
+	sceneData.clusterCount[0] = LIGHT_CLUSTERS_X;
+	sceneData.clusterCount[1] = LIGHT_CLUSTERS_Y;
+	sceneData.clusterCount[2] = LIGHT_CLUSTERS_Z;
+	sceneData.clusterViewport[0] = viewport.x();
+	sceneData.clusterViewport[1] = viewport.y();
+	sceneData.clusterViewport[2] = qMax(viewport.width(), 1);
+	sceneData.clusterViewport[3] = qMax(viewport.height(), 1);
+	sceneData.clusterDepth[0] = lightClusters->getDepthScale();
+	sceneData.clusterDepth[1] = lightClusters->getDepthBias();
+	sceneData.clusterDepth[2] = lightClusters->isLogarithmic() ? 1.0f : 0.0f;
+
+	sceneData.lightCount = blockLights.size();
+	for (int i = 0; i < blockLights.size(); i++) {
+		auto light = blockLights[i];
+		auto& lightData = sceneData.lights[i];
+
+		lightData.type = (int)light->lightType;
+		copyVector(lightData.position, light->globalTransform.column(3).toVector3D());
+		lightData.distance = light->distance;
+		copyVector(lightData.direction, light->getLightDir());
+		lightData.cutOffAngle = light->spotCutOff;
+		lightData.cutOffSoftness = light->spotCutOffSoftness;
+		lightData.intensity = light->intensity;
+		copyColor(lightData.color, light->color);
+		copyColor(lightData.shadowColor, light->shadowColor);
+		lightData.shadowAlpha = light->shadowAlpha;
+
+		if (!scene->shadowEnabled || light->lightType == iris::LightType::Point) {
+			lightData.shadowType = (int)iris::ShadowMapType::None;
+		} else {
+			auto shadowMap = light->shadowMap;
+			lightData.shadowType = (int)shadowMap->shadowType;
+			lightData.cascadeCount = light->lightType == iris::LightType::Directional ? shadowMap->cascadeCount : 1;
+			for (int c = 0; c < lightData.cascadeCount; c++)
+				memcpy(lightData.shadowMatrices[c], shadowMap->cascadeMatrices[c].constData(), sizeof(lightData.shadowMatrices[c]));
+		}
 	}
+
+	sceneDataBuffer->setData(&sceneData, sizeof(SceneUniformData));
+
+	graphics->setUniformBuffer(CAMERA_DATA_BINDING, cameraDataBuffer);
+	graphics->setUniformBuffer(SCENE_DATA_BINDING, sceneDataBuffer);
 }
 
 ForwardRenderer::~ForwardRenderer()
 {
     delete vrDevice;
+    delete lightClusters;
 }
 
 }
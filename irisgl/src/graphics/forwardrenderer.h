@@ -14,6 +14,7 @@ For more information see the LICENSE file
 
 #include <QOpenGLContext>
 #include <QSharedPointer>
+#include <QMatrix4x4>
 //#include "../libovr/Include/OVR_CAPI_GL.h"
 #include "../irisglfwd.h"
 
@@ -22,6 +23,20 @@ For more information see the LICENSE file
 
 #define OUTLINE_STENCIL_CHANNEL 1
 
+// binding points of the per-frame uniform blocks
+#define CAMERA_DATA_BINDING 0
+#define SCENE_DATA_BINDING 1
+#define INSTANCE_DATA_BINDING 2
+// must match MAX_INSTANCES in instancing.glsl
+#define MAX_INSTANCES_PER_DRAW 256
+// must match MAX_LIGHTS in scene_data.glsl
+// only directional and shadowed spot lights go in the block, the rest are clustered
+#define SCENE_DATA_MAX_LIGHTS 6
+// texture units of the clustered light buffers, the shadow maps take the
+// SCENE_DATA_MAX_LIGHTS units from 8 so everything fits in the 16 gl 3.2 guarantees
+#define LIGHT_DATA_TEXTURE_UNIT 14
+#define CLUSTER_DATA_TEXTURE_UNIT 15
+
 class QOpenGLShaderProgram;
 class QOpenGLFunctions_3_2_Core;
 class QOpenGLContext;
@@ -41,25 +56,97 @@ class VrDevice;
 class PostProcessManager;
 class PostProcessContext;
 class PerformanceTimer;
+class ShadowMap;
+class LightClusters;
 
-struct LightUniformNames
+// handles from Shader::getUniformHandle for each light's uniforms
+struct LightUniformHandles
+{
+	int color;
+	int type;
+	int position;
+	int distance;
+	int direction;
+	int cutOffAngle;
+	int cutOffSoftness;
+	int intensity;
+	int shadowColor;
+	int shadowAlpha;
+	int constantAtten;
+	int linearAtten;
+	int quadAtten;
+	int shadowType;
+	int shadowMap;
+	int shadowMatrix;
+};
+
+// handles for the uniforms sent to every material
+struct SceneUniformHandles
+{
+	int worldMatrix;
+	int normalMatrix;
+	int bones;
+	int viewMatrix;
+	int projMatrix;
+	int time;
+	int eyePos;
+	int sceneAmbient;
+	int fogColor;
+	int fogStart;
+	int fogEnd;
+	int fogEnabled;
+	int lightCount;
+	int receiveFog;
+	int shadowMaps;
+	int clusterLights;
+	int clusterData;
+};
+
+/**
+ * Per-frame counters gathered by the renderer
+ * They're reset at the start of every frame
+ */
+struct RenderStats
 {
-	std::string color;
-	std::string type;
-	std::string position;
-	std::string distance;
-	std::string direction;
-	std::string cutOffAngle;
-	std::string cutOffSoftness;
-	std::string intensity;
-	std::string shadowColor;
-	std::string shadowAlpha;
-	std::string constantAtten;
-	std::string linearAtten;
-	std::string quadAtten;
-	std::string shadowType;
-	std::string shadowMap;
-	std::string shadowMatrix;
+	int drawCalls;
+	int materialChanges;
+	int shaderChanges;
+	// material binds, uniform uploads and texture binds skipped because
+	// the previous item already set them
+	int stateChangesAvoided;
+	// shadow casters outside of a light's frustum, counted once per light
+	int shadowCastersCulled;
+	// shadow map layers that were still valid and didn't have to be redrawn
+	int shadowLayersReused;
+	// items in the camera pass inside and outside of the view frustum, per eye in vr
+	int itemsVisible;
+	int itemsCulled;
+	// point and spot lights binned into the cluster grid and the number of
+	// light references across all clusters, per eye in vr
+	int lightsClustered;
+	int clusterLightIndices;
+	// lights given to items by RenderList::assignLights, summed over the items
+	int lightsAssigned;
+
+	RenderStats()
+	{
+		reset();
+	}
+
+	void reset()
+	{
+		drawCalls = 0;
+		materialChanges = 0;
+		shaderChanges = 0;
+		stateChangesAvoided = 0;
+		shadowCastersCulled = 0;
+		shadowLayersReused = 0;
+		itemsVisible = 0;
+		itemsCulled = 0;
+		lightsClustered = 0;
+		clusterLightIndices = 0;
+		lightsAssigned = 0;
+	}
 };
 
 /**
@@ -87,6 +174,7 @@ class ForwardRenderer
     QOpenGLShaderProgram* skinnedLineShader;
     QOpenGLShaderProgram* shadowShader;
     QOpenGLShaderProgram* skinnedShadowShader;
+    QOpenGLShaderProgram* instancedShadowShader;
     ShaderPtr particleShader;
     QOpenGLShaderProgram* emitterShader;
 
@@ -98,10 +186,26 @@ class ForwardRenderer
     RenderTargetPtr renderTarget;
     Texture2DPtr sceneRenderTexture;
     Texture2DPtr depthRenderTexture;
-    Texture2DPtr finalRenderTexture;
 
     PerformanceTimer* perfTimer;
-	QVector<LightUniformNames> lightUniformNames;
+	QVector<LightUniformHandles> lightUniformHandles;
+	SceneUniformHandles sceneUniformHandles;
+
+	// std140 blocks shared by all shaders that declare them
+	UniformBufferPtr cameraDataBuffer;
+	UniformBufferPtr sceneDataBuffer;
+
+	// lights sent through the scene block, the others are only seen through the clusters
+	QVector<LightNodePtr> blockLights;
+	QVector<LightNodePtr> clusteredLights;
+	LightClusters* lightClusters;
+
+	// world matrices of the instances being drawn
+	UniformBufferPtr instanceDataBuffer;
+	QVector<QMatrix4x4> instanceMatrices;
+	QVector<float> instanceBlockData;
+
+	RenderStats renderStats;
 
 public:
 
@@ -131,6 +235,14 @@ public:
 
     PostProcessManagerPtr getPostProcessManager();
 
+    /**
+     * Returns the counters gathered while rendering the last frame
+     */
+    RenderStats getRenderStats()
+    {
+        return renderStats;
+    }
+
     static ForwardRendererPtr create(bool useVr = true, bool physicsEnabled = false);
 
     bool isVrSupported();
@@ -159,9 +271,25 @@ private:
     void renderShadows(ScenePtr node);
     void renderDirectionalShadow(LightNodePtr lightNode,ScenePtr node);
     void renderSpotlightShadow(LightNodePtr lightNode,ScenePtr node);
+    // draws the casters inside the light's frustum into the bound shadow map
+    void renderShadowCasters(const QMatrix4x4& lightSpaceMatrix);
+    // redraws a layer of the shadow map unless its cached contents are still valid
+    void renderShadowLayer(ShadowMap* shadowMap, int layer, const QMatrix4x4& lightSpaceMatrix);
+    bool isShadowLayerCached(ShadowMap* shadowMap, int layer, const QMatrix4x4& lightSpaceMatrix);
+    bool shadowCastersPrepared;
     void generateShadowBuffer(GLuint size = 1024);
 
-	void generateLightUnformNames();
+	void generateUniformHandles();
+	void updateUniformBuffers(RenderData* renderData, ScenePtr scene);
+
+	/**
+	 * Fills instanceMatrices with the world matrices of a batch of items
+	 * Items marked as culled are skipped
+	 * Returns the number of instances gathered
+	 */
+	int gatherInstances(const QVector<RenderItem*>& items, int start, int count);
+	// draws the gathered instances, in chunks if there are too many for one draw
+	void drawInstances(MeshPtr mesh);
 
     //editor-specific
     iris::Billboard* billboard;
@@ -0,0 +1,136 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "gpuparticlesimulator.h"
+#include "../core/logger.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLShaderProgram>
+#include <QVector>
+
+namespace iris
+{
+
+GpuParticleSimulator::GpuParticleSimulator()
+{
+    gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_2_Core>();
+
+    gl->glGenBuffers(2, buffers);
+    gl->glGenVertexArrays(2, vertexArrays);
+
+    const GLsizei stride = GPU_PARTICLE_TEXELS * 4 * sizeof(GLfloat);
+    for (int i = 0; i < 2; i++) {
+        gl->glBindVertexArray(vertexArrays[i]);
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        for (int attrib = 0; attrib < GPU_PARTICLE_TEXELS; attrib++) {
+            gl->glEnableVertexAttribArray(attrib);
+            gl->glVertexAttribPointer(attrib, 4, GL_FLOAT, GL_FALSE, stride,
+                                      (GLvoid*) (attrib * 4 * sizeof(GLfloat)));
+        }
+    }
+    gl->glBindVertexArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    current = 0;
+    capacity = 0;
+    emitCursor = 0;
+
+    createProgram();
+}
+
+GpuParticleSimulator::~GpuParticleSimulator()
+{
+    delete program;
+    gl->glDeleteVertexArrays(2, vertexArrays);
+    gl->glDeleteBuffers(2, buffers);
+}
+
+void GpuParticleSimulator::createProgram()
+{
+    program = new QOpenGLShaderProgram();
+    program->addShaderFromSourceFile(QOpenGLShader::Vertex, ":/assets/shaders/particle_update.vert");
+    program->bindAttributeLocation("a_posScale", 0);
+    program->bindAttributeLocation("a_velRot", 1);
+    program->bindAttributeLocation("a_ageLife", 2);
+
+    // the outputs are written one after the other, matching the attribute layout
+    const char* varyings[] = { "o_posScale", "o_velRot", "o_ageLife" };
+    gl->glTransformFeedbackVaryings(program->programId(), 3, varyings, GL_INTERLEAVED_ATTRIBS);
+
+    if (!program->link())
+        irisLog("particle simulation shader failed to link: " + program->log());
+}
+
+void GpuParticleSimulator::setCapacity(int capacity)
+{
+    if (this->capacity == capacity)
+        return;
+
+    this->capacity = capacity;
+    emitCursor = 0;
+
+    // zeroed slots have no life left so they start out dead
+    QVector<float> zeros(capacity * GPU_PARTICLE_TEXELS * 4, 0.0f);
+    for (int i = 0; i < 2; i++) {
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+        gl->glBufferData(GL_ARRAY_BUFFER, zeros.size() * sizeof(float), zeros.constData(), GL_DYNAMIC_COPY);
+    }
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void GpuParticleSimulator::simulate(const GpuParticleEmission& emission)
+{
+    if (capacity == 0 || !program->isLinked())
+        return;
+
+    const int emitCount = qMin(emission.count, capacity);
+
+    program->bind();
+    program->setUniformValue("u_delta", emission.delta);
+    program->setUniformValue("u_capacity", capacity);
+    program->setUniformValue("u_emitStart", emitCursor);
+    program->setUniformValue("u_emitCount", emitCount);
+    program->setUniformValue("u_seed", (GLuint) qrand());
+    program->setUniformValue("u_emitterPos", emission.emitterPos);
+    program->setUniformValue("u_boundDimension", emission.boundDimension);
+    program->setUniformValue("u_direction", emission.direction);
+    program->setUniformValue("u_speed", emission.speed);
+    program->setUniformValue("u_speedError", emission.speedError);
+    program->setUniformValue("u_particleScale", emission.particleScale);
+    program->setUniformValue("u_scaleError", emission.scaleError);
+    program->setUniformValue("u_lifeLength", emission.lifeLength);
+    program->setUniformValue("u_lifeError", emission.lifeError);
+    program->setUniformValue("u_gravity", emission.gravity);
+    program->setUniformValue("u_randomRotation", emission.randomRotation);
+    program->setUniformValue("u_dissipate", emission.dissipate);
+    program->setUniformValue("u_dissipateInv", emission.dissipateInv);
+
+    const int next = 1 - current;
+
+    gl->glEnable(GL_RASTERIZER_DISCARD);
+    gl->glBindVertexArray(vertexArrays[current]);
+    gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[next]);
+
+    gl->glBeginTransformFeedback(GL_POINTS);
+    gl->glDrawArrays(GL_POINTS, 0, capacity);
+    gl->glEndTransformFeedback();
+
+    gl->glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+    gl->glBindVertexArray(0);
+    gl->glDisable(GL_RASTERIZER_DISCARD);
+
+    program->release();
+
+    current = next;
+    emitCursor = (emitCursor + emitCount) % capacity;
+}
+
+}
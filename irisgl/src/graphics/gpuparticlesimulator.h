@@ -0,0 +1,101 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef GPUPARTICLESIMULATOR_H
+#define GPUPARTICLESIMULATOR_H
+
+#include <QVector3D>
+#include <QOpenGLFunctions_3_2_Core>
+
+class QOpenGLShaderProgram;
+
+namespace iris
+{
+
+// texels per particle in the simulation buffers: position and scale,
+// velocity and rotation, then age, life and gravity
+#define GPU_PARTICLE_TEXELS 3
+
+/**
+ * The emitter's settings for one simulation step
+ */
+struct GpuParticleEmission
+{
+    float delta;
+    // particles to spawn this step
+    int count;
+
+    QVector3D emitterPos;
+    QVector3D boundDimension;
+    QVector3D direction;
+
+    float speed, speedError;
+    float particleScale, scaleError;
+    float lifeLength, lifeError;
+    float gravity;
+
+    bool randomRotation;
+    bool dissipate, dissipateInv;
+};
+
+/**
+ * Keeps an emitter's particles on the gpu and simulates them with transform feedback
+ * The particles live in a fixed number of slots, two buffers are swapped each step so one
+ * is read while the other is written. New particles take the slots after the last ones
+ * spawned, so when the emitter outruns the capacity the oldest particles are replaced
+ */
+class GpuParticleSimulator
+{
+    QOpenGLFunctions_3_2_Core* gl;
+    QOpenGLShaderProgram* program;
+
+    GLuint buffers[2];
+    GLuint vertexArrays[2];
+    // the buffer holding the latest state
+    int current;
+
+    int capacity;
+    int emitCursor;
+
+public:
+    GpuParticleSimulator();
+    ~GpuParticleSimulator();
+
+    /**
+     * Resizes the particle slots, this kills all living particles
+     */
+    void setCapacity(int capacity);
+
+    int getCapacity()
+    {
+        return capacity;
+    }
+
+    /**
+     * Spawns the emission's new particles and advances every particle by its delta
+     */
+    void simulate(const GpuParticleEmission& emission);
+
+    /**
+     * The buffer the last simulate wrote to, ParticleRenderer reads it as a texture buffer
+     */
+    GLuint getParticleBuffer()
+    {
+        return buffers[current];
+    }
+
+private:
+    void createProgram();
+};
+
+}
+
+#endif // GPUPARTICLESIMULATOR_H
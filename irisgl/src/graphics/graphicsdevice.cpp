@@ -5,10 +5,15 @@
 #include "texture2d.h"
 #include "vertexlayout.h"
 #include "shader.h"
+#include "programcache.h"
 
 #include <QOpenGLShaderProgram>
 #include <QOpenGLFunctions_3_2_Core>
 #include <QOpenGLFunctions>
+#include <QOpenGLContext>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
 
 namespace iris
 {
@@ -87,6 +92,8 @@ void IndexBuffer::upload(QOpenGLFunctions_3_2_Core* gl)
     gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bufferId);
     gl->glBufferData(GL_ELEMENT_ARRAY_BUFFER, dataSize, data, GL_STATIC_DRAW);
     gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    _isDirty = false;
 }
 
 void IndexBuffer::destroy()
@@ -96,6 +103,215 @@ void IndexBuffer::destroy()
     // todo: delete gl buffer
 }
 
+static QMutex vaoMutex;
+static QHash<QOpenGLContext*, quint64> contextSerials;
+static quint64 nextContextSerial = 1;
+// vaos waiting for their context, the count lets binds skip the lock when there are none
+static QHash<quint64, QVector<GLuint>> orphanedVaos;
+static QAtomicInt orphanedVaoCount;
+
+VertexArray::VertexArray()
+{
+    version = 0;
+}
+
+VertexArray::~VertexArray()
+{
+    if (vaos.isEmpty())
+        return;
+
+    auto current = QOpenGLContext::currentContext();
+    quint64 currentSerial = current ? getContextSerial(current) : 0;
+
+    QMutexLocker locker(&vaoMutex);
+    for (auto it = vaos.constBegin(); it != vaos.constEnd(); ++it) {
+        if (it.key() == currentSerial) {
+            current->versionFunctions<QOpenGLFunctions_3_2_Core>()->glDeleteVertexArrays(1, &it.value().vaoId);
+        } else if (contextSerials.key(it.key(), nullptr) != nullptr) {
+            orphanedVaos[it.key()].append(it.value().vaoId);
+            orphanedVaoCount.ref();
+        }
+        // otherwise the context is gone and took the vao with it
+    }
+}
+
+quint64 VertexArray::getContextSerial(QOpenGLContext* context)
+{
+    QMutexLocker locker(&vaoMutex);
+    auto it = contextSerials.constFind(context);
+    if (it != contextSerials.constEnd())
+        return it.value();
+
+    quint64 serial = nextContextSerial++;
+    contextSerials.insert(context, serial);
+
+    QObject::connect(context, &QOpenGLContext::aboutToBeDestroyed, [context, serial]() {
+        QMutexLocker locker(&vaoMutex);
+        contextSerials.remove(context);
+        orphanedVaoCount.fetchAndAddOrdered(-orphanedVaos.value(serial).size());
+        orphanedVaos.remove(serial);
+    });
+
+    return serial;
+}
+
+void VertexArray::deleteOrphanedVaos(quint64 contextSerial, QOpenGLFunctions_3_2_Core* gl)
+{
+    if (orphanedVaoCount.load() == 0)
+        return;
+
+    QMutexLocker locker(&vaoMutex);
+    auto vaoIds = orphanedVaos.take(contextSerial);
+    if (vaoIds.isEmpty())
+        return;
+
+    orphanedVaoCount.fetchAndAddOrdered(-vaoIds.size());
+    gl->glDeleteVertexArrays(vaoIds.size(), vaoIds.constData());
+}
+
+void VertexArray::setVertexBuffers(const QList<VertexBufferPtr>& vertexBuffers)
+{
+    this->vertexBuffers = vertexBuffers;
+    version++;
+}
+
+void VertexArray::setIndexBuffer(IndexBufferPtr indexBuffer)
+{
+    this->indexBuffer = indexBuffer;
+    version++;
+}
+
+// the buffers must already be uploaded
+void VertexArray::build(QOpenGLFunctions_3_2_Core* gl, GLuint vaoId)
+{
+    gl->glBindVertexArray(vaoId);
+
+    // disable attributes left over from a previous build
+    for (int i = 0; i < (int)VertexAttribUsage::Count; i++)
+        gl->glDisableVertexAttribArray(i);
+
+    for (auto& buffer : vertexBuffers) {
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffer->bufferId);
+        buffer->vertexLayout.bind(gl);
+    }
+
+    // the element buffer binding is part of the vao's state
+    if (!!indexBuffer)
+        gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer->bufferId);
+    else
+        gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+
+    gl->glBindVertexArray(0);
+    gl->glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+UniformBuffer::UniformBuffer()
+{
+    bufferId = -1;
+    data = nullptr;
+    dataSize = 0;
+    _isDirty = true;
+}
+
+void UniformBuffer::setData(void *bufferData, unsigned int sizeInBytes)
+{
+    // block data is usually the same size every frame
+    if (dataSize != sizeInBytes) {
+        if (data)
+            delete[] (char*)data;
+
+        data = new char[sizeInBytes];
+        dataSize = sizeInBytes;
+    }
+
+    memcpy(this->data, bufferData, sizeInBytes);
+    _isDirty = true;
+}
+
+void UniformBuffer::upload(QOpenGLFunctions_3_2_Core* gl)
+{
+    if (bufferId == -1)
+        gl->glGenBuffers(1, &bufferId);
+
+    // respecifying the whole buffer lets the driver hand out new storage
+    // instead of waiting for draws that still use the old data
+    gl->glBindBuffer(GL_UNIFORM_BUFFER, bufferId);
+    gl->glBufferData(GL_UNIFORM_BUFFER, dataSize, data, GL_DYNAMIC_DRAW);
+    gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    _isDirty = false;
+}
+
+void UniformBuffer::destroy()
+{
+    if (data)
+        delete[] (char*)data;
+    // todo: delete gl buffer
+}
+
+TextureBuffer::TextureBuffer(GLenum format)
+{
+    this->format = format;
+    bufferId = 0;
+    textureId = 0;
+    data = nullptr;
+    dataSize = 0;
+    capacity = 0;
+    _isDirty = true;
+}
+
+TextureBuffer::~TextureBuffer()
+{
+    if (data)
+        delete[] (char*)data;
+
+    auto context = QOpenGLContext::currentContext();
+    if (context == nullptr)
+        return;
+
+    auto gl = context->versionFunctions<QOpenGLFunctions_3_2_Core>();
+    if (textureId != 0)
+        gl->glDeleteTextures(1, &textureId);
+    if (bufferId != 0)
+        gl->glDeleteBuffers(1, &bufferId);
+}
+
+void TextureBuffer::setData(void *bufferData, unsigned int sizeInBytes)
+{
+    // only grows so the allocation is reused from frame to frame
+    if (capacity < sizeInBytes) {
+        if (data)
+            delete[] (char*)data;
+
+        data = new char[sizeInBytes];
+        capacity = sizeInBytes;
+    }
+
+    dataSize = sizeInBytes;
+    memcpy(this->data, bufferData, sizeInBytes);
+    _isDirty = true;
+}
+
+void TextureBuffer::upload(QOpenGLFunctions_3_2_Core* gl)
+{
+    if (bufferId == 0)
+        gl->glGenBuffers(1, &bufferId);
+
+    gl->glBindBuffer(GL_TEXTURE_BUFFER, bufferId);
+    gl->glBufferData(GL_TEXTURE_BUFFER, dataSize, data, GL_DYNAMIC_DRAW);
+    gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // the texture refers to the buffer object rather than its storage
+    // so it only has to be attached once
+    if (textureId == 0) {
+        gl->glGenTextures(1, &textureId);
+        gl->glBindTexture(GL_TEXTURE_BUFFER, textureId);
+        gl->glTexBuffer(GL_TEXTURE_BUFFER, format, bufferId);
+    }
+
+    _isDirty = false;
+}
+
 QOpenGLFunctions_3_2_Core *GraphicsDevice::getGL() const
 {
     return gl;
@@ -109,6 +325,7 @@ GraphicsDevicePtr GraphicsDevice::create()
 GraphicsDevice::GraphicsDevice()
 {
     context = QOpenGLContext::currentContext();
+    contextSerial = VertexArray::getContextSerial(context);
     gl = context->versionFunctions<QOpenGLFunctions_3_2_Core>();
 
     // 8 texture units by default
@@ -151,7 +368,7 @@ void GraphicsDevice::setRenderTarget(Texture2DPtr colorTarget)
 }
 
 // the size of all the textures should be the same
-void GraphicsDevice::setRenderTarget(QList<Texture2DPtr> colorTargets, Texture2DPtr depthTarget)
+void GraphicsDevice::setRenderTarget(QList<Texture2DPtr> colorTargets, Texture2DPtr depthTarget, int depthLayer)
 {
     clearRenderTarget();
 
@@ -171,7 +388,7 @@ void GraphicsDevice::setRenderTarget(QList<Texture2DPtr> colorTargets, Texture2D
     }
 
     if(!!depthTarget)
-        _internalRT->setDepthTexture(depthTarget);
+        _internalRT->setDepthTexture(depthTarget, depthLayer);
 
     activeRT = _internalRT;
     activeRT->bind();
@@ -256,33 +473,36 @@ void GraphicsDevice::setShader(ShaderPtr shader, bool force)
 
 void GraphicsDevice::compileShader(iris::ShaderPtr shader)
 {
-	QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex);
-	vshader->compileSourceCode(shader->vertexShader);
-
-	QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment);
-	fshader->compileSourceCode(shader->fragmentShader);
-
 	if (!shader->program)
 		shader->program = new QOpenGLShaderProgram;
 
 	auto& program = shader->program;
 	program->removeAllShaders();
 
-	program->addShader(vshader);
-	program->addShader(fshader);
-
-	program->bindAttributeLocation("a_pos", (int)VertexAttribUsage::Position);
-	program->bindAttributeLocation("a_color", (int)VertexAttribUsage::Color);
-	program->bindAttributeLocation("a_texCoord", (int)VertexAttribUsage::TexCoord0);
-	program->bindAttributeLocation("a_texCoord1", (int)VertexAttribUsage::TexCoord1);
-	program->bindAttributeLocation("a_texCoord2", (int)VertexAttribUsage::TexCoord2);
-	program->bindAttributeLocation("a_texCoord3", (int)VertexAttribUsage::TexCoord3);
-	program->bindAttributeLocation("a_normal", (int)VertexAttribUsage::Normal);
-	program->bindAttributeLocation("a_tangent", (int)VertexAttribUsage::Tangent);
-	program->bindAttributeLocation("a_boneIndices", (int)VertexAttribUsage::BoneIndices);
-	program->bindAttributeLocation("a_boneWeights", (int)VertexAttribUsage::BoneWeights);
-
-	program->link();
+	auto cacheKey = ProgramCache::createKey(shader->vertexShader, shader->fragmentShader);
+	if (!ProgramCache::load(program, cacheKey)) {
+		QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex);
+		vshader->compileSourceCode(shader->vertexShader);
+
+		QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment);
+		fshader->compileSourceCode(shader->fragmentShader);
+
+		program->addShader(vshader);
+		program->addShader(fshader);
+
+		program->bindAttributeLocation("a_pos", (int)VertexAttribUsage::Position);
+		program->bindAttributeLocation("a_color", (int)VertexAttribUsage::Color);
+		program->bindAttributeLocation("a_texCoord", (int)VertexAttribUsage::TexCoord0);
+		program->bindAttributeLocation("a_texCoord1", (int)VertexAttribUsage::TexCoord1);
+		program->bindAttributeLocation("a_texCoord2", (int)VertexAttribUsage::TexCoord2);
+		program->bindAttributeLocation("a_texCoord3", (int)VertexAttribUsage::TexCoord3);
+		program->bindAttributeLocation("a_normal", (int)VertexAttribUsage::Normal);
+		program->bindAttributeLocation("a_tangent", (int)VertexAttribUsage::Tangent);
+		program->bindAttributeLocation("a_boneIndices", (int)VertexAttribUsage::BoneIndices);
+		program->bindAttributeLocation("a_boneWeights", (int)VertexAttribUsage::BoneWeights);
+
+		ProgramCache::link(program, cacheKey);
+	}
 
 	//todo: check for errors
 
@@ -338,14 +558,87 @@ void GraphicsDevice::compileShader(iris::ShaderPtr shader)
 
 	}
 
+	// resolve the locations of all the known handles up front so
+	// setting uniforms by handle never needs a string lookup
+	auto handleNames = Shader::getUniformHandleNames();
+	shader->uniformLocations.resize(handleNames.size());
+	for (size_t i = 0; i < handleNames.size(); i++) {
+		auto uniform = shader->getUniform(QString::fromStdString(handleNames[i]));
+		if (uniform != nullptr)
+			shader->uniformLocations[i] = uniform->location;
+		else // arrays are listed as name[0]
+			shader->uniformLocations[i] = gl->glGetUniformLocation(programId, handleNames[i].c_str());
+	}
+
+	//uniform blocks
+	gl->glGetProgramiv(programId, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	shader->uniformBlocks.clear();
+
+	for (int i = 0; i<count; i++)
+	{
+		gl->glGetActiveUniformBlockName(programId, i, bufSize, &length, name);
+		auto blockName = QString(name);
+		if (uniformBlockBindings.contains(blockName)) {
+			auto bindingPoint = uniformBlockBindings[blockName];
+			gl->glUniformBlockBinding(programId, i, bindingPoint);
+			shader->uniformBlocks.insert(blockName, bindingPoint);
+		}
+	}
+
 	shader->isDirty = false;
 }
 
+int GraphicsDevice::getUniformLocation(int handle)
+{
+	if (!activeShader)
+		return -1;
+
+	// handles created after the shader was compiled get looked up here
+	auto& locations = activeShader->uniformLocations;
+	if (handle >= locations.size()) {
+		int oldSize = locations.size();
+		locations.resize(handle + 1);
+		for (int i = oldSize; i < locations.size(); i++)
+			locations[i] = -2;
+	}
+
+	if (locations[handle] == -2) {
+		auto handleName = Shader::getUniformHandleName(handle);
+		locations[handle] = gl->glGetUniformLocation(activeProgram->programId(), handleName.c_str());
+	}
+
+	return locations[handle];
+}
+
+void GraphicsDevice::registerUniformBlock(const QString& blockName, int bindingPoint)
+{
+	uniformBlockBindings.insert(blockName, bindingPoint);
+}
+
+void GraphicsDevice::setUniformBuffer(int bindingPoint, UniformBufferPtr uniformBuffer)
+{
+	if (uniformBuffer->isDirty())
+		uniformBuffer->upload(gl);
+
+	gl->glBindBufferBase(GL_UNIFORM_BUFFER, bindingPoint, uniformBuffer->bufferId);
+}
+
+void GraphicsDevice::setTextureBuffer(int target, TextureBufferPtr textureBuffer)
+{
+    gl->glActiveTexture(GL_TEXTURE0+target);
+    if (textureBuffer->isDirty())
+        textureBuffer->upload(gl);
+
+    gl->glBindTexture(GL_TEXTURE_BUFFER, textureBuffer->textureId);
+    gl->glActiveTexture(GL_TEXTURE0);
+}
+
 void GraphicsDevice::setTexture(int target, Texture2DPtr texture)
 {
     gl->glActiveTexture(GL_TEXTURE0+target);
+    // arrays and cube maps have to be bound to their own target
     if (!!texture)
-        gl->glBindTexture(GL_TEXTURE_2D, texture->getTextureId());
+        gl->glBindTexture(texture->texture->target(), texture->getTextureId());
     else
         gl->glBindTexture(GL_TEXTURE_2D, 0);
     gl->glActiveTexture(GL_TEXTURE0);
@@ -360,6 +653,7 @@ void GraphicsDevice::clearTexture(int target)
 
 void GraphicsDevice::setVertexBuffer(VertexBufferPtr vertexBuffer)
 {
+    vertexArray.clear();
     vertexBuffers.clear();
     if (vertexBuffer->isDirty())
         vertexBuffer->upload(gl);
@@ -368,6 +662,7 @@ void GraphicsDevice::setVertexBuffer(VertexBufferPtr vertexBuffer)
 
 void GraphicsDevice::setVertexBuffers(QList<VertexBufferPtr> vertexBuffers)
 {
+    vertexArray.clear();
     this->vertexBuffers.clear();
     for(auto& vertexBuffer : vertexBuffers)
     {
@@ -379,10 +674,14 @@ void GraphicsDevice::setVertexBuffers(QList<VertexBufferPtr> vertexBuffers)
 
 void GraphicsDevice::setIndexBuffer(IndexBufferPtr indexBuffer)
 {
+    vertexArray.clear();
     if (!!indexBuffer) {
         this->indexBuffer = indexBuffer;
-        if (indexBuffer->isDirty())
+        if (indexBuffer->isDirty()) {
+            // keep the upload from changing a bound vao's element buffer
+            gl->glBindVertexArray(0);
             indexBuffer->upload(gl);
+        }
     }
     else
         this->indexBuffer.clear();
@@ -393,6 +692,49 @@ void GraphicsDevice::clearIndexBuffer()
     this->indexBuffer.clear();
 }
 
+void GraphicsDevice::setVertexArray(VertexArrayPtr vertexArray)
+{
+    this->vertexBuffers.clear();
+    this->indexBuffer.clear();
+    this->vertexArray = vertexArray;
+}
+
+void GraphicsDevice::bindVertexArray()
+{
+    // buffers keep their ids when their data changes so
+    // reuploading them doesnt invalidate the vao
+    bool needsUpload = !!vertexArray->indexBuffer && vertexArray->indexBuffer->isDirty();
+    for (auto& buffer : vertexArray->vertexBuffers)
+        needsUpload = needsUpload || buffer->isDirty();
+
+    if (needsUpload) {
+        gl->glBindVertexArray(0);
+        for (auto& buffer : vertexArray->vertexBuffers)
+            if (buffer->isDirty())
+                buffer->upload(gl);
+        if (!!vertexArray->indexBuffer && vertexArray->indexBuffer->isDirty())
+            vertexArray->indexBuffer->upload(gl);
+    }
+
+    VertexArray::deleteOrphanedVaos(contextSerial, gl);
+
+    auto& vaos = vertexArray->vaos;
+    if (!vaos.contains(contextSerial)) {
+        VertexArray::ContextVao vao;
+        gl->glGenVertexArrays(1, &vao.vaoId);
+        vao.version = -1;
+        vaos.insert(contextSerial, vao);
+    }
+
+    auto& vao = vaos[contextSerial];
+    if (vao.version != vertexArray->version) {
+        vertexArray->build(gl, vao.vaoId);
+        vao.version = vertexArray->version;
+    }
+
+    gl->glBindVertexArray(vao.vaoId);
+}
+
 void GraphicsDevice::setBlendState(const BlendState &blendState, bool force)
 {
     bool blendEnabled = true;
@@ -508,6 +850,14 @@ void GraphicsDevice::setRasterizerState(const RasterizerState &rasterState, bool
 
 void GraphicsDevice::drawPrimitives(GLenum primitiveType, int start, int count)
 {
+    // the vao is left bound, anything that binds an element buffer
+    // directly should bind its own vao first
+    if (!!vertexArray) {
+        bindVertexArray();
+        gl->glDrawArrays(primitiveType, start, count);
+        return;
+    }
+
     gl->glBindVertexArray(defautVAO);
     for(auto buffer : vertexBuffers) {
         gl->glBindBuffer(GL_ARRAY_BUFFER, buffer->bufferId);
@@ -526,6 +876,12 @@ void GraphicsDevice::drawPrimitives(GLenum primitiveType, int start, int count)
 #define BUFFER_OFFSET(i) ((char*)nullptr+(i))
 void GraphicsDevice::drawIndexedPrimitives(GLenum primitiveType, int start, int count)
 {
+    if (!!vertexArray) {
+        bindVertexArray();
+        gl->glDrawElements(primitiveType,count,GL_UNSIGNED_INT,BUFFER_OFFSET(start));
+        return;
+    }
+
     gl->glBindVertexArray(defautVAO);
     for(auto buffer : vertexBuffers) {
         gl->glBindBuffer(GL_ARRAY_BUFFER, buffer->bufferId);
@@ -542,8 +898,52 @@ void GraphicsDevice::drawIndexedPrimitives(GLenum primitiveType, int start, int
     gl->glBindVertexArray(0);
 }
 
+// instances get their data from gl_InstanceID, so these only
+// differ from the regular draws in the gl call
+void GraphicsDevice::drawPrimitivesInstanced(GLenum primitiveType, int start, int count, int instanceCount)
+{
+    if (!!vertexArray) {
+        bindVertexArray();
+        gl->glDrawArraysInstanced(primitiveType, start, count, instanceCount);
+        return;
+    }
+
+    gl->glBindVertexArray(defautVAO);
+    for(auto buffer : vertexBuffers) {
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffer->bufferId);
+        buffer->vertexLayout.bind(gl);
+    }
+
+    gl->glDrawArraysInstanced(primitiveType, start, count, instanceCount);
+
+    for(auto buffer : vertexBuffers) {
+        buffer->vertexLayout.unbind(gl);
+    }
+    gl->glBindVertexArray(0);
+}
+
+void GraphicsDevice::drawIndexedPrimitivesInstanced(GLenum primitiveType, int start, int count, int instanceCount)
+{
+    if (!!vertexArray) {
+        bindVertexArray();
+        gl->glDrawElementsInstanced(primitiveType, count, GL_UNSIGNED_INT, BUFFER_OFFSET(start), instanceCount);
+        return;
+    }
 
+    gl->glBindVertexArray(defautVAO);
+    for(auto buffer : vertexBuffers) {
+        gl->glBindBuffer(GL_ARRAY_BUFFER, buffer->bufferId);
+        buffer->vertexLayout.bind(gl);
+    }
 
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,indexBuffer->bufferId);
+    gl->glDrawElementsInstanced(primitiveType, count, GL_UNSIGNED_INT, BUFFER_OFFSET(start), instanceCount);
+    gl->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,0);
 
+    for(auto buffer : vertexBuffers) {
+        buffer->vertexLayout.unbind(gl);
+    }
+    gl->glBindVertexArray(0);
+}
 
 }
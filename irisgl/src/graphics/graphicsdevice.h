@@ -6,6 +6,8 @@
 #include <QOpenGLShaderProgram>
 #include <QRect>
 #include <QStack>
+#include <QMap>
+#include <QHash>
 #include "vertexlayout.h"
 #include "blendstate.h"
 #include "depthstate.h"
@@ -22,6 +24,12 @@ class VertexBuffer;
 typedef QSharedPointer<VertexBuffer> VertexBufferPtr;
 class IndexBuffer;
 typedef QSharedPointer<IndexBuffer> IndexBufferPtr;
+class UniformBuffer;
+typedef QSharedPointer<UniformBuffer> UniformBufferPtr;
+class TextureBuffer;
+typedef QSharedPointer<TextureBuffer> TextureBufferPtr;
+class VertexArray;
+typedef QSharedPointer<VertexArray> VertexArrayPtr;
 
 class VertexBuffer
 {
@@ -93,6 +101,147 @@ private:
     void destroy();
 };
 
+/*
+ * Keeps a mesh's vertex buffers, their layouts and its index buffer in a
+ * vertex array object so the attributes dont have to be set on every draw.
+ * The vao is built the first time it's drawn and rebuilt only when the
+ * buffers change. VAOs arent shared between contexts so there's one per context.
+ * A vao is deleted with the array if its context is current, otherwise the next
+ * time its context binds an array, and dropped if its context is destroyed first.
+ */
+class VertexArray
+{
+    friend class GraphicsDevice;
+public:
+    static VertexArrayPtr create()
+    {
+        return VertexArrayPtr(new VertexArray());
+    }
+
+    ~VertexArray();
+
+    void setVertexBuffers(const QList<VertexBufferPtr>& vertexBuffers);
+    void setIndexBuffer(IndexBufferPtr indexBuffer);
+
+    QList<VertexBufferPtr> getVertexBuffers()
+    {
+        return vertexBuffers;
+    }
+
+    IndexBufferPtr getIndexBuffer()
+    {
+        return indexBuffer;
+    }
+
+private:
+    struct ContextVao
+    {
+        GLuint vaoId;
+        // the vao is stale if this doesnt match the array's version
+        int version;
+    };
+
+    QList<VertexBufferPtr> vertexBuffers;
+    IndexBufferPtr indexBuffer;
+
+    // keyed by getContextSerial
+    QHash<quint64, ContextVao> vaos;
+    int version;
+
+    VertexArray();
+    void build(QOpenGLFunctions_3_2_Core* gl, GLuint vaoId);
+
+    // contexts are numbered instead of keyed by pointer since a new
+    // context can be allocated at the address of a destroyed one
+    static quint64 getContextSerial(QOpenGLContext* context);
+
+    // deletes the vaos that arrays destroyed in other contexts left for this one
+    static void deleteOrphanedVaos(quint64 contextSerial, QOpenGLFunctions_3_2_Core* gl);
+};
+
+/*
+ * Holds the data for a std140 uniform block
+ * Meant for data that changes at least once every frame
+ */
+class UniformBuffer
+{
+    friend class GraphicsDevice;
+public:
+    void* data;
+    int dataSize;
+    GLuint bufferId;
+    bool _isDirty;
+
+    template<typename T>
+    void setData(T* data, unsigned int sizeInBytes)
+    {
+        setData((void*) data, sizeInBytes);
+    }
+
+    void setData(void* data, unsigned int sizeInBytes);
+
+    bool isDirty()
+    {
+        return _isDirty;
+    }
+
+    static UniformBufferPtr create()
+    {
+        return UniformBufferPtr(new UniformBuffer());
+    }
+private:
+    UniformBuffer();
+    void upload(QOpenGLFunctions_3_2_Core* gl);
+    void destroy();
+};
+
+/*
+ * Holds data read in shaders through a samplerBuffer with texelFetch
+ * Used for per-frame arrays too big to fit in a uniform block
+ */
+class TextureBuffer
+{
+    friend class GraphicsDevice;
+public:
+    void* data;
+    unsigned int dataSize;
+    // 0 until the first upload
+    GLuint bufferId;
+    GLuint textureId;
+    // internal format of each texel, such as GL_RGBA32F
+    GLenum format;
+    bool _isDirty;
+
+    template<typename T>
+    void setData(T* data, unsigned int sizeInBytes)
+    {
+        setData((void*) data, sizeInBytes);
+    }
+
+    void setData(void* data, unsigned int sizeInBytes);
+
+    bool isDirty()
+    {
+        return _isDirty;
+    }
+
+    static TextureBufferPtr create(GLenum format)
+    {
+        return TextureBufferPtr(new TextureBuffer(format));
+    }
+
+    // the gl objects are deleted in the current context, which has to
+    // share objects with the one they were made in
+    ~TextureBuffer();
+
+private:
+    // size of the allocation behind data, it's only grown
+    unsigned int capacity;
+
+    TextureBuffer(GLenum format);
+    void upload(QOpenGLFunctions_3_2_Core* gl);
+};
+
 /*
  * This class is intended to wrap all calls to opengl with simpler
  * and easier-to-use functions
@@ -101,6 +250,7 @@ class GraphicsDevice
 {
     QOpenGLFunctions_3_2_Core* gl;
     QOpenGLContext* context;
+    quint64 contextSerial;
 
     QRect viewport;
     RenderTargetPtr _internalRT;
@@ -109,6 +259,8 @@ class GraphicsDevice
     QVector<TexturePtr> textureUnits;
     QVector<VertexBufferPtr> vertexBuffers;
     IndexBufferPtr indexBuffer;
+    // when set, its vao is used instead of vertexBuffers and indexBuffer
+    VertexArrayPtr vertexArray;
 
     // apparently gl needs at least one to be set
     // before you can render anything
@@ -118,6 +270,9 @@ class GraphicsDevice
     // comes from active shader for ease-of-access
     QOpenGLShaderProgram* activeProgram;
 
+    // binding points for uniform blocks, by block name
+    QMap<QString, int> uniformBlockBindings;
+
     bool lastBlendEnabled;
     BlendState lastBlendState;
     DepthState lastDepthState;
@@ -131,7 +286,8 @@ public:
 
     void setRenderTarget(RenderTargetPtr renderTarget);
 	void setRenderTarget(Texture2DPtr renderTarget);
-    void setRenderTarget(QList<Texture2DPtr> colorTargets, Texture2DPtr depthTarget);
+    // depthLayer selects the layer to render to when the depth target is an array
+    void setRenderTarget(QList<Texture2DPtr> colorTargets, Texture2DPtr depthTarget, int depthLayer = 0);
     void clearRenderTarget();
 
     void clear(QColor color);
@@ -163,6 +319,35 @@ public:
 			activeProgram->setUniformValueArray(name, value, count);
 	}
 
+    // handles come from Shader::getUniformHandle
+    template<typename T>
+    void setShaderUniform(int handle, const T& value) {
+        if (activeProgram) {
+            int location = getUniformLocation(handle);
+            if (location != -1)
+                activeProgram->setUniformValue(location, value);
+        }
+    }
+
+    template<typename T>
+    void setShaderUniformArray(int handle, const T* value, const unsigned int count) {
+        if (activeProgram) {
+            int location = getUniformLocation(handle);
+            if (location != -1)
+                activeProgram->setUniformValueArray(location, value, count);
+        }
+    }
+
+    int getUniformLocation(int handle);
+
+    /**
+     * Shaders compiled after this call will have the uniform block
+     * with this name bound to bindingPoint
+     */
+    void registerUniformBlock(const QString& blockName, int bindingPoint);
+    void setUniformBuffer(int bindingPoint, UniformBufferPtr uniformBuffer);
+    void setTextureBuffer(int target, TextureBufferPtr textureBuffer);
+
     void setTexture(int target, Texture2DPtr texture);
     void clearTexture(int target);
 	void compileShader(iris::ShaderPtr shader);
@@ -171,6 +356,7 @@ public:
     void setVertexBuffers(QList<VertexBufferPtr> vertexBuffers);
     void setIndexBuffer(IndexBufferPtr indexBuffer);
     void clearIndexBuffer();
+    void setVertexArray(VertexArrayPtr vertexArray);
 
     void setBlendState(const BlendState& blendState, bool force = false);
     void setDepthState(const DepthState& depthStencil, bool force = false);
@@ -178,12 +364,15 @@ public:
 
     void drawPrimitives(GLenum primitiveType,int start, int count);
     void drawIndexedPrimitives(GLenum primitiveType,int start, int count);
+    void drawPrimitivesInstanced(GLenum primitiveType, int start, int count, int instanceCount);
+    void drawIndexedPrimitivesInstanced(GLenum primitiveType, int start, int count, int instanceCount);
     QOpenGLFunctions_3_2_Core *getGL() const;
 
     static GraphicsDevicePtr create();
 
 private:
 	void compileShader();
+    void bindVertexArray();
 };
 
 }
@@ -21,23 +21,48 @@ For more information see the LICENSE file
 
 #include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
 
 #include "../graphics/vertexlayout.h"
+#include "../graphics/programcache.h"
+
+const aiScene *AssimpObject::getSceneData()
+{
+    // the guid is the model's path, projects skip importing models that have an up to date mesh cache
+    if (scene == nullptr && !GUID.isEmpty()) {
+        importer = QSharedPointer<Assimp::Importer>(new Assimp::Importer);
+        scene = importer->ReadFile(GUID.toStdString().c_str(), aiProcessPreset_TargetRealtime_Fast);
+    }
+
+    return scene;
+}
 
 namespace iris
 {
 
 QOpenGLShaderProgram* GraphicsHelper::loadShader(QString vsPath,QString fsPath)
 {
+    return loadShader(vsPath, fsPath, QStringList());
+}
+
+QOpenGLShaderProgram* GraphicsHelper::loadShader(QString vsPath, QString fsPath, const QStringList& defines)
+{
+    auto vsShader = insertShaderDefines(loadAndProcessShader(vsPath), defines);
+    auto fsShader = insertShaderDefines(loadAndProcessShader(fsPath), defines);
+
+    auto program = new QOpenGLShaderProgram;
+
+    auto cacheKey = ProgramCache::createKey(vsShader, fsShader);
+    if (ProgramCache::load(program, cacheKey))
+        return program;
+
     QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex);
-    auto vsShader = loadAndProcessShader(vsPath);
     vshader->compileSourceCode(vsShader);
 
     QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment);
-    auto fsShader = loadAndProcessShader(fsPath);
     fshader->compileSourceCode(fsShader);
 
-    auto program = new QOpenGLShaderProgram;
     program->addShader(vshader);
     program->addShader(fshader);
 
@@ -52,14 +77,47 @@ QOpenGLShaderProgram* GraphicsHelper::loadShader(QString vsPath,QString fsPath)
     program->bindAttributeLocation("a_boneIndices",(int)VertexAttribUsage::BoneIndices);
     program->bindAttributeLocation("a_boneWeights",(int)VertexAttribUsage::BoneWeights);
 
-
-    program->link();
+    ProgramCache::link(program, cacheKey);
 
     return program;
 }
 
+QString GraphicsHelper::insertShaderDefines(const QString& source, const QStringList& defines)
+{
+    if (defines.isEmpty())
+        return source;
+
+    QString defineText;
+    for (auto& define : defines)
+        defineText += QString("#define %1\n").arg(define);
+
+    // #version has to stay the first statement
+    auto versionPos = source.indexOf("#version");
+    if (versionPos == -1)
+        return defineText + source;
+
+    auto lineEnd = source.indexOf('\n', versionPos);
+    if (lineEnd == -1)
+        return source + "\n" + defineText;
+
+    auto result = source;
+    return result.insert(lineEnd + 1, defineText);
+}
+
 QString GraphicsHelper::loadAndProcessShader(QString shaderPath)
 {
+    // shaders in the resources never change so each one is only expanded once
+    static QMutex resourceShadersMutex;
+    static QHash<QString, QString> resourceShaders;
+
+    bool isResource = shaderPath.startsWith(":");
+    if (isResource) {
+        QMutexLocker locker(&resourceShadersMutex);
+        auto iter = resourceShaders.constFind(shaderPath);
+        if (iter != resourceShaders.constEnd())
+            return iter.value();
+    }
+
     QRegExp internalFileInclude("\\<(.+\\\\)*((.+)\\.(.+))\\>");
     QRegExp externalFileInclude("\\\"(.+\\\\)*((.+)\\.(.+))\\\"");
 
@@ -93,7 +151,13 @@ QString GraphicsHelper::loadAndProcessShader(QString shaderPath)
         }
     }
 
-    return lines.join('\n');
+    auto source = QString(lines.join('\n'));
+    if (isResource) {
+        QMutexLocker locker(&resourceShadersMutex);
+        resourceShaders.insert(shaderPath, source);
+    }
+
+    return source;
 }
 
 QList<iris::MeshPtr> GraphicsHelper::loadAllMeshesFromFile(QString filePath)
@@ -108,12 +172,16 @@ void GraphicsHelper::loadAllMeshesAndAnimationsFromFile(
     QList<MeshPtr> &meshes,
     QMap<QString, SkeletalAnimationPtr> &animations)
 {
+    if (MeshCache::load(filePath, meshes, animations))
+        return;
+
     Assimp::Importer importer;
     const aiScene *scene = importer.ReadFile(filePath.toStdString().c_str(), aiProcessPreset_TargetRealtime_Fast);
 
     if (scene != nullptr) {
         meshes = loadAllMeshesFromAssimpScene(scene);
         animations = Mesh::extractAnimations(scene, filePath);
+        MeshCache::store(filePath, meshes, animations);
     }
 }
 
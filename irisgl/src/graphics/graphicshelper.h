@@ -14,10 +14,14 @@ For more information see the LICENSE file
 
 #include <QString>
 #include <QList>
+#include <QStringList>
+#include <QSharedPointer>
 #include "../irisglfwd.h"
 #include "../graphics/mesh.h"
+#include "../graphics/meshcache.h"
 
 class aiScene;
+namespace Assimp { class Importer; }
 
 class QOpenGLShaderProgram;
 
@@ -25,12 +29,14 @@ class AssimpObject {
 public:
 	AssimpObject() = default;
     AssimpObject(const aiScene *ai, QString g) : scene(ai), GUID(g) {}
-    const aiScene *getSceneData() { return scene; }
+    // models that were read from the mesh cache are only imported once something asks for their scene
+    const aiScene *getSceneData();
     QString getGUID() { return GUID; }
     ~AssimpObject() {}
 
 private:
-    const aiScene *scene;
+    const aiScene *scene = nullptr;
+    QSharedPointer<Assimp::Importer> importer;
     QString GUID;
 };
 
@@ -44,9 +50,17 @@ class GraphicsHelper
 {
 public:
     static QOpenGLShaderProgram* loadShader(QString vsPath, QString fsPath);
+    static QOpenGLShaderProgram* loadShader(QString vsPath, QString fsPath, const QStringList& defines);
 
     static QString loadAndProcessShader(QString shaderPath);
 
+    /**
+     * Adds a #define for each name right after the #version line
+     * @param source shader source
+     * @param defines names to define
+     */
+    static QString insertShaderDefines(const QString& source, const QStringList& defines);
+
     /**
      * Loads all meshes from mesh file
      * Useful for loading a mesh file containing multiple meshes
@@ -68,11 +82,15 @@ public:
      {
          for (F ao : store) {
              if (ao->path == filePath) {
+                if (MeshCache::load(filePath, meshes, animations))
+                    break;
+
                 const aiScene* scene = qvariant_cast<AssimpObject*>(ao->getValue())->getSceneData();
 
                 if (scene != nullptr) {
                     meshes = loadAllMeshesFromAssimpScene(scene);
                     animations = Mesh::extractAnimations(scene, filePath);
+                    MeshCache::store(filePath, meshes, animations);
                 }
 
                 break;
@@ -0,0 +1,292 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "lightclusters.h"
+#include "graphicsdevice.h"
+#include "../scenegraph/lightnode.h"
+
+#include <QVector4D>
+#include <qmath.h>
+#include <cmath>
+
+namespace iris
+{
+
+// texels of light data per light, has to match getClusterLight in scene_data.glsl
+#define LIGHT_DATA_TEXELS 4
+
+LightClusters::LightClusters()
+{
+    boundsValid = false;
+    nearPlane = 0.1f;
+    farPlane = 100.0f;
+    perspective = true;
+    depthScale = 0;
+    depthBias = 0;
+
+    clusterCount = LIGHT_CLUSTERS_X * LIGHT_CLUSTERS_Y * LIGHT_CLUSTERS_Z;
+    lightCount = 0;
+    clusterCounts.fill(0, clusterCount);
+
+    lightBuffer = TextureBuffer::create(GL_RGBA32F);
+    clusterBuffer = TextureBuffer::create(GL_R32UI);
+    buffersDirty = true;
+}
+
+float LightClusters::getSliceDepth(int slice) const
+{
+    float t = (float)slice / LIGHT_CLUSTERS_Z;
+    if (perspective)
+        return nearPlane * qPow(farPlane / nearPlane, t);
+    return nearPlane + (farPlane - nearPlane) * t;
+}
+
+int LightClusters::getSlice(float depth) const
+{
+    float d = perspective ? std::log(qMax(depth, 0.0001f)) : depth;
+    int slice = (int)qFloor(d * depthScale + depthBias);
+    return qBound(0, slice, LIGHT_CLUSTERS_Z - 1);
+}
+
+void LightClusters::updateClusterBounds(const QMatrix4x4& projMatrix)
+{
+    if (boundsValid && projMatrix == boundsProjMatrix)
+        return;
+
+    // recover the clip planes from the projection, vr eyes have their own
+    // asymmetric projections so the camera's settings can't be used
+    perspective = projMatrix(3, 3) == 0.0f;
+    if (perspective) {
+        nearPlane = projMatrix(2, 3) / (projMatrix(2, 2) - 1.0f);
+        farPlane = projMatrix(2, 3) / (projMatrix(2, 2) + 1.0f);
+        if (!std::isfinite(farPlane) || farPlane <= nearPlane)
+            farPlane = nearPlane * 10000.0f;
+
+        depthScale = LIGHT_CLUSTERS_Z / std::log(farPlane / nearPlane);
+        depthBias = -std::log(nearPlane) * depthScale;
+    } else {
+        nearPlane = (projMatrix(2, 3) + 1.0f) / projMatrix(2, 2);
+        farPlane = (projMatrix(2, 3) - 1.0f) / projMatrix(2, 2);
+
+        depthScale = LIGHT_CLUSTERS_Z / (farPlane - nearPlane);
+        depthBias = -nearPlane * depthScale;
+    }
+
+    // each tile corner is a line through the view, clusters are bounded
+    // by where the corners of their tile cross their slice's planes
+    auto invProj = projMatrix.inverted();
+    const int cornersX = LIGHT_CLUSTERS_X + 1;
+    const int cornersY = LIGHT_CLUSTERS_Y + 1;
+    QVector<QVector3D> nearCorners(cornersX * cornersY);
+    QVector<QVector3D> farCorners(cornersX * cornersY);
+
+    for (int y = 0; y < cornersY; y++) {
+        for (int x = 0; x < cornersX; x++) {
+            float ndcX = -1.0f + 2.0f * x / LIGHT_CLUSTERS_X;
+            float ndcY = -1.0f + 2.0f * y / LIGHT_CLUSTERS_Y;
+
+            auto n = invProj * QVector4D(ndcX, ndcY, -1.0f, 1.0f);
+            auto f = invProj * QVector4D(ndcX, ndcY, 1.0f, 1.0f);
+            nearCorners[y * cornersX + x] = n.toVector3DAffine();
+            farCorners[y * cornersX + x] = f.toVector3DAffine();
+        }
+    }
+
+    auto cornerAtDepth = [&](int corner, float depth) {
+        const auto& n = nearCorners[corner];
+        const auto& f = farCorners[corner];
+        float t = (-depth - n.z()) / (f.z() - n.z());
+        return n + (f - n) * t;
+    };
+
+    clusterBounds.resize(clusterCount);
+    for (int z = 0; z < LIGHT_CLUSTERS_Z; z++) {
+        float sliceNear = getSliceDepth(z);
+        float sliceFar = getSliceDepth(z + 1);
+
+        for (int y = 0; y < LIGHT_CLUSTERS_Y; y++) {
+            for (int x = 0; x < LIGHT_CLUSTERS_X; x++) {
+                int corners[4] = {
+                    y * cornersX + x,
+                    y * cornersX + x + 1,
+                    (y + 1) * cornersX + x,
+                    (y + 1) * cornersX + x + 1
+                };
+
+                auto& bounds = clusterBounds[(z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x];
+                bounds.min = bounds.max = cornerAtDepth(corners[0], sliceNear);
+                for (int c = 0; c < 4; c++) {
+                    for (float depth : {sliceNear, sliceFar}) {
+                        auto p = cornerAtDepth(corners[c], depth);
+                        bounds.min = QVector3D(qMin(bounds.min.x(), p.x()), qMin(bounds.min.y(), p.y()), qMin(bounds.min.z(), p.z()));
+                        bounds.max = QVector3D(qMax(bounds.max.x(), p.x()), qMax(bounds.max.y(), p.y()), qMax(bounds.max.z(), p.z()));
+                    }
+                }
+            }
+        }
+    }
+
+    boundsProjMatrix = projMatrix;
+    boundsValid = true;
+}
+
+void LightClusters::build(const QVector<LightNodePtr>& lights,
+                          const QMatrix4x4& viewMatrix,
+                          const QMatrix4x4& projMatrix)
+{
+    updateClusterBounds(projMatrix);
+
+    lightData.clear();
+    pairClusters.clear();
+    pairLights.clear();
+    lightCount = 0;
+
+    for (const auto& light : lights) {
+        float radius = light->distance;
+        if (radius <= 0.0f)
+            continue;
+
+        auto position = light->globalTransform.column(3).toVector3D();
+        auto center = viewMatrix * position;
+        float depth = -center.z();
+
+        if (depth + radius < nearPlane || depth - radius > farPlane)
+            continue;
+
+        int minSlice = getSlice(qMax(depth - radius, nearPlane));
+        int maxSlice = getSlice(qMin(depth + radius, farPlane));
+
+        // the tiles covered by the light's projected box, every tile if
+        // it crosses the near plane since it can't be projected then
+        int minX = 0, maxX = LIGHT_CLUSTERS_X - 1;
+        int minY = 0, maxY = LIGHT_CLUSTERS_Y - 1;
+        if (!perspective || depth - radius > nearPlane) {
+            float ndcMinX = 1.0f, ndcMaxX = -1.0f;
+            float ndcMinY = 1.0f, ndcMaxY = -1.0f;
+            bool first = true;
+
+            for (int i = 0; i < 8; i++) {
+                QVector4D corner(center.x() + ((i & 1) ? radius : -radius),
+                                 center.y() + ((i & 2) ? radius : -radius),
+                                 center.z() + ((i & 4) ? radius : -radius),
+                                 1.0f);
+                auto clip = projMatrix * corner;
+                float x = clip.x() / clip.w();
+                float y = clip.y() / clip.w();
+
+                if (first) {
+                    ndcMinX = ndcMaxX = x;
+                    ndcMinY = ndcMaxY = y;
+                    first = false;
+                } else {
+                    ndcMinX = qMin(ndcMinX, x);
+                    ndcMaxX = qMax(ndcMaxX, x);
+                    ndcMinY = qMin(ndcMinY, y);
+                    ndcMaxY = qMax(ndcMaxY, y);
+                }
+            }
+
+            if (ndcMaxX < -1.0f || ndcMinX > 1.0f || ndcMaxY < -1.0f || ndcMinY > 1.0f)
+                continue;
+
+            minX = qBound(0, (int)qFloor((ndcMinX * 0.5f + 0.5f) * LIGHT_CLUSTERS_X), LIGHT_CLUSTERS_X - 1);
+            maxX = qBound(0, (int)qFloor((ndcMaxX * 0.5f + 0.5f) * LIGHT_CLUSTERS_X), LIGHT_CLUSTERS_X - 1);
+            minY = qBound(0, (int)qFloor((ndcMinY * 0.5f + 0.5f) * LIGHT_CLUSTERS_Y), LIGHT_CLUSTERS_Y - 1);
+            maxY = qBound(0, (int)qFloor((ndcMaxY * 0.5f + 0.5f) * LIGHT_CLUSTERS_Y), LIGHT_CLUSTERS_Y - 1);
+        }
+
+        // the projected box is loose near the edges of the view, the clusters
+        // it covers are tested against the light's sphere to trim it down
+        const float radiusSqrd = radius * radius;
+        bool added = false;
+
+        for (int z = minSlice; z <= maxSlice; z++) {
+            for (int y = minY; y <= maxY; y++) {
+                for (int x = minX; x <= maxX; x++) {
+                    int cluster = (z * LIGHT_CLUSTERS_Y + y) * LIGHT_CLUSTERS_X + x;
+                    const auto& bounds = clusterBounds[cluster];
+
+                    float distSqrd = 0;
+                    for (int i = 0; i < 3; i++) {
+                        float c = center[i];
+                        if (c < bounds.min[i])
+                            distSqrd += (bounds.min[i] - c) * (bounds.min[i] - c);
+                        else if (c > bounds.max[i])
+                            distSqrd += (c - bounds.max[i]) * (c - bounds.max[i]);
+                    }
+
+                    if (distSqrd > radiusSqrd)
+                        continue;
+
+                    pairClusters.append(cluster);
+                    pairLights.append(lightCount);
+                    added = true;
+                }
+            }
+        }
+
+        if (!added)
+            continue;
+
+        auto direction = light->getLightDir();
+        float data[LIGHT_DATA_TEXELS * 4] = {
+            position.x(), position.y(), position.z(), light->distance,
+            direction.x(), direction.y(), direction.z(), light->intensity,
+            (float)light->color.redF(), (float)light->color.greenF(), (float)light->color.blueF(), (float)light->lightType,
+            light->spotCutOff, light->spotCutOffSoftness, 0.0f, 0.0f
+        };
+        for (float value : data)
+            lightData.append(value);
+
+        lightCount++;
+    }
+
+    // counting sort of the pairs by cluster, each cluster's offset and
+    // count come first and its light indices after all of them
+    clusterCounts.fill(0);
+    for (auto cluster : pairClusters)
+        clusterCounts[cluster]++;
+
+    clusterData.resize(clusterCount * 2 + pairClusters.size());
+    quint32 offset = clusterCount * 2;
+    for (int i = 0; i < clusterCount; i++) {
+        clusterData[i * 2] = offset;
+        clusterData[i * 2 + 1] = 0;
+        offset += clusterCounts[i];
+    }
+
+    for (int i = 0; i < pairClusters.size(); i++) {
+        auto cluster = pairClusters[i];
+        auto& count = clusterData[cluster * 2 + 1];
+        clusterData[clusterData[cluster * 2] + count] = pairLights[i];
+        count++;
+    }
+
+    // empty buffer textures aren't allowed
+    if (lightData.isEmpty())
+        lightData.fill(0.0f, LIGHT_DATA_TEXELS * 4);
+
+    buffersDirty = true;
+}
+
+void LightClusters::bind(GraphicsDevicePtr graphics, int lightDataUnit, int clusterDataUnit)
+{
+    if (buffersDirty) {
+        lightBuffer->setData(lightData.data(), lightData.size() * sizeof(float));
+        clusterBuffer->setData(clusterData.data(), clusterData.size() * sizeof(quint32));
+        buffersDirty = false;
+    }
+
+    graphics->setTextureBuffer(lightDataUnit, lightBuffer);
+    graphics->setTextureBuffer(clusterDataUnit, clusterBuffer);
+}
+
+}
@@ -0,0 +1,123 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QMatrix4x4>
+#include "../irisglfwd.h"
+
+// size of the cluster grid, the view is split into x by y tiles on screen
+// and each tile into z slices that get deeper further from the camera
+#define LIGHT_CLUSTERS_X 16
+#define LIGHT_CLUSTERS_Y 9
+#define LIGHT_CLUSTERS_Z 24
+
+namespace iris
+{
+
+/**
+ * Splits the view frustum into a grid of clusters and lists the lights reaching each one
+ * so fragments only shade the lights of their own cluster instead of every light in the scene
+ *
+ * Lights are binned on the cpu each frame by testing their range against the view space
+ * bounds of the clusters they project onto. The results go into two buffer textures:
+ * the light data as four RGBA32F texels per light, and the clusters as R32UI texels holding
+ * an offset and count per cluster followed by the light indices they point into
+ */
+class LightClusters
+{
+public:
+    LightClusters();
+
+    /**
+     * Bins lights into the clusters of the view described by viewMatrix and projMatrix
+     * Only point and spot lights should be passed, directional lights reach every cluster
+     */
+    void build(const QVector<LightNodePtr>& lights,
+               const QMatrix4x4& viewMatrix,
+               const QMatrix4x4& projMatrix);
+
+    // uploads the buffers if they were rebuilt and binds them to the given texture units
+    void bind(GraphicsDevicePtr graphics, int lightDataUnit, int clusterDataUnit);
+
+    /**
+     * A view space depth d falls in slice floor(f(d) * scale + bias), where f is log
+     * for perspective projections and linear for orthographic ones
+     */
+    float getDepthScale() const
+    {
+        return depthScale;
+    }
+
+    float getDepthBias() const
+    {
+        return depthBias;
+    }
+
+    bool isLogarithmic() const
+    {
+        return perspective;
+    }
+
+    int getLightCount() const
+    {
+        return lightCount;
+    }
+
+    // total number of light references in all clusters
+    int getIndexCount() const
+    {
+        return clusterData.size() - clusterCount * 2;
+    }
+
+private:
+    struct ClusterBounds
+    {
+        QVector3D min;
+        QVector3D max;
+    };
+
+    // view space bounds of each cluster, only rebuilt when the projection changes
+    QVector<ClusterBounds> clusterBounds;
+    QMatrix4x4 boundsProjMatrix;
+    bool boundsValid;
+
+    float nearPlane;
+    float farPlane;
+    bool perspective;
+    float depthScale;
+    float depthBias;
+
+    int clusterCount;
+    int lightCount;
+
+    QVector<float> lightData;
+    QVector<quint32> clusterData;
+    // (cluster, light) pairs found while binning, sorted into clusterData afterwards
+    QVector<quint32> pairClusters;
+    QVector<quint32> pairLights;
+    QVector<quint32> clusterCounts;
+
+    TextureBufferPtr lightBuffer;
+    TextureBufferPtr clusterBuffer;
+    bool buffersDirty;
+
+    void updateClusterBounds(const QMatrix4x4& projMatrix);
+    float getSliceDepth(int slice) const;
+    int getSlice(float depth) const;
+};
+
+}
+
+#endif // LIGHTCLUSTERS_H
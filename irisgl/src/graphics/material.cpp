@@ -30,7 +30,7 @@ int RenderLayer::Gizmo = 6000;//the scene depth is cleared before this pass
 void Material::begin(GraphicsDevicePtr device,ScenePtr scene)
 {
     //shader->program->bind();
-	device->setShader(shader);
+	device->setShader(getActiveShader());
     this->bindTextures(device);
 }
 
@@ -80,7 +80,7 @@ void Material::bindTextures(GraphicsDevicePtr device)
 
         if (!!tex) {
             tex->texture->bind();
-            shader->program->setUniformValue(it.key().toStdString().c_str(), count);
+            device->setShaderUniform(it.key(), count);
         } else {
 			device->clearTexture(count);
         }
@@ -154,4 +154,22 @@ QOpenGLShaderProgram* Material::getProgram()
 	return shader->program;
 }
 
+ShaderPtr Material::getActiveShader()
+{
+	if (instanced) {
+		auto instancedShader = shader->getInstancedShader();
+		if (!!instancedShader)
+			return instancedShader;
+	}
+
+	return shader;
+}
+
+long Material::generateMaterialId()
+{
+    return nextId++;
+}
+
+std::atomic<long> Material::nextId(0);
+
 }
@@ -16,6 +16,7 @@ For more information see the LICENSE file
 //#include "renderitem.h"
 #include <QOpenGLShaderProgram>
 #include "renderstates.h"
+#include <atomic>
 
 class QOpenGLShaderProgram;
 class QOpenGLTexture;
@@ -56,6 +57,8 @@ public:
     Material() {
         acceptsLighting = true;
         numTextures = 0;
+        instanced = false;
+        materialId = generateMaterialId();
     }
 
     virtual ~Material() {}
@@ -122,6 +125,19 @@ public:
 
 	static MaterialPtr fromShader(ShaderPtr shader);
 
+    long getMaterialId() {
+        return materialId;
+    }
+
+    /**
+     * Makes begin() bind the instanced variant of the shader
+     * Set by the renderer before drawing instances, it has no effect
+     * if the shader doesnt support instancing
+     */
+    void setInstanced(bool instanced) {
+        this->instanced = instanced;
+    }
+
 protected:
     /**
      * Sets the amount of textures your shader uses
@@ -135,6 +151,20 @@ protected:
 	
 
 	QOpenGLShaderProgram* getProgram();
+
+    /**
+     * Returns the shader begin() should bind
+     */
+    ShaderPtr getActiveShader();
+
+private:
+    bool instanced;
+
+    // unique id used by the renderer to group items by material
+    long materialId;
+
+    static long generateMaterialId();
+    static std::atomic<long> nextId;
 };
 
 }
@@ -57,6 +57,7 @@ QMatrix4x4 aiMatrixToQMatrix(aiMatrix4x4 aiMat) {
 
 Mesh::Mesh()
 {
+	meshId = generateMeshId();
 	triMesh = nullptr;
 	_isDirty = 0;
 	lastShaderId = -1;
@@ -67,6 +68,7 @@ Mesh::Mesh()
 // http://ogldev.atspace.co.uk/www/tutorial38/tutorial38.html
 Mesh::Mesh(aiMesh* mesh)
 {
+	meshId = generateMeshId();
 	_isDirty = 0;
     lastShaderId = -1;
     //gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_2_Core>();
@@ -142,7 +144,6 @@ Mesh::Mesh(aiMesh* mesh)
     // So some calculation still has to be done
     QVector<unsigned int> indices;
     indices.reserve(mesh->mNumFaces * 3);
-    triMesh->triangles.reserve(mesh->mNumFaces);
     for(unsigned i = 0; i < mesh->mNumFaces; i++)
     {
 
@@ -154,20 +155,21 @@ Mesh::Mesh(aiMesh* mesh)
         indices.append(face.mIndices[0]);
         indices.append(face.mIndices[1]);
         indices.append(face.mIndices[2]);
-
-        auto a = mesh->mVertices[face.mIndices[0]];
-        auto b = mesh->mVertices[face.mIndices[1]];
-        auto c = mesh->mVertices[face.mIndices[2]];
-
-        triMesh->addTriangle(QVector3D(a.x, a.y, a.z),
-                             QVector3D(b.x, b.y, b.z),
-                             QVector3D(c.x, c.y, c.z));
     }
 
     usesIndexBuffer = true;
     idxBuffer = IndexBuffer::create();
     idxBuffer->setData(indices.data(), sizeof(unsigned int) * indices.size());
 
+    // the trimesh shares the index list with the index buffer instead of
+    // storing three points per triangle
+    QVector<QVector3D> positions(mesh->mNumVertices);
+    for (unsigned i = 0; i < mesh->mNumVertices; i++) {
+        auto v = mesh->mVertices[i];
+        positions[i] = QVector3D(v.x, v.y, v.z);
+    }
+    triMesh->setTriangles(positions, indices);
+
     // the true size
     numVerts = indices.size();
 
@@ -178,6 +180,7 @@ Mesh::Mesh(aiMesh* mesh)
 //todo: extract trimesh from data
 Mesh::Mesh(void* data,int dataSize,int numElements,VertexLayout* vertexLayout)
 {
+    meshId = generateMeshId();
     lastShaderId = -1;
     triMesh = nullptr;
     numVerts = numElements;
@@ -226,16 +229,22 @@ void Mesh::setPrimitiveMode(const PrimitiveMode &value)
 void Mesh::clearVertexBuffers()
 {
     this->vertexBuffers.clear();
+    if (!!vertexArray)
+        vertexArray->setVertexBuffers(vertexBuffers);
 }
 
 void Mesh::addVertexBuffer(VertexBufferPtr vertexBuffer)
 {
     this->vertexBuffers.append(vertexBuffer);
+    if (!!vertexArray)
+        vertexArray->setVertexBuffers(vertexBuffers);
 }
 
 void Mesh::setIndexBuffer(IndexBufferPtr indexBuffer)
 {
     this->idxBuffer = indexBuffer;
+    if (!!vertexArray)
+        vertexArray->setIndexBuffer(idxBuffer);
 }
 
 bool Mesh::hasSkeleton()
@@ -269,15 +278,39 @@ void Mesh::draw(GraphicsDevicePtr device)
 	if (numVerts == 0)
 		return;
 
-    device->setVertexBuffers(vertexBuffers);
+    if (!vertexArray) {
+        vertexArray = VertexArray::create();
+        vertexArray->setVertexBuffers(vertexBuffers);
+        vertexArray->setIndexBuffer(idxBuffer);
+    }
+
+    device->setVertexArray(vertexArray);
     if (!!idxBuffer) {
-        device->setIndexBuffer(idxBuffer);
         device->drawIndexedPrimitives(glPrimitive, 0, numVerts);
     } else {
         device->drawPrimitives(glPrimitive, 0, numVerts);
     }
 }
 
+void Mesh::drawInstanced(GraphicsDevicePtr device, int instanceCount)
+{
+	if (numVerts == 0 || instanceCount == 0)
+		return;
+
+    if (!vertexArray) {
+        vertexArray = VertexArray::create();
+        vertexArray->setVertexBuffers(vertexBuffers);
+        vertexArray->setIndexBuffer(idxBuffer);
+    }
+
+    device->setVertexArray(vertexArray);
+    if (!!idxBuffer) {
+        device->drawIndexedPrimitivesInstanced(glPrimitive, 0, numVerts, instanceCount);
+    } else {
+        device->drawPrimitivesInstanced(glPrimitive, 0, numVerts, instanceCount);
+    }
+}
+
 MeshPtr Mesh::loadMesh(QString filePath)
 {
 	// legacy -- update TODO
@@ -424,6 +457,13 @@ void Mesh::setVertexCount(const unsigned int count)
 	numVerts = count;
 }
 
+long Mesh::generateMeshId()
+{
+    return nextId++;
+}
+
+std::atomic<long> Mesh::nextId(0);
+
 void Mesh::addVertexArray(VertexAttribUsage usage,void* dataPtr,int size,GLenum type,int numComponents)
 {
     VertexLayout layout;
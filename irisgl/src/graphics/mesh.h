@@ -15,6 +15,7 @@ For more information see the LICENSE file
 #include <QString>
 #include <qopengl.h>
 #include <QColor>
+#include <atomic>
 #include "../irisglfwd.h"
 #include "../animation/skeletalanimation.h"
 #include "../geometry/boundingsphere.h"
@@ -96,6 +97,8 @@ class Mesh
 
 	QList<VertexBufferPtr> vertexBuffers;
 	IndexBufferPtr idxBuffer;
+	// holds the buffers above so they're bound with a single call
+	VertexArrayPtr vertexArray;
 	GraphicsDevicePtr device;
 
     GLenum glPrimitive;
@@ -138,6 +141,12 @@ public:
     //void draw(QOpenGLFunctions_3_2_Core* gl, QOpenGLShaderProgram* mat);
     void draw(GraphicsDevicePtr device);
 
+    /**
+     * Draws instanceCount copies of the mesh in one call
+     * The shader is expected to get each instance's data from gl_InstanceID
+     */
+    void drawInstanced(GraphicsDevicePtr device, int instanceCount);
+
     static MeshPtr loadMesh(QString filePath);
     static MeshPtr loadAnimatedMesh(QString filePath);
     static SkeletonPtr extractSkeleton(const aiMesh* mesh, const aiScene* scene);
@@ -216,10 +225,21 @@ public:
 	void addVertexBuffer(VertexBufferPtr vertexBuffer);
 	void setIndexBuffer(IndexBufferPtr indexBuffer);
 
+	QList<VertexBufferPtr> getVertexBuffers() { return vertexBuffers; }
+	IndexBufferPtr getIndexBuffer() { return idxBuffer; }
+
 	AABB getAABB(){return aabb;}
 	BoundingSphere getBoundingSphere() { return boundingSphere; }
 
+    long getMeshId() { return meshId; }
+
 private:
+    // unique id used by the renderer to group items by mesh
+    long meshId;
+
+    static long generateMeshId();
+    static std::atomic<long> nextId;
+
     void addVertexArray(VertexAttribUsage usage,void* data,int size,GLenum type,int numComponents);
     void addIndexArray(void* data,int size,GLenum type);
 
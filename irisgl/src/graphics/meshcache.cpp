@@ -0,0 +1,544 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "meshcache.h"
+#include "mesh.h"
+#include "skeleton.h"
+#include "graphicsdevice.h"
+#include "vertexlayout.h"
+#include "../geometry/trimesh.h"
+#include "../animation/skeletalanimation.h"
+#include "../animation/keyframeanimation.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QAtomicInt>
+#include <QDir>
+
+#include <cstring>
+
+namespace iris
+{
+
+namespace
+{
+
+const quint32 meshCacheMagic = 0x48534d49; // IMSH
+// bump when the layout below or the way meshes are built from assimp changes
+const quint32 meshCacheVersion = 1;
+
+QAtomicInt hitCount;
+QAtomicInt missCount;
+
+struct CacheHeader
+{
+    quint32 magic;
+    quint32 version;
+    qint64 sourceModified;
+    qint64 sourceSize;
+};
+
+// everything is written in the machine's own byte order, the cache never leaves it
+class CacheWriter
+{
+public:
+    QByteArray data;
+
+    template<typename T>
+    void write(const T& value)
+    {
+        data.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    void writeBytes(const void* bytes, quint32 size)
+    {
+        write(size);
+        data.append(reinterpret_cast<const char*>(bytes), size);
+    }
+
+    void writeString(const QString& string)
+    {
+        auto utf8 = string.toUtf8();
+        writeBytes(utf8.constData(), utf8.size());
+    }
+
+    void writeVector3D(const QVector3D& v)
+    {
+        write(v.x());
+        write(v.y());
+        write(v.z());
+    }
+};
+
+// reads from the mapped file, any read past the end fails so a truncated file is just a miss
+class CacheReader
+{
+    const uchar* ptr;
+    const uchar* end;
+
+public:
+    CacheReader(const uchar* data, qint64 size) : ptr(data), end(data + size) {}
+
+    template<typename T>
+    bool read(T& value)
+    {
+        if (end - ptr < (qint64) sizeof(T))
+            return false;
+        memcpy(&value, ptr, sizeof(T));
+        ptr += sizeof(T);
+        return true;
+    }
+
+    // returns a pointer into the mapping instead of copying
+    bool readBytes(const uchar*& bytes, quint32& size)
+    {
+        if (!read(size) || end - ptr < (qint64) size)
+            return false;
+        bytes = ptr;
+        ptr += size;
+        return true;
+    }
+
+    bool readString(QString& string)
+    {
+        const uchar* bytes;
+        quint32 size;
+        if (!readBytes(bytes, size))
+            return false;
+        string = QString::fromUtf8(reinterpret_cast<const char*>(bytes), size);
+        return true;
+    }
+
+    bool readVector3D(QVector3D& v)
+    {
+        float x, y, z;
+        if (!read(x) || !read(y) || !read(z))
+            return false;
+        v = QVector3D(x, y, z);
+        return true;
+    }
+};
+
+QString getCacheFilePath(const QString& sourcePath)
+{
+    if (sourcePath.isEmpty() || sourcePath.startsWith(":"))
+        return QString();
+
+    QFileInfo info(sourcePath);
+    return info.absolutePath() + "/.meshcache/" + info.fileName() + ".mesh";
+}
+
+bool isHeaderValid(const CacheHeader& header, const QString& sourcePath)
+{
+    if (header.magic != meshCacheMagic || header.version != meshCacheVersion)
+        return false;
+
+    // the model changed since it was cached
+    QFileInfo source(sourcePath);
+    return header.sourceModified == source.lastModified().toMSecsSinceEpoch() &&
+           header.sourceSize == source.size();
+}
+
+void writeMesh(CacheWriter& writer, const MeshPtr& mesh)
+{
+    writer.write((qint32) mesh->numVerts);
+    writer.write((qint32) mesh->numFaces);
+
+    auto aabb = mesh->getAABB();
+    writer.writeVector3D(aabb.getMin());
+    writer.writeVector3D(aabb.getMax());
+    writer.writeVector3D(mesh->boundingSphere.pos);
+    writer.write(mesh->boundingSphere.radius);
+
+    auto vertexBuffers = mesh->getVertexBuffers();
+    writer.write((quint32) vertexBuffers.size());
+    for (auto vb : vertexBuffers) {
+        auto attribs = vb->vertexLayout.getAttribs();
+        writer.write((quint32) attribs.size());
+        for (const auto& attrib : attribs) {
+            writer.write((qint32) attrib.usage);
+            writer.write((qint32) attrib.type);
+            writer.write((qint32) attrib.count);
+            writer.write((qint32) attrib.sizeInBytes);
+        }
+        writer.writeBytes(vb->data, vb->dataSize);
+    }
+
+    auto idxBuffer = mesh->getIndexBuffer();
+    if (!!idxBuffer)
+        writer.writeBytes(idxBuffer->data, idxBuffer->dataSize);
+    else
+        writer.writeBytes(nullptr, 0);
+
+    // bones are stored in skeleton order with the indices of their children
+    auto skel = mesh->getSkeleton();
+    if (!skel) {
+        writer.write((quint32) 0);
+        return;
+    }
+
+    writer.write((quint32) skel->bones.size());
+    for (auto bone : skel->bones) {
+        writer.writeString(bone->name);
+        for (int i = 0; i < 16; i++)
+            writer.write(bone->inversePoseMatrix.constData()[i]);
+
+        writer.write((quint32) bone->childBones.size());
+        for (auto child : bone->childBones)
+            writer.write((qint32) skel->bones.indexOf(child));
+    }
+}
+
+template<typename T, typename F>
+void writeKeys(CacheWriter& writer, const KeyFrame<T>* keyFrame, F writeValue)
+{
+    writer.write((quint32) keyFrame->keys.size());
+    for (auto key : keyFrame->keys) {
+        writer.write(key->time);
+        writeValue(key->value);
+    }
+}
+
+void writeAnimation(CacheWriter& writer, const SkeletalAnimationPtr& anim)
+{
+    auto writeVector = [&writer](const QVector3D& v) {
+        writer.writeVector3D(v);
+    };
+    auto writeQuaternion = [&writer](const QQuaternion& q) {
+        writer.write(q.scalar());
+        writer.writeVector3D(q.vector());
+    };
+
+    writer.writeString(anim->name);
+    writer.write((quint32) anim->boneAnimations.size());
+    for (auto iter = anim->boneAnimations.constBegin(); iter != anim->boneAnimations.constEnd(); ++iter) {
+        writer.writeString(iter.key());
+        writeKeys(writer, iter.value()->posKeys.data(), writeVector);
+        writeKeys(writer, iter.value()->rotKeys.data(), writeQuaternion);
+        writeKeys(writer, iter.value()->scaleKeys.data(), writeVector);
+    }
+}
+
+MeshPtr readMesh(CacheReader& reader)
+{
+    qint32 numVerts, numFaces;
+    QVector3D aabbMin, aabbMax, sphereCenter;
+    float sphereRadius;
+    quint32 bufferCount;
+    if (!reader.read(numVerts) || !reader.read(numFaces) ||
+        !reader.readVector3D(aabbMin) || !reader.readVector3D(aabbMax) ||
+        !reader.readVector3D(sphereCenter) || !reader.read(sphereRadius) ||
+        !reader.read(bufferCount))
+        return MeshPtr();
+
+    auto mesh = Mesh::create();
+    mesh->vertexLayout = nullptr;
+    mesh->numVerts = numVerts;
+    mesh->numFaces = numFaces;
+    mesh->boundingSphere.pos = sphereCenter;
+    mesh->boundingSphere.radius = sphereRadius;
+    // an empty box was left at negative infinity, merging its corners would flip it
+    if (aabbMin.x() <= aabbMax.x()) {
+        mesh->aabb.merge(aabbMin);
+        mesh->aabb.merge(aabbMax);
+    }
+
+    const uchar* positions = nullptr;
+    quint32 positionsSize = 0;
+
+    for (quint32 i = 0; i < bufferCount; i++) {
+        quint32 attribCount;
+        if (!reader.read(attribCount))
+            return MeshPtr();
+
+        VertexLayout layout;
+        bool isPosition = false;
+        for (quint32 j = 0; j < attribCount; j++) {
+            qint32 usage, type, count, sizeInBytes;
+            if (!reader.read(usage) || !reader.read(type) || !reader.read(count) || !reader.read(sizeInBytes))
+                return MeshPtr();
+            layout.addAttrib((VertexAttribUsage) usage, type, count, sizeInBytes);
+
+            isPosition = attribCount == 1 && usage == (int) VertexAttribUsage::Position &&
+                         type == GL_FLOAT && count == 3;
+        }
+
+        const uchar* bytes;
+        quint32 size;
+        if (!reader.readBytes(bytes, size))
+            return MeshPtr();
+
+        // copied straight out of the mapping into the buffer that gets uploaded
+        auto vb = VertexBuffer::create(layout);
+        vb->setData((void*) bytes, size);
+        mesh->addVertexBuffer(vb);
+
+        if (isPosition) {
+            positions = bytes;
+            positionsSize = size;
+        }
+    }
+
+    const uchar* indexBytes;
+    quint32 indexSize;
+    if (!reader.readBytes(indexBytes, indexSize))
+        return MeshPtr();
+
+    mesh->triMesh = new TriMesh();
+    mesh->setPrimitiveMode(PrimitiveMode::Triangles);
+
+    if (indexSize > 0) {
+        auto idxBuffer = IndexBuffer::create();
+        idxBuffer->setData((void*) indexBytes, indexSize);
+        mesh->setIndexBuffer(idxBuffer);
+        mesh->usesIndexBuffer = true;
+
+        // picking still needs the triangles on the cpu
+        if (positions != nullptr) {
+            QVector<QVector3D> vertices(positionsSize / (sizeof(float) * 3));
+            memcpy(vertices.data(), positions, vertices.size() * sizeof(float) * 3);
+            QVector<unsigned int> indices(indexSize / sizeof(unsigned int));
+            memcpy(indices.data(), indexBytes, indices.size() * sizeof(unsigned int));
+            mesh->triMesh->setTriangles(vertices, indices);
+        }
+    }
+
+    quint32 boneCount;
+    if (!reader.read(boneCount))
+        return MeshPtr();
+    if (boneCount == 0)
+        return mesh;
+
+    auto skel = Skeleton::create();
+    QVector<QVector<qint32>> children(boneCount);
+    for (quint32 i = 0; i < boneCount; i++) {
+        QString name;
+        if (!reader.readString(name))
+            return MeshPtr();
+
+        float matrix[16];
+        for (int j = 0; j < 16; j++)
+            if (!reader.read(matrix[j]))
+                return MeshPtr();
+
+        auto bone = Bone::create(name);
+        // QMatrix4x4 takes rows, the data was written in column order
+        bone->inversePoseMatrix = QMatrix4x4(matrix).transposed();
+        bone->poseMatrix = bone->inversePoseMatrix.inverted();
+        skel->addBone(bone);
+
+        quint32 childCount;
+        if (!reader.read(childCount))
+            return MeshPtr();
+        for (quint32 j = 0; j < childCount; j++) {
+            qint32 child;
+            if (!reader.read(child))
+                return MeshPtr();
+            children[i].append(child);
+        }
+    }
+
+    for (quint32 i = 0; i < boneCount; i++) {
+        for (auto child : children[i]) {
+            if (child < 0 || child >= (qint32) boneCount)
+                return MeshPtr();
+            skel->bones[i]->addChild(skel->bones[child]);
+        }
+    }
+
+    mesh->setSkeleton(skel);
+    return mesh;
+}
+
+template<typename T, typename F>
+bool readKeys(CacheReader& reader, KeyFrame<T>* keyFrame, F readValue)
+{
+    quint32 count;
+    if (!reader.read(count))
+        return false;
+
+    for (quint32 i = 0; i < count; i++) {
+        double time;
+        T value;
+        if (!reader.read(time) || !readValue(value))
+            return false;
+        keyFrame->addKey(value, time);
+    }
+
+    return true;
+}
+
+SkeletalAnimationPtr readAnimation(CacheReader& reader, const QString& source)
+{
+    auto readVector = [&reader](QVector3D& v) {
+        return reader.readVector3D(v);
+    };
+    auto readQuaternion = [&reader](QQuaternion& q) {
+        float scalar;
+        QVector3D vector;
+        if (!reader.read(scalar) || !reader.readVector3D(vector))
+            return false;
+        q = QQuaternion(scalar, vector);
+        return true;
+    };
+
+    auto anim = SkeletalAnimation::create();
+    anim->source = source;
+
+    quint32 boneAnimCount;
+    if (!reader.readString(anim->name) || !reader.read(boneAnimCount))
+        return SkeletalAnimationPtr();
+
+    for (quint32 i = 0; i < boneAnimCount; i++) {
+        QString boneName;
+        if (!reader.readString(boneName))
+            return SkeletalAnimationPtr();
+
+        auto boneAnim = new BoneAnimation();
+        anim->addBoneAnimation(boneName, boneAnim);
+
+        if (!readKeys(reader, boneAnim->posKeys.data(), readVector) ||
+            !readKeys(reader, boneAnim->rotKeys.data(), readQuaternion) ||
+            !readKeys(reader, boneAnim->scaleKeys.data(), readVector))
+            return SkeletalAnimationPtr();
+    }
+
+    return anim;
+}
+
+}
+
+bool MeshCache::load(const QString& sourcePath,
+                     QList<MeshPtr>& meshes,
+                     QMap<QString, SkeletalAnimationPtr>& animations)
+{
+    auto cachePath = getCacheFilePath(sourcePath);
+    QFile file(cachePath);
+    if (cachePath.isEmpty() || !file.open(QIODevice::ReadOnly)) {
+        missCount.ref();
+        return false;
+    }
+
+    auto size = file.size();
+    auto data = file.map(0, size);
+    if (data == nullptr) {
+        missCount.ref();
+        return false;
+    }
+
+    CacheReader reader(data, size);
+    CacheHeader header;
+    quint32 meshCount, animationCount;
+    if (!reader.read(header) || !isHeaderValid(header, sourcePath) ||
+        !reader.read(meshCount) || !reader.read(animationCount)) {
+        file.unmap(data);
+        missCount.ref();
+        return false;
+    }
+
+    // nothing is handed back unless the whole file reads
+    QList<MeshPtr> cachedMeshes;
+    QMap<QString, SkeletalAnimationPtr> cachedAnimations;
+    bool valid = true;
+
+    for (quint32 i = 0; valid && i < meshCount; i++) {
+        auto mesh = readMesh(reader);
+        valid = !!mesh;
+        cachedMeshes.append(mesh);
+    }
+
+    for (quint32 i = 0; valid && i < animationCount; i++) {
+        auto anim = readAnimation(reader, sourcePath);
+        valid = !!anim;
+        if (valid)
+            cachedAnimations.insert(anim->name, anim);
+    }
+
+    file.unmap(data);
+
+    if (!valid) {
+        missCount.ref();
+        return false;
+    }
+
+    meshes = cachedMeshes;
+    animations = cachedAnimations;
+    hitCount.ref();
+    return true;
+}
+
+bool MeshCache::store(const QString& sourcePath,
+                      const QList<MeshPtr>& meshes,
+                      const QMap<QString, SkeletalAnimationPtr>& animations)
+{
+    auto cachePath = getCacheFilePath(sourcePath);
+    if (cachePath.isEmpty())
+        return false;
+
+    QFileInfo source(sourcePath);
+    if (!source.exists())
+        return false;
+
+    CacheWriter writer;
+    CacheHeader header;
+    header.magic = meshCacheMagic;
+    header.version = meshCacheVersion;
+    header.sourceModified = source.lastModified().toMSecsSinceEpoch();
+    header.sourceSize = source.size();
+    writer.write(header);
+
+    writer.write((quint32) meshes.size());
+    writer.write((quint32) animations.size());
+
+    for (const auto& mesh : meshes)
+        writeMesh(writer, mesh);
+
+    for (const auto& anim : animations)
+        writeAnimation(writer, anim);
+
+    if (!QDir().mkpath(QFileInfo(cachePath).absolutePath()))
+        return false;
+
+    // written to a temporary file first so a project opening at the same time never maps half a file
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    file.write(writer.data);
+    return file.commit();
+}
+
+bool MeshCache::isValid(const QString& sourcePath)
+{
+    auto cachePath = getCacheFilePath(sourcePath);
+    QFile file(cachePath);
+    if (cachePath.isEmpty() || !file.open(QIODevice::ReadOnly))
+        return false;
+
+    CacheHeader header;
+    if (file.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header))
+        return false;
+
+    return isHeaderValid(header, sourcePath);
+}
+
+int MeshCache::getHitCount()
+{
+    return hitCount.load();
+}
+
+int MeshCache::getMissCount()
+{
+    return missCount.load();
+}
+
+}
@@ -0,0 +1,64 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <QString>
+#include <QList>
+#include <QMap>
+#include "../irisglfwd.h"
+
+namespace iris
+{
+
+/**
+ * Keeps the processed meshes of a model file on disk so it doesn't have to go through
+ * assimp again every time a project is opened
+ * A cache file holds the vertex and index buffers, bounds and skeleton of every mesh in the
+ * model along with its animations. It's memory mapped when read and the buffers are copied
+ * straight out of the mapping
+ *
+ * Cache files live in a .meshcache folder beside the model and are checked against the
+ * model's size and modification time, an edited model just misses and is imported again
+ */
+class MeshCache
+{
+public:
+    /**
+     * Reads the meshes and animations cached for the model at sourcePath
+     * Returns false if there's no cache file or it's out of date
+     */
+    static bool load(const QString& sourcePath,
+                     QList<MeshPtr>& meshes,
+                     QMap<QString, SkeletalAnimationPtr>& animations);
+
+    /**
+     * Writes meshes and animations as the cache for the model at sourcePath
+     * meshes are expected to be the ones built from the model's aiScene
+     */
+    static bool store(const QString& sourcePath,
+                      const QList<MeshPtr>& meshes,
+                      const QMap<QString, SkeletalAnimationPtr>& animations);
+
+    /**
+     * Checks if the model at sourcePath has an up to date cache without reading all of it
+     * Safe to call from any thread
+     */
+    static bool isValid(const QString& sourcePath);
+
+    static int getHitCount();
+    static int getMissCount();
+};
+
+}
+
+#endif // MESHCACHE_H
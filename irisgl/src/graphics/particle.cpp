@@ -0,0 +1,116 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "particle.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define PARTICLE_USE_SSE
+#include <xmmintrin.h>
+#endif
+
+namespace iris
+{
+
+void ParticlePool::add(QVector3D pos, QVector3D vel, float gr, float ll, float rot, float scl)
+{
+    positionX.append(pos.x());
+    positionY.append(pos.y());
+    positionZ.append(pos.z());
+    velocityX.append(vel.x());
+    velocityY.append(vel.y());
+    velocityZ.append(vel.z());
+    gravityEffect.append(gr);
+    lifeLength.append(ll);
+    elapsedTime.append(0);
+    rotation.append(rot);
+    scale.append(scl);
+}
+
+void ParticlePool::remove(int index)
+{
+    auto swapRemove = [index](QVector<float>& values) {
+        values[index] = values.last();
+        values.removeLast();
+    };
+
+    swapRemove(positionX);
+    swapRemove(positionY);
+    swapRemove(positionZ);
+    swapRemove(velocityX);
+    swapRemove(velocityY);
+    swapRemove(velocityZ);
+    swapRemove(gravityEffect);
+    swapRemove(lifeLength);
+    swapRemove(elapsedTime);
+    swapRemove(rotation);
+    swapRemove(scale);
+}
+
+void ParticlePool::clear()
+{
+    // resize keeps the capacity around for the next particles
+    positionX.resize(0);
+    positionY.resize(0);
+    positionZ.resize(0);
+    velocityX.resize(0);
+    velocityY.resize(0);
+    velocityZ.resize(0);
+    gravityEffect.resize(0);
+    lifeLength.resize(0);
+    elapsedTime.resize(0);
+    rotation.resize(0);
+    scale.resize(0);
+}
+
+void ParticlePool::integrate(float delta)
+{
+    const int count = size();
+
+    float* px = positionX.data();
+    float* py = positionY.data();
+    float* pz = positionZ.data();
+    float* vx = velocityX.data();
+    float* vy = velocityY.data();
+    float* vz = velocityZ.data();
+    float* age = elapsedTime.data();
+    const float* gravity = gravityEffect.constData();
+
+    int i = 0;
+
+#ifdef PARTICLE_USE_SSE
+    const __m128 dt = _mm_set1_ps(delta);
+    const __m128 gravityDelta = _mm_set1_ps(PARTICLE_GRAVITY * delta);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 velX = _mm_loadu_ps(vx + i);
+        __m128 velZ = _mm_loadu_ps(vz + i);
+        __m128 velY = _mm_add_ps(_mm_loadu_ps(vy + i), _mm_mul_ps(gravityDelta, _mm_loadu_ps(gravity + i)));
+        _mm_storeu_ps(vy + i, velY);
+
+        _mm_storeu_ps(px + i, _mm_add_ps(_mm_loadu_ps(px + i), _mm_mul_ps(velX, dt)));
+        _mm_storeu_ps(py + i, _mm_add_ps(_mm_loadu_ps(py + i), _mm_mul_ps(velY, dt)));
+        _mm_storeu_ps(pz + i, _mm_add_ps(_mm_loadu_ps(pz + i), _mm_mul_ps(velZ, dt)));
+
+        _mm_storeu_ps(age + i, _mm_add_ps(_mm_loadu_ps(age + i), dt));
+    }
+#endif
+
+    // whatever doesn't fill a group of four
+    for (; i < count; i++) {
+        vy[i] += PARTICLE_GRAVITY * gravity[i] * delta;
+        px[i] += vx[i] * delta;
+        py[i] += vy[i] * delta;
+        pz[i] += vz[i] * delta;
+        age[i] += delta;
+    }
+}
+
+}
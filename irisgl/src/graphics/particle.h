@@ -13,47 +13,57 @@ For more information see the LICENSE file
 #define PARTICLE_H
 
 #include <QVector3D>
-#include <QDebug>
+#include <QVector>
 
 namespace iris {
 
-class Particle {
+#define PARTICLE_GRAVITY -50.0f
+
+/**
+ * The live particles of an emitter
+ * Each attribute is its own array so the simulation can update four particles at a time
+ * Particles aren't kept in any order, a dead particle is replaced by the last one
+ */
+class ParticlePool {
 
 public:
-    QVector3D position;
-    QVector3D velocity;
-
-    float gravityEffect;
-    float lifeLength;
-    float rotation;
-    float scale;
-
-    float elapsedTime = 0;
-    float GRAVITY = -50;
-
-    Particle(QVector3D pos, QVector3D vel, float gr, float ll, float rot, float scl) {
-        position    = pos;
-        velocity    = vel;
-        gravityEffect = gr;
-        lifeLength  = ll;
-        rotation    = rot;
-        scale       = scl;
-    }
+    QVector<float> positionX, positionY, positionZ;
+    QVector<float> velocityX, velocityY, velocityZ;
 
-    float getRotation() {
-        return rotation;
+    QVector<float> gravityEffect;
+    QVector<float> lifeLength;
+    QVector<float> elapsedTime;
+    QVector<float> rotation;
+    QVector<float> scale;
+
+    int size() const {
+        return positionX.size();
     }
 
-    float getScale() {
-        return scale;
+    bool isEmpty() const {
+        return positionX.isEmpty();
     }
 
-    QVector3D getPosition() {
-        return position;
+    void add(QVector3D pos, QVector3D vel, float gr, float ll, float rot, float scl);
+
+    /**
+     * Removes the particle at index by moving the last particle into its place
+     */
+    void remove(int index);
+
+    void clear();
+
+    /**
+     * Applies gravity to the velocities, moves the particles and ages them by delta
+     */
+    void integrate(float delta);
+
+    QVector3D getPosition(int index) const {
+        return QVector3D(positionX[index], positionY[index], positionZ[index]);
     }
 
-    float getLife() {
-        return lifeLength - elapsedTime;
+    float getLife(int index) const {
+        return lifeLength[index] - elapsedTime[index];
     }
 };
 
@@ -25,13 +25,26 @@ For more information see the LICENSE file
 
 namespace iris {
 
+// texels per particle in the instance data: position and scale, then rotation in w
+#define PARTICLE_INSTANCE_TEXELS 2
+
+/**
+ * Draws every particle of an emitter with one instanced draw of a billboard quad
+ * The particles are read from a texture buffer indexed by gl_InstanceID since
+ * per-instance vertex attributes aren't part of gl 3.2
+ */
 class ParticleRenderer {
 
 private:
     GLuint quadVAO, quadVBO;
+    GLuint instanceBuffer, instanceTexture;
+    int instanceBufferSize;
+    int maxTexels;
     QOpenGLFunctions_3_2_Core* gl;
 	DepthState depthState;
 
+    QVector<float> instanceData;
+
 public:
     bool useAdditive;
 
@@ -59,38 +72,23 @@ public:
                                   (GLvoid*) (3 * sizeof(GLfloat)));
         gl->glBindVertexArray(0);
 
+        gl->glGenBuffers(1, &instanceBuffer);
+        gl->glGenTextures(1, &instanceTexture);
+        instanceBufferSize = 0;
+
+        GLint maxTextureBufferSize = 0;
+        gl->glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferSize);
+        maxTexels = maxTextureBufferSize;
+
         useAdditive = true;
 		depthState = DepthState(true, false);
     }
 
-    void updateModelViewMatrix(GraphicsDevicePtr device,
-							   ShaderPtr shader,
-                               QVector3D pos,
-                               float rot,
-                               float scale,
-                               QMatrix4x4 viewMatrix)
-    {
-        QMatrix4x4 modelMatrix;
-        modelMatrix.translate(pos);
-
-        modelMatrix(0, 0) = viewMatrix(0, 0);
-        modelMatrix(0, 1) = viewMatrix(1, 0);
-        modelMatrix(0, 2) = viewMatrix(2, 0);
-
-        modelMatrix(1, 0) = viewMatrix(0, 1);
-        modelMatrix(1, 1) = viewMatrix(1, 1);
-        modelMatrix(1, 2) = viewMatrix(2, 1);
-
-        modelMatrix(2, 0) = viewMatrix(0, 2);
-        modelMatrix(2, 1) = viewMatrix(1, 2);
-        modelMatrix(2, 2) = viewMatrix(2, 2);
-
-        modelMatrix.rotate((float) rot, QVector3D(0, 0, 1));
-        modelMatrix.scale(scale, scale, scale);
-
-        QMatrix4x4 modelViewMatrix = viewMatrix * modelMatrix;
-		//shader->setUniformValue("modelViewMatrix", modelViewMatrix);
-		device->setShaderUniform("modelViewMatrix", modelViewMatrix);
+    ~ParticleRenderer() {
+        gl->glDeleteTextures(1, &instanceTexture);
+        gl->glDeleteBuffers(1, &instanceBuffer);
+        gl->glDeleteBuffers(1, &quadVBO);
+        gl->glDeleteVertexArrays(1, &quadVAO);
     }
 
     void setIcon(QSharedPointer<iris::Texture2D> icon) {
@@ -100,15 +98,35 @@ public:
     void render(GraphicsDevicePtr device,
 				ShaderPtr shader,
                 iris::RenderData* renderData,
-                std::vector<Particle*>& particles)
+                const ParticlePool& particles)
+    {
+        const int count = particles.size();
+        if (count == 0)
+            return;
+
+        uploadInstances(particles);
+        renderInstances(device, shader, renderData, instanceBuffer, count, PARTICLE_INSTANCE_TEXELS);
+    }
+
+    /**
+     * Draws count particles whose instance data is already in buffer
+     * Each particle takes texelsPerParticle texels, the first two laid out like the
+     * ones uploaded from a ParticlePool
+     */
+    void renderInstances(GraphicsDevicePtr device,
+                         ShaderPtr shader,
+                         iris::RenderData* renderData,
+                         GLuint buffer,
+                         int count,
+                         int texelsPerParticle)
     {
 		device->setShader(shader, true);
 
 		device->setShaderUniform("projectionMatrix", renderData->projMatrix);
-        QMatrix4x4 viewMatrix = renderData->viewMatrix;
-
-        gl->glBindVertexArray(quadVAO);
-		
+        device->setShaderUniform("viewMatrix", renderData->viewMatrix);
+        device->setShaderUniform("pTex", 0);
+        device->setShaderUniform("u_particles", 1);
+        device->setShaderUniform("u_texelsPerParticle", texelsPerParticle);
 
         if (useAdditive) {
             device->setBlendState(BlendState(GL_SRC_ALPHA, GL_ONE), true);
@@ -118,25 +136,61 @@ public:
 
 		device->setDepthState(depthState, true);
 
-        for (auto particle : particles) {
-            updateModelViewMatrix(
-						device,
-                        shader,
-                        particle->getPosition(),
-                        particle->getRotation(),
-                        particle->getScale(),
-                        viewMatrix
-                    );
-
-            if (!!icon) {
-                gl->glActiveTexture(GL_TEXTURE0);
-                icon->texture->bind();
-            }
-            gl->glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        if (!!icon) {
+            gl->glActiveTexture(GL_TEXTURE0);
+            icon->texture->bind();
         }
 
+        gl->glActiveTexture(GL_TEXTURE1);
+        gl->glBindTexture(GL_TEXTURE_BUFFER, instanceTexture);
+        gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, buffer);
+        gl->glActiveTexture(GL_TEXTURE0);
+
+        gl->glBindVertexArray(quadVAO);
+
+        // gl only guarantees 64k texels in a texture buffer, desktop drivers allow far more
+        // anything past the limit can't be fetched so it isn't drawn
+        if (maxTexels > 0)
+            count = qMin(count, maxTexels / texelsPerParticle);
+
+        gl->glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+
         gl->glBindVertexArray(0);
 
+        gl->glActiveTexture(GL_TEXTURE1);
+        gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+        gl->glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    void uploadInstances(const ParticlePool& particles)
+    {
+        const int count = particles.size();
+        instanceData.resize(count * PARTICLE_INSTANCE_TEXELS * 4);
+
+        float* data = instanceData.data();
+        for (int i = 0; i < count; i++) {
+            data[0] = particles.positionX[i];
+            data[1] = particles.positionY[i];
+            data[2] = particles.positionZ[i];
+            data[3] = particles.scale[i];
+            data[4] = 0;
+            data[5] = 0;
+            data[6] = 0;
+            data[7] = particles.rotation[i];
+            data += PARTICLE_INSTANCE_TEXELS * 4;
+        }
+
+        const int sizeInBytes = instanceData.size() * sizeof(float);
+        // grow with some headroom so a steadily emitting system doesn't keep resizing
+        if (sizeInBytes > instanceBufferSize)
+            instanceBufferSize = sizeInBytes + sizeInBytes / 2;
+
+        // the old storage is orphaned so this doesn't wait on last frame's draw
+        gl->glBindBuffer(GL_TEXTURE_BUFFER, instanceBuffer);
+        gl->glBufferData(GL_TEXTURE_BUFFER, instanceBufferSize, nullptr, GL_STREAM_DRAW);
+        gl->glBufferSubData(GL_TEXTURE_BUFFER, 0, sizeInBytes, instanceData.constData());
+        gl->glBindBuffer(GL_TEXTURE_BUFFER, 0);
     }
 };
 
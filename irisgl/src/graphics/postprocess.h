@@ -3,6 +3,7 @@
 
 #include "../irisglfwd.h"
 #include <QEnableSharedFromThis>
+#include <QMatrix4x4>
 
 class QOpenGLShader;
 
@@ -48,6 +49,16 @@ public:
 
     }
 
+    /**
+     * Effects that only multiply each pixel's color by a matrix return true and fill
+     * in matrix, the manager then merges them with their neighbours into one pass
+     * instead of calling process
+     */
+    virtual bool getColorMatrix(QMatrix4x4& matrix)
+    {
+        return false;
+    }
+
     virtual QList<Property*> getProperties()
     {
         return QList<Property*>();
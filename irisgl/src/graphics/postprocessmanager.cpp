@@ -7,6 +7,7 @@
 #include "utils/fullscreenquad.h"
 #include "texture2d.h"
 #include "postprocess.h"
+#include "graphicshelper.h"
 
 #include "../postprocesses/coloroverlaypostprocess.h"
 #include "../postprocesses/radialblurpostprocess.h"
@@ -24,6 +25,10 @@ PostProcessManager::PostProcessManager(GraphicsDevicePtr device)
     gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_2_Core>();
     rtInitialized = false;
     fsQuad = new FullScreenQuad();
+    frame = 0;
+
+    colorMatrixShader = GraphicsHelper::loadShader(":assets/shaders/postprocesses/default.vs",
+                                                   ":assets/shaders/postprocesses/colormatrix.fs");
 
     //postProcesses.append(new ColorOverlayPostProcess());
     //postProcesses.append(new RadialBlurPostProcess());
@@ -87,12 +92,100 @@ void PostProcessManager::blit(iris::Texture2DPtr source, iris::Texture2DPtr dest
 void PostProcessManager::process(PostProcessContext *context)
 {
     context->manager = this;
+    context->finalTexture = context->sceneTexture;
 
-    blit(context->sceneTexture, context->finalTexture);
+    // consecutive color matrices are multiplied together and applied in one pass
+    QMatrix4x4 colorMatrix;
+    bool hasColorMatrix = false;
 
     for (auto process : postProcesses) {
+        QMatrix4x4 matrix;
+        if (process->getColorMatrix(matrix)) {
+            colorMatrix = matrix * colorMatrix;
+            hasColorMatrix = true;
+            continue;
+        }
+
+        if (hasColorMatrix) {
+            applyColorMatrix(context, colorMatrix);
+            colorMatrix.setToIdentity();
+            hasColorMatrix = false;
+        }
+
         process->process(context);
     }
+
+    if (hasColorMatrix)
+        applyColorMatrix(context, colorMatrix);
+
+    // the result stays valid until the next call since nothing acquires textures till then
+    if (context->finalTexture != context->sceneTexture)
+        releaseTexture(context->finalTexture);
+}
+
+void PostProcessManager::endFrame()
+{
+    trimTexturePool();
+    frame++;
+}
+
+void PostProcessManager::applyColorMatrix(PostProcessContext *context, const QMatrix4x4 &matrix)
+{
+    auto output = context->createOutput();
+
+    colorMatrixShader->bind();
+    colorMatrixShader->setUniformValue("u_sceneTexture", 0);
+    colorMatrixShader->setUniformValue("u_colorMatrix", matrix);
+    blit(context->finalTexture, output, colorMatrixShader);
+    colorMatrixShader->release();
+
+    context->setOutput(output);
+}
+
+Texture2DPtr PostProcessManager::acquireTexture(int width, int height, QOpenGLTexture::TextureFormat format)
+{
+    width = qMax(width, 1);
+    height = qMax(height, 1);
+
+    for (int i = 0; i < freeTextures.size(); i++) {
+        auto& pooled = freeTextures[i];
+        if (pooled.format == format &&
+            pooled.texture->getWidth() == width &&
+            pooled.texture->getHeight() == height) {
+            auto entry = freeTextures.takeAt(i);
+            entry.frameUsed = frame;
+            usedTextures.append(entry);
+            return entry.texture;
+        }
+    }
+
+    PooledTexture entry;
+    entry.texture = Texture2D::create(width, height, format);
+    entry.format = format;
+    entry.frameUsed = frame;
+    usedTextures.append(entry);
+
+    return entry.texture;
+}
+
+void PostProcessManager::releaseTexture(Texture2DPtr texture)
+{
+    for (int i = 0; i < usedTextures.size(); i++) {
+        if (usedTextures[i].texture == texture) {
+            freeTextures.append(usedTextures.takeAt(i));
+            return;
+        }
+    }
+}
+
+void PostProcessManager::trimTexturePool()
+{
+    // the same views run the same passes every frame so a texture left
+    // over now is from a resize or an effect that got removed
+    for (int i = freeTextures.size() - 1; i >= 0; i--) {
+        if (freeTextures[i].frameUsed != frame)
+            freeTextures.removeAt(i);
+    }
 }
 
 void PostProcessManager::initRenderTarget()
@@ -107,4 +200,27 @@ void PostProcessManager::initRenderTarget()
     }
 }
 
+int PostProcessContext::getWidth()
+{
+    return sceneTexture->getWidth();
+}
+
+int PostProcessContext::getHeight()
+{
+    return sceneTexture->getHeight();
+}
+
+Texture2DPtr PostProcessContext::createOutput(float scale)
+{
+    return manager->acquireTexture(getWidth() * scale, getHeight() * scale);
+}
+
+void PostProcessContext::setOutput(Texture2DPtr output)
+{
+    if (finalTexture != sceneTexture)
+        manager->releaseTexture(finalTexture);
+
+    finalTexture = output;
+}
+
 }
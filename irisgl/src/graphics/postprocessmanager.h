@@ -2,6 +2,9 @@
 #define POSTPROCESSMANAGER_H
 
 #include "../irisglfwd.h"
+#include <QList>
+#include <QMatrix4x4>
+#include <QOpenGLTexture>
 
 class QOpenGLShaderProgram;
 class QOpenGLFunctions_3_2_Core;
@@ -15,8 +18,28 @@ namespace iris {
 //class PostProcessContext;
 
 
+/**
+ * Runs the post processes one after the other, each reading the result of the last
+ * The scene texture is read directly by the first pass, so nothing is copied when there
+ * are no post processes. Effects that can be written as a color matrix are folded into a
+ * single pass and all the textures passes render to are borrowed from a pool
+ *
+ * Effects don't declare their inputs and outputs like passes in a frame graph would.
+ * Every effect reads only the previous result, plus the depth texture which the scene
+ * pass always writes, and makes one output. So the order of the list is already the
+ * dependency order, and a texture can go back to the pool as soon as the next effect
+ * replaces it
+ */
 class PostProcessManager
 {
+    // a pooled texture, frameUsed is the last frame it was acquired in
+    struct PooledTexture
+    {
+        Texture2DPtr texture;
+        QOpenGLTexture::TextureFormat format;
+        int frameUsed;
+    };
+
     bool enabled;
     QList<PostProcessPtr> postProcesses;
     RenderTargetPtr renderTarget;
@@ -27,6 +50,12 @@ class PostProcessManager
 
     GraphicsDevicePtr device;
 
+    QOpenGLShaderProgram* colorMatrixShader;
+
+    QList<PooledTexture> freeTextures;
+    QList<PooledTexture> usedTextures;
+    int frame;
+
 public:
     PostProcessManager(GraphicsDevicePtr device);
 
@@ -43,8 +72,31 @@ public:
 
     void process(PostProcessContext* context);
 
+    /**
+     * Returns a texture from the pool, creating one if none of the free textures match
+     * It should be given back with releaseTexture once the pass reading it is done
+     */
+    Texture2DPtr acquireTexture(int width, int height,
+                                QOpenGLTexture::TextureFormat format = QOpenGLTexture::RGBAFormat);
+    void releaseTexture(Texture2DPtr texture);
+
+    /**
+     * Multiplies the colors of the current result by matrix in a single pass
+     */
+    void applyColorMatrix(PostProcessContext* context, const QMatrix4x4& matrix);
+
+    /**
+     * Frees the pooled textures that weren't acquired since the last call
+     * The renderer calls this once a frame after every view is drawn, views of
+     * different sizes processed in between keep their textures
+     */
+    void endFrame();
+
 private:
     void initRenderTarget();
+
+    // frees the textures nothing acquired this frame
+    void trimTexturePool();
 };
 
 class PostProcessContext
@@ -53,9 +105,24 @@ public:
     Texture2DPtr depthTexture;
     Texture2DPtr sceneTexture;
 
+    // result of the last pass, the scene texture until a pass writes something
+    // post processes read their input from here and replace it with setOutput
     Texture2DPtr finalTexture;
 
     PostProcessManager* manager;
+
+    int getWidth();
+    int getHeight();
+
+    /**
+     * Borrows a texture the size of the scene scaled by scale for a pass to render into
+     */
+    Texture2DPtr createOutput(float scale = 1.0f);
+
+    /**
+     * Makes output the current result, the previous result goes back to the pool
+     */
+    void setOutput(Texture2DPtr output);
 };
 
 }
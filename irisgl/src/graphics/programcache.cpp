@@ -0,0 +1,226 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "programcache.h"
+#include "../core/logger.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QCryptographicHash>
+#include <QStandardPaths>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QFile>
+#include <QDir>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace iris
+{
+
+// bump when the file layout or the attribute bindings done before linking change
+static const quint32 programCacheVersion = 1;
+
+typedef void (QOPENGLF_APIENTRYP GetProgramBinaryFunc)(GLuint program, GLsizei bufSize, GLsizei* length,
+                                                        GLenum* binaryFormat, void* binary);
+typedef void (QOPENGLF_APIENTRYP ProgramBinaryFunc)(GLuint program, GLenum binaryFormat,
+                                                     const void* binary, GLsizei length);
+typedef void (QOPENGLF_APIENTRYP ProgramParameteriFunc)(GLuint program, GLenum pname, GLint value);
+
+struct ProgramBinaryFunctions
+{
+    GetProgramBinaryFunc getProgramBinary;
+    ProgramBinaryFunc programBinary;
+    ProgramParameteriFunc programParameteri;
+};
+
+static QAtomicInt hitCount;
+static QAtomicInt missCount;
+
+static QMutex cacheDirectoryMutex;
+static QString cacheDirectory;
+
+// gl 3.2 core doesn't have program binaries so they're resolved from the extension
+// some drivers expose it but support no formats, those are treated as not having it
+static bool resolveFunctions(ProgramBinaryFunctions& funcs)
+{
+    auto context = QOpenGLContext::currentContext();
+    if (context == nullptr)
+        return false;
+
+    auto format = context->format();
+    bool hasCore = format.majorVersion() > 4 || (format.majorVersion() == 4 && format.minorVersion() >= 1);
+    if (!hasCore && !context->hasExtension("GL_ARB_get_program_binary"))
+        return false;
+
+    funcs.getProgramBinary = (GetProgramBinaryFunc) context->getProcAddress("glGetProgramBinary");
+    funcs.programBinary = (ProgramBinaryFunc) context->getProcAddress("glProgramBinary");
+    funcs.programParameteri = (ProgramParameteriFunc) context->getProcAddress("glProgramParameteri");
+    if (!funcs.getProgramBinary || !funcs.programBinary || !funcs.programParameteri)
+        return false;
+
+    GLint formatCount = 0;
+    context->functions()->glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    return formatCount > 0;
+}
+
+static QString getCacheFilePath(const QByteArray& key)
+{
+    return ProgramCache::getCacheDirectory() + "/" + QString::fromLatin1(key) + ".bin";
+}
+
+QByteArray ProgramCache::createKey(const QString& vertexSource, const QString& fragmentSource)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(programCacheVersion));
+
+    // a binary is only valid for the driver that built it
+    auto context = QOpenGLContext::currentContext();
+    if (context != nullptr) {
+        auto gl = context->functions();
+        hash.addData((const char*) gl->glGetString(GL_VENDOR));
+        hash.addData((const char*) gl->glGetString(GL_RENDERER));
+        hash.addData((const char*) gl->glGetString(GL_VERSION));
+    }
+
+    // separators keep moving text between the two stages from giving the same key
+    hash.addData("\nvertex\n");
+    hash.addData(vertexSource.toUtf8());
+    hash.addData("\nfragment\n");
+    hash.addData(fragmentSource.toUtf8());
+
+    return hash.result().toHex();
+}
+
+bool ProgramCache::load(QOpenGLShaderProgram* program, const QByteArray& key)
+{
+    ProgramBinaryFunctions funcs;
+    if (!resolveFunctions(funcs)) {
+        missCount.ref();
+        return false;
+    }
+
+    QFile file(getCacheFilePath(key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        missCount.ref();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    quint32 version, binaryFormat;
+    QByteArray binary;
+    stream >> version >> binaryFormat >> binary;
+    file.close();
+
+    if (stream.status() != QDataStream::Ok || version != programCacheVersion || binary.isEmpty()) {
+        missCount.ref();
+        return false;
+    }
+
+    auto programId = program->programId();
+    funcs.programParameteri(programId, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    funcs.programBinary(programId, binaryFormat, binary.constData(), binary.size());
+
+    // with no shaders attached link() only picks up the link status of the binary
+    // the driver can reject a binary it made itself, e.g. after an update
+    if (!program->link()) {
+        QFile::remove(getCacheFilePath(key));
+        missCount.ref();
+        return false;
+    }
+
+    hitCount.ref();
+    return true;
+}
+
+bool ProgramCache::link(QOpenGLShaderProgram* program, const QByteArray& key)
+{
+    ProgramBinaryFunctions funcs;
+    bool canStore = resolveFunctions(funcs);
+
+    // some drivers only keep the binary around when asked to before linking
+    if (canStore)
+        funcs.programParameteri(program->programId(), GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
+    if (!program->link()) {
+        irisLog("shader program failed to link: " + program->log());
+        return false;
+    }
+
+    if (!canStore)
+        return true;
+
+    auto programId = program->programId();
+    GLint length = 0;
+    QOpenGLContext::currentContext()->functions()->glGetProgramiv(programId, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0)
+        return true;
+
+    QByteArray binary(length, Qt::Uninitialized);
+    GLenum binaryFormat = 0;
+    GLsizei written = 0;
+    funcs.getProgramBinary(programId, length, &written, &binaryFormat, binary.data());
+    if (written <= 0)
+        return true;
+    binary.resize(written);
+
+    auto dir = getCacheDirectory();
+    if (!QDir().mkpath(dir))
+        return true;
+
+    // written to a temporary file first so another instance never reads half a binary
+    QSaveFile file(getCacheFilePath(key));
+    if (!file.open(QIODevice::WriteOnly))
+        return true;
+
+    QDataStream stream(&file);
+    stream << programCacheVersion << (quint32) binaryFormat << binary;
+    file.commit();
+
+    return true;
+}
+
+int ProgramCache::getHitCount()
+{
+    return hitCount.load();
+}
+
+int ProgramCache::getMissCount()
+{
+    return missCount.load();
+}
+
+void ProgramCache::setCacheDirectory(const QString& path)
+{
+    QMutexLocker locker(&cacheDirectoryMutex);
+    cacheDirectory = path;
+}
+
+QString ProgramCache::getCacheDirectory()
+{
+    QMutexLocker locker(&cacheDirectoryMutex);
+    if (cacheDirectory.isEmpty())
+        cacheDirectory = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/shaders";
+    return cacheDirectory;
+}
+
+}
@@ -0,0 +1,63 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <QString>
+#include <QByteArray>
+
+class QOpenGLShaderProgram;
+
+namespace iris
+{
+
+/**
+ * Keeps linked program binaries on disk so later runs can skip compiling shaders
+ * Binaries are keyed by the final shader source and the driver that built them, a driver
+ * update or an edited shader just misses and gets compiled from source again
+ * Needs GL_ARB_get_program_binary, without it every load misses and nothing is written
+ */
+class ProgramCache
+{
+public:
+    /**
+     * Key for a program made from these sources on the current context's driver
+     */
+    static QByteArray createKey(const QString& vertexSource, const QString& fragmentSource);
+
+    /**
+     * Loads the cached binary for key into program and links it
+     * Returns false if there's no usable binary, the caller should then attach
+     * its shaders and call link()
+     */
+    static bool load(QOpenGLShaderProgram* program, const QByteArray& key);
+
+    /**
+     * Links program from its attached shaders and stores the result under key
+     * Returns whether the program linked
+     */
+    static bool link(QOpenGLShaderProgram* program, const QByteArray& key);
+
+    static int getHitCount();
+    static int getMissCount();
+
+    /**
+     * Folder the binaries are written to, defaults to a shaders folder in the
+     * application's cache location
+     */
+    static void setCacheDirectory(const QString& path);
+    static QString getCacheDirectory();
+};
+
+}
+
+#endif // PROGRAMCACHE_H
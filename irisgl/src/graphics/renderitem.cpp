@@ -15,7 +15,10 @@ void RenderItem::reset()
     renderStates = RenderStates();
 
     cullable = false;
+    culled = false;
+    lightCount = 0;
     renderLayer = (int)RenderLayer::Opaque;
+    sortKey = 0;
 }
 
 }
@@ -19,6 +19,10 @@ For more information see the LICENSE file
 
 class QOpenGLShaderProgram;
 
+// lights an item can be given by RenderList::assignLights
+// must match MAX_LIGHTS in shaders that take per-light uniforms
+#define RENDER_ITEM_MAX_LIGHTS 8
+
 namespace iris
 {
 
@@ -47,16 +51,28 @@ struct RenderItem
     RenderStates renderStates;
 
     bool cullable = false;
+    // set by RenderList::cull when the item is outside of the frustum
+    bool culled = false;
     bool physicsObject = false;
     BoundingSphere boundingSphere;
 
+    // indices into the scene's light list of the lights reaching the item, most relevant first
+    // set by RenderList::assignLights
+    int lights[RENDER_ITEM_MAX_LIGHTS];
+    int lightCount = 0;
+
     //sort order for render layer
     //used if no material is specified
     int renderLayer;
 
+    // key used to order items for submission
+    // generated by RenderList::sort
+    quint64 sortKey;
+
     RenderItem() {
         type = RenderItemType::None;
         worldMatrix.setToIdentity();
+        sortKey = 0;
     }
 
     void reset();
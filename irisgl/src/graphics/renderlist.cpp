@@ -1,5 +1,13 @@
 #include "renderlist.h"
 #include "renderitem.h"
+#include "shader.h"
+#include "mesh.h"
+#include "../geometry/frustum.h"
+#include "../scenegraph/lightnode.h"
+#include <QOpenGLShaderProgram>
+#include <QtMath>
+#include <cstring>
+#include <algorithm>
 
 namespace iris {
 
@@ -16,6 +24,7 @@ RenderList::RenderList()
 void RenderList::add(RenderItem *item)
 {
     renderList.append(item);
+    instanceCounts.clear();
 }
 
 RenderItem *RenderList::submitMesh(MeshPtr mesh, MaterialPtr mat, QMatrix4x4 worldMatrix)
@@ -36,6 +45,7 @@ RenderItem *RenderList::submitMesh(MeshPtr mesh, MaterialPtr mat, QMatrix4x4 wor
 	item->renderStates = mat->renderStates;
 
     renderList.append(item);
+    instanceCounts.clear();
 	return item;
 }
 
@@ -56,23 +66,300 @@ RenderItem *RenderList::submitMesh(MeshPtr mesh, QOpenGLShaderProgram *shader, Q
     item->renderLayer = renderLayer;
 
     renderList.append(item);
+    instanceCounts.clear();
 	return item;
 }
 
 void RenderList::clear()
 {
     renderList.clear();
+    instanceCounts.clear();
 
     for(auto item : used)
         pool.append(item);
     used.clear();
 }
 
-void RenderList::sort()
+int RenderList::cull(const Frustum& frustum)
 {
-    qSort(renderList.begin(), renderList.end(), [](const RenderItem* a, const RenderItem* b) {
-        return a->renderLayer < b->renderLayer;
+    cullableItems.clear();
+    sphereX.clear();
+    sphereY.clear();
+    sphereZ.clear();
+    sphereRadius.clear();
+
+    for (auto item : renderList) {
+        item->culled = false;
+        if (!item->cullable)
+            continue;
+
+        auto& sphere = item->boundingSphere;
+        cullableItems.append(item);
+        sphereX.append(sphere.pos.x());
+        sphereY.append(sphere.pos.y());
+        sphereZ.append(sphere.pos.z());
+        sphereRadius.append(sphere.radius);
+    }
+
+    const int count = cullableItems.size();
+    sphereVisible.resize(count);
+    int visible = frustum.cullSpheres(sphereX.constData(), sphereY.constData(), sphereZ.constData(),
+                                      sphereRadius.constData(), count, sphereVisible.data());
+
+    for (int i = 0; i < count; i++)
+        cullableItems[i]->culled = sphereVisible[i] == 0;
+
+    return count - visible;
+}
+
+int RenderList::assignLights(const QList<LightNodePtr>& lights)
+{
+    lightIndices.clear();
+    lightX.clear();
+    lightY.clear();
+    lightZ.clear();
+    lightRange.clear();
+    lightIntensity.clear();
+    coneX.clear();
+    coneY.clear();
+    coneZ.clear();
+    coneSin.clear();
+    coneCos.clear();
+
+    // directional lights reach everything so they're given to every item first
+    int directional[RENDER_ITEM_MAX_LIGHTS];
+    int directionalCount = 0;
+    // for items that can't be tested
+    int firstVisible[RENDER_ITEM_MAX_LIGHTS];
+    int firstVisibleCount = 0;
+
+    for (int i = 0; i < lights.size(); i++) {
+        auto& light = lights[i];
+        if (!light->isVisible())
+            continue;
+
+        if (firstVisibleCount < RENDER_ITEM_MAX_LIGHTS)
+            firstVisible[firstVisibleCount++] = i;
+
+        if (light->lightType == LightType::Directional) {
+            if (directionalCount < RENDER_ITEM_MAX_LIGHTS)
+                directional[directionalCount++] = i;
+            continue;
+        }
+
+        if (light->distance <= 0.0f)
+            continue;
+
+        auto pos = light->globalTransform.column(3).toVector3D();
+        lightIndices.append(i);
+        lightX.append(pos.x());
+        lightY.append(pos.y());
+        lightZ.append(pos.z());
+        lightRange.append(light->distance);
+        lightIntensity.append(light->intensity);
+
+        // wide cones are tested as spheres
+        auto dir = light->getLightDir();
+        float halfAngle = qDegreesToRadians(light->spotCutOff);
+        bool cone = light->lightType == LightType::Spot && halfAngle < M_PI_2;
+        coneX.append(dir.x());
+        coneY.append(dir.y());
+        coneZ.append(dir.z());
+        coneSin.append(cone ? qSin(halfAngle) : 0.0f);
+        coneCos.append(cone ? qCos(halfAngle) : -1.0f);
+    }
+
+    const int count = lightIndices.size();
+    int assigned = 0;
+
+    for (auto item : renderList) {
+        item->lightCount = 0;
+        if (!item->renderStates.receiveLighting || item->culled)
+            continue;
+
+        if (!item->cullable) {
+            memcpy(item->lights, firstVisible, firstVisibleCount * sizeof(int));
+            item->lightCount = firstVisibleCount;
+            assigned += firstVisibleCount;
+            continue;
+        }
+
+        memcpy(item->lights, directional, directionalCount * sizeof(int));
+        item->lightCount = directionalCount;
+
+        // the most relevant lights are kept in descending order of score
+        float scores[RENDER_ITEM_MAX_LIGHTS];
+        int scored = 0;
+        const int slots = RENDER_ITEM_MAX_LIGHTS - directionalCount;
+
+        const float cx = item->boundingSphere.pos.x();
+        const float cy = item->boundingSphere.pos.y();
+        const float cz = item->boundingSphere.pos.z();
+        const float radius = item->boundingSphere.radius;
+
+        for (int i = 0; i < count && slots > 0; i++) {
+            float vx = cx - lightX[i];
+            float vy = cy - lightY[i];
+            float vz = cz - lightZ[i];
+            float distSqrd = vx * vx + vy * vy + vz * vz;
+            float reach = lightRange[i] + radius;
+            if (distSqrd > reach * reach)
+                continue;
+
+            // sphere against cone, the sphere is outside if it's entirely behind the
+            // apex or further from the cone's surface than its radius
+            if (coneCos[i] > -1.0f) {
+                float along = vx * coneX[i] + vy * coneY[i] + vz * coneZ[i];
+                float across = qSqrt(qMax(distSqrd - along * along, 0.0f));
+                if (along < -radius || coneCos[i] * across - along * coneSin[i] > radius)
+                    continue;
+            }
+
+            // brightness at the sphere's closest point with the shader's falloff
+            float dist = qMax(qSqrt(distSqrd) - radius, 0.0f);
+            float falloff = 1.0f - qMin(dist / lightRange[i], 1.0f);
+            float score = lightIntensity[i] * falloff * falloff;
+
+            if (scored == slots && score <= scores[scored - 1])
+                continue;
+
+            int slot = scored < slots ? scored++ : scored - 1;
+            while (slot > 0 && scores[slot - 1] < score) {
+                scores[slot] = scores[slot - 1];
+                item->lights[directionalCount + slot] = item->lights[directionalCount + slot - 1];
+                slot--;
+            }
+            scores[slot] = score;
+            item->lights[directionalCount + slot] = lightIndices[i];
+        }
+
+        item->lightCount += scored;
+        assigned += item->lightCount;
+    }
+
+    return assigned;
+}
+
+void RenderList::sort(const QVector3D& eyePos)
+{
+    for (auto item : renderList)
+        item->sortKey = generateSortKey(item, eyePos);
+
+    std::sort(renderList.begin(), renderList.end(), [](const RenderItem* a, const RenderItem* b) {
+        return a->sortKey < b->sortKey;
     });
+    instanceCounts.clear();
+}
+
+void RenderList::sortByMesh()
+{
+    std::sort(renderList.begin(), renderList.end(), [](const RenderItem* a, const RenderItem* b) {
+        bool skinnedA = !!a->mesh && a->mesh->hasSkeleton();
+        bool skinnedB = !!b->mesh && b->mesh->hasSkeleton();
+        if (skinnedA != skinnedB)
+            return skinnedB;
+        return a->mesh.data() < b->mesh.data();
+    });
+    instanceCounts.clear();
+}
+
+static bool canBeInstanced(RenderItem* item, bool matchMaterials)
+{
+    if (item->type != RenderItemType::Mesh || !item->mesh || item->mesh->hasSkeleton())
+        return false;
+
+    if (!matchMaterials)
+        return true;
+
+    // transparent items have to be drawn in depth order
+    return !!item->material &&
+           item->renderLayer < (int)RenderLayer::Transparent &&
+           !!item->material->shader->getInstancedShader();
+}
+
+static bool canShareInstance(RenderItem* a, RenderItem* b, bool matchMaterials)
+{
+    if (a->type != b->type || a->mesh != b->mesh)
+        return false;
+
+    if (!matchMaterials)
+        return true;
+
+    // everything else comes from the material, the node can only
+    // change the culling mode
+    auto& statesA = a->renderStates;
+    auto& statesB = b->renderStates;
+    return a->material == b->material &&
+           a->renderLayer == b->renderLayer &&
+           statesA.rasterState.cullMode == statesB.rasterState.cullMode &&
+           statesA.rasterState.fillMode == statesB.rasterState.fillMode &&
+           statesA.rasterState.depthBias == statesB.rasterState.depthBias &&
+           statesA.rasterState.depthScaleBias == statesB.rasterState.depthScaleBias &&
+           statesA.fogEnabled == statesB.fogEnabled &&
+           statesA.receiveLighting == statesB.receiveLighting;
+}
+
+void RenderList::batchInstances(bool matchMaterials)
+{
+    instanceCounts.fill(1, renderList.size());
+
+    int i = 0;
+    while (i < renderList.size()) {
+        auto item = renderList[i];
+        int count = 1;
+
+        if (canBeInstanced(item, matchMaterials)) {
+            while (i + count < renderList.size() &&
+                   canShareInstance(item, renderList[i + count], matchMaterials))
+                count++;
+        }
+
+        instanceCounts[i] = count;
+        for (int j = 1; j < count; j++)
+            instanceCounts[i + j] = 0;
+
+        i += count;
+    }
+}
+
+// sort key layout, from the most significant bit:
+// opaque:      | layer:16 | shader:14 | material:12 | mesh:10 | depth:12 |
+// transparent: | layer:16 | inverted depth:32 | shader:16 |
+// ids are truncated to fit, a collision only costs an extra state change
+quint64 RenderList::generateSortKey(RenderItem* item, const QVector3D& eyePos)
+{
+    quint64 layer = (quint64)qBound(0, item->renderLayer, 0xFFFF);
+
+    quint64 shaderId = 0;
+    quint64 materialId = 0;
+    quint64 meshId = 0;
+    if (!!item->material) {
+        materialId = (quint64)item->material->getMaterialId();
+        if (!!item->material->shader)
+            shaderId = (quint64)item->material->shader->getShaderId();
+    } else if (item->shaderProgram) {
+        shaderId = (quint64)item->shaderProgram->programId();
+    }
+    if (!!item->mesh)
+        meshId = (quint64)item->mesh->getMeshId();
+
+    // the bit pattern of a positive float increases with its value
+    // so it can be compared as an unsigned integer
+    float distSqrd = (item->worldMatrix.column(3).toVector3D() - eyePos).lengthSquared();
+    quint32 depth;
+    memcpy(&depth, &distSqrd, sizeof(depth));
+
+    if (item->renderLayer >= (int)RenderLayer::Transparent) {
+        return (layer << 48) |
+               ((quint64)(~depth) << 16) |
+               (shaderId & 0xFFFF);
+    }
+
+    return (layer << 48) |
+           ((shaderId & 0x3FFF) << 34) |
+           ((materialId & 0xFFF) << 22) |
+           ((meshId & 0x3FF) << 12) |
+           ((depth >> 19) & 0xFFF);
 }
 
 RenderList::~RenderList()
@@ -2,11 +2,13 @@
 #define RENDERLIST_H
 
 #include <QVector>
+#include <QVector3D>
 #include "material.h"
 
 namespace iris {
 
 class RenderItem;
+class Frustum;
 
 class RenderList
 {
@@ -14,6 +16,21 @@ class RenderList
     QVector<RenderItem*> used;
 
     QVector<RenderItem*> renderList;
+
+    // number of items each item is batched with, parallel to renderList
+    // 0 means the item is drawn as part of an earlier batch
+    QVector<int> instanceCounts;
+
+    // bounding spheres of the cullable items packed for RenderList::cull
+    QVector<RenderItem*> cullableItems;
+    QVector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    QVector<quint8> sphereVisible;
+
+    // point and spot lights packed for RenderList::assignLights
+    QVector<int> lightIndices;
+    QVector<float> lightX, lightY, lightZ, lightRange, lightIntensity;
+    // spot cone axis and the sine and cosine of its half angle, the cosine is -1 for point lights
+    QVector<float> coneX, coneY, coneZ, coneSin, coneCos;
 public:
     RenderList();
 //    QVector<RenderItem*>& getItems();
@@ -30,7 +47,58 @@ public:
 
     void clear();
 
-    void sort();
+    /**
+     * Tests the bounding spheres of every cullable item against frustum in one batch
+     * Items outside of it are marked as culled, every other item is cleared
+     * The flags are shared by every list holding the item so they should be used before
+     * another list is culled
+     * Returns the number of items culled
+     */
+    int cull(const Frustum& frustum);
+
+    /**
+     * Picks the lights reaching each item that receives lighting, up to RENDER_ITEM_MAX_LIGHTS
+     * Directional lights come first, then point and spot lights whose range overlaps the
+     * item's bounding sphere ordered by how bright they are at its closest point
+     * Hidden lights and culled items are skipped. Items without bounds get the first visible lights
+     * Returns the number of lights assigned across all items
+     */
+    int assignLights(const QList<LightNodePtr>& lights);
+
+    /**
+     * Generates a sort key for every item then orders the list by it.
+     * Opaque items are grouped by shader, material and mesh and drawn front-to-back.
+     * Transparent items are drawn back-to-front.
+     * @param eyePos camera position used for depth sorting
+     */
+    void sort(const QVector3D& eyePos);
+
+    static quint64 generateSortKey(RenderItem* item, const QVector3D& eyePos);
+
+    /**
+     * Orders the list by mesh only, for passes that use a single shader
+     * Skinned meshes come after static ones since they need a different shader
+     */
+    void sortByMesh();
+
+    /**
+     * Groups neighbouring opaque items that share a mesh and material so they
+     * can be drawn with one instanced draw call. Call after sorting.
+     * Skinned meshes and shaders that dont support instancing aren't batched.
+     * @param matchMaterials if false only the mesh has to match, for shadow passes
+     */
+    void batchInstances(bool matchMaterials = true);
+
+    /**
+     * Returns how many items starting at index are drawn together
+     * Returns 1 if batchInstances wasnt called since the last change
+     */
+    int getInstanceCount(int index)
+    {
+        if (index < instanceCounts.size())
+            return instanceCounts[index];
+        return 1;
+    }
 
     ~RenderList();
 };
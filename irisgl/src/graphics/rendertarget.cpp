@@ -34,7 +34,8 @@ QImage RenderTarget::toImage()
 
 RenderTarget::RenderTarget(int width, int height):
     width(width),
-    height(height)
+    height(height),
+    depthLayer(0)
 {
     gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_2_Core>();
     gl->glGenFramebuffers(1, &fboId);
@@ -131,7 +132,7 @@ void RenderTarget::addTexture(Texture2DPtr tex)
     textures.append(tex);
 }
 
-void RenderTarget::setDepthTexture(Texture2DPtr depthTex)
+void RenderTarget::setDepthTexture(Texture2DPtr depthTex, int layer)
 {
     Q_ASSERT_X(width==depthTex->getWidth() && height==depthTex->getHeight(),
                "RenderTarget",
@@ -139,6 +140,7 @@ void RenderTarget::setDepthTexture(Texture2DPtr depthTex)
 
     clearRenderBuffer();
     depthTexture = depthTex;
+    depthLayer = layer;
 }
 
 void RenderTarget::clearTextures()
@@ -172,8 +174,12 @@ void RenderTarget::bind()
         i++;
     }
 
-    if (!!depthTexture)
-        gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture->getTextureId(), 0);
+    if (!!depthTexture) {
+        if (depthTexture->texture->target() == QOpenGLTexture::Target2DArray)
+            gl->glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depthTexture->getTextureId(), 0, depthLayer);
+        else
+            gl->glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture->getTextureId(), 0);
+    }
 
     //checkStatus();
 }
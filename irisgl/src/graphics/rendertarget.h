@@ -24,6 +24,8 @@ class RenderTarget
 
     QList<Texture2DPtr> textures;
     Texture2DPtr depthTexture;
+    // the layer rendered to if the depth texture is an array
+    int depthLayer;
 
     RenderTarget(int width, int height);
     void checkStatus();
@@ -34,7 +36,7 @@ public:
     void resize(int width, int height, bool resizeTextures);
 
     void addTexture(Texture2DPtr tex);
-    void setDepthTexture(Texture2DPtr depthTex);
+    void setDepthTexture(Texture2DPtr depthTex, int layer = 0);
 
     void clearTextures();
     void clearDepthTexture();
@@ -14,6 +14,8 @@ For more information see the LICENSE file
 #include <QOpenGLFunctions_3_2_Core>
 #include <QOpenGLShaderProgram>
 #include <QFile>
+#include <QMutex>
+#include <QMutexLocker>
 #include "texture.h"
 #include <QOpenGLTexture>
 #include "mesh.h"
@@ -45,12 +47,18 @@ void Shader::setVertexShader(QString vertexShader)
 {
 	this->vertexShader = vertexShader;
 	_setDirty();
+
+	instancedShader.clear();
+	instancedShaderCreated = false;
 }
 
 void Shader::setFragmentShader(QString fragmentShader)
 {
 	this->fragmentShader = fragmentShader;
 	_setDirty();
+
+	instancedShader.clear();
+	instancedShaderCreated = false;
 }
 
 ShaderPtr Shader::load(QString vertexShaderFile,QString fragmentShaderFile)
@@ -78,6 +86,7 @@ Shader::Shader()
 {
 	isDirty = true;
 	program = nullptr;
+	instancedShaderCreated = false;
 
     shaderId = generateNodeId();
 }
@@ -95,11 +104,54 @@ ShaderValue* Shader::getUniform(QString name)
     return nullptr;
 }
 
+ShaderPtr Shader::getInstancedShader()
+{
+	if (!instancedShaderCreated) {
+		instancedShaderCreated = true;
+
+		if (vertexShader.contains("#ifdef INSTANCED")) {
+			QStringList defines;
+			defines << "INSTANCED";
+			instancedShader = create(GraphicsHelper::insertShaderDefines(vertexShader, defines),
+									 GraphicsHelper::insertShaderDefines(fragmentShader, defines));
+		}
+	}
+
+	return instancedShader;
+}
+
 long Shader::generateNodeId()
 {
     return nextId++;
 }
 
-long Shader::nextId = 0;
+static QMutex uniformHandleMutex;
+
+int Shader::getUniformHandle(const std::string& name)
+{
+    QMutexLocker locker(&uniformHandleMutex);
+    for (size_t i = 0; i < uniformHandleNames.size(); i++) {
+        if (uniformHandleNames[i] == name)
+            return (int)i;
+    }
+
+    uniformHandleNames.push_back(name);
+    return (int)uniformHandleNames.size() - 1;
+}
+
+std::string Shader::getUniformHandleName(int handle)
+{
+    QMutexLocker locker(&uniformHandleMutex);
+    return uniformHandleNames[handle];
+}
+
+std::vector<std::string> Shader::getUniformHandleNames()
+{
+    QMutexLocker locker(&uniformHandleMutex);
+    return uniformHandleNames;
+}
+
+std::atomic<long> Shader::nextId(0);
+std::vector<std::string> Shader::uniformHandleNames;
 
 }
@@ -14,7 +14,11 @@ For more information see the LICENSE file
 
 #include "../irisglfwd.h"
 #include <QVariant>
+#include <QVector>
 #include <qopengl.h>
+#include <string>
+#include <vector>
+#include <atomic>
 
 class QOpenGLShaderProgram;
 class QOpenGLFunctions_3_2_Core;
@@ -80,6 +84,30 @@ public:
 
 	void _setDirty();
 
+    long getShaderId()
+    {
+        return shaderId;
+    }
+
+    /**
+     * Returns a handle for the uniform name that can be passed to
+     * GraphicsDevice::setShaderUniform instead of the name itself.
+     * Handles are global so they're best created once and stored.
+     * @param name name of the uniform in the shader
+     */
+    static int getUniformHandle(const std::string& name);
+
+    bool hasUniformBlock(const QString& name)
+    {
+        return uniformBlocks.contains(name);
+    }
+
+    /**
+     * Returns a copy of this shader compiled with INSTANCED defined.
+     * Returns a null pointer if the vertex shader doesnt include instancing.glsl
+     */
+    ShaderPtr getInstancedShader();
+
 private:
 	QOpenGLShaderProgram * program;
 	long shaderId;
@@ -112,8 +140,19 @@ private:
 
 	void compileShader();
 
+    ShaderPtr instancedShader;
+    bool instancedShaderCreated;
+
     static long generateNodeId();
-    static long nextId;
+    static std::atomic<long> nextId;
+
+    // handles are made from the render threads too, these lock the registry
+    static std::string getUniformHandleName(int handle);
+    static std::vector<std::string> getUniformHandleNames();
+
+private:
+    // names of all the handles given by getUniformHandle, guarded by uniformHandleMutex
+    static std::vector<std::string> uniformHandleNames;
 
 protected:
     QMap<QString,ShaderValue*> attribs;
@@ -122,6 +161,13 @@ protected:
 
     QList<ShaderValue*> updatedUniforms;
 
+    // uniform locations indexed by handle
+    // -2 means the location hasnt been looked up yet
+    QVector<int> uniformLocations;
+
+    // active uniform blocks and their binding points
+    QMap<QString, int> uniformBlocks;
+
 	QString vertexShader, fragmentShader;
 };
 
@@ -9,8 +9,11 @@ ShadowMap::ShadowMap()
 {
     shadowType = ShadowMapType::Soft;
     resolution = 1024*2;
-    shadowTexture = Texture2D::createShadowDepth(resolution, resolution);
+    shadowTexture = Texture2D::createShadowDepthArray(resolution, resolution, 1);
     bias = 0.01f;
+    cascadeCount = 3;
+    shadowDistance = 256.0f;
+    invalidate();
     /*
     auto gl = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_3_2_Core>();
     gl->glGenTextures(1, &shadowTexId);
@@ -29,8 +32,32 @@ ShadowMap::ShadowMap()
 
 void ShadowMap::setResolution(int size)
 {
+    if (resolution == size)
+        return;
+
     resolution = size;
-    shadowTexture->resize(size, size);
+    shadowTexture = Texture2D::createShadowDepthArray(size, size, shadowTexture->getLayers());
+    invalidate();
+}
+
+void ShadowMap::setCascadeCount(int count)
+{
+    cascadeCount = qBound(1, count, SHADOW_MAX_CASCADES);
+}
+
+void ShadowMap::setLayerCount(int layers)
+{
+    if (shadowTexture->getLayers() == layers)
+        return;
+
+    shadowTexture = Texture2D::createShadowDepthArray(resolution, resolution, layers);
+    invalidate();
+}
+
+void ShadowMap::invalidate()
+{
+    for (int i = 0; i < SHADOW_MAX_CASCADES; i++)
+        layerCached[i] = false;
 }
 
 
@@ -16,19 +16,54 @@ enum class ShadowMapType : int
     VerySoft = 3
 };
 
+// has to match MAX_CASCADES in scene_data.glsl
+#define SHADOW_MAX_CASCADES 4
+
 class ShadowMap
 {
 public:
     ShadowMapType shadowType;
+    // a depth texture array with a layer per cascade
+    // spot lights only use the first layer
     Texture2DPtr shadowTexture;
     //GLuint shadowTexId;
+    // the first cascade's matrix
     QMatrix4x4 shadowMatrix;
     int resolution;
     float bias;
 
+    /**
+     * Directional lights split the camera's view into cascades, each rendered
+     * to its own layer so nearby shadows get more texels than distant ones
+     */
+    int cascadeCount;
+    QMatrix4x4 cascadeMatrices[SHADOW_MAX_CASCADES];
+    // cascades only cover this much of the camera's view
+    float shadowDistance;
+
+    /**
+     * The matrix each layer was last rendered with
+     * A layer is reused as long as its matrix stays the same and none of
+     * the casters inside it changed
+     */
+    QMatrix4x4 renderedMatrices[SHADOW_MAX_CASCADES];
+    bool layerCached[SHADOW_MAX_CASCADES];
+
     ShadowMap();
 
     void setResolution(int size);
+
+    void setCascadeCount(int count);
+
+    /**
+     * Reallocates the texture if it doesnt have the given number of layers
+     */
+    void setLayerCount(int layers);
+
+    /**
+     * Forces every layer to be redrawn the next time the light's shadows are rendered
+     */
+    void invalidate();
 };
 
 
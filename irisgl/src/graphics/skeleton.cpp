@@ -76,23 +76,4 @@ void Skeleton::applyAnimation(iris::SkeletalAnimationPtr anim, float time)
     }
 }
 
-// https://github.com/acgessler/open3mod/blob/master/open3mod/SceneAnimator.cs#L338
-void Skeleton::applyAnimation(QMatrix4x4 inverseMeshMatrix, QMap<QString, QMatrix4x4> skeletonSpaceMatrices)
-{
-    for (auto i = 0; i < bones.size(); i++) {
-        auto bone = bones[i];
-        if (skeletonSpaceMatrices.contains(bone->name)) {
-            //bones->transformMatrix.setToIdentity();
-            //bones->localMatrix.setToIdentity();
-
-            // https://github.com/acgessler/open3mod/blob/master/open3mod/SceneAnimator.cs#L356
-            bone->skinMatrix = inverseMeshMatrix * skeletonSpaceMatrices[bone->name] * bone->inversePoseMatrix;
-        }
-        else {
-            bone->skinMatrix.setToIdentity();
-        }
-        boneTransforms[i] = bone->skinMatrix;
-    }
-}
-
 }
@@ -85,8 +85,6 @@ public:
 
     void applyAnimation(SkeletalAnimationPtr anim, float time);
 
-    void applyAnimation(QMatrix4x4 inverseMeshMatrix, QMap<QString, QMatrix4x4> skeletonSpaceMatrices);
-
     static SkeletonPtr create()
     {
         return SkeletonPtr(new Skeleton());
@@ -169,6 +169,25 @@ Texture2DPtr Texture2D::createShadowDepth(int width, int height)
     return Texture2DPtr(new Texture2D(texture));
 }
 
+Texture2DPtr Texture2D::createShadowDepthArray(int width, int height, int layers)
+{
+    auto texture = new QOpenGLTexture(QOpenGLTexture::Target2DArray);
+    texture->setSize(width, height);
+    texture->setLayers(layers);
+    texture->setFormat(QOpenGLTexture::DepthFormat);
+    texture->setMinMagFilters(QOpenGLTexture::Linear, QOpenGLTexture::Linear);
+    texture->setWrapMode(QOpenGLTexture::ClampToEdge);
+
+    texture->setComparisonMode(QOpenGLTexture::CompareNone);
+    texture->setComparisonFunction(QOpenGLTexture::CompareLessEqual);
+
+    if (!texture->create())
+        qDebug() << "Error creating texture";
+    texture->allocateStorage(QOpenGLTexture::Depth,QOpenGLTexture::Float32);
+
+    return Texture2DPtr(new Texture2D(texture));
+}
+
 void Texture2D::resize(int width, int height)
 {
     if(texture->width() == width && texture->height() == height)
@@ -179,6 +198,7 @@ void Texture2D::resize(int width, int height)
     auto magFilter = texture->magnificationFilter();
     auto wrapModeS = texture->wrapMode(QOpenGLTexture::DirectionS);
     auto wrapModeT = texture->wrapMode(QOpenGLTexture::DirectionT);
+    auto layers = texture->layers();
 
     //return;
     texture->destroy();
@@ -187,6 +207,7 @@ void Texture2D::resize(int width, int height)
     texture->setWrapMode(QOpenGLTexture::DirectionS, wrapModeS);
     texture->setWrapMode(QOpenGLTexture::DirectionT, wrapModeT);
     texture->setSize(width, height);
+    texture->setLayers(layers);
     texture->create();
     texture->allocateStorage();
 }
@@ -207,6 +228,11 @@ int Texture2D::getHeight()
     return texture->height();
 }
 
+int Texture2D::getLayers()
+{
+    return texture->layers();
+}
+
 void Texture2D::setFilters(QOpenGLTexture::Filter minFilter, QOpenGLTexture::Filter magFilter)
 {
     texture->bind();
@@ -63,6 +63,12 @@ public:
     static Texture2DPtr create(int width, int height,QOpenGLTexture::TextureFormat texFormat = QOpenGLTexture::RGBAFormat);
     static Texture2DPtr createDepth(int width, int height);
     static Texture2DPtr createShadowDepth(int width, int height);
+
+    /**
+     * Creates a depth texture array, each layer can be rendered to separately
+     * Used for cascaded shadow maps
+     */
+    static Texture2DPtr createShadowDepthArray(int width, int height, int layers);
 //    {
 //        return create(width, height, QOpenGLTexture::DepthFormat);
 //    }
@@ -83,6 +89,9 @@ public:
     int getWidth();
     int getHeight();
 
+    // 1 unless the texture is an array
+    int getLayers();
+
     void setFilters(QOpenGLTexture::Filter minFilter, QOpenGLTexture::Filter magFilter);
     void setWrapMode(QOpenGLTexture::WrapMode wrapS, QOpenGLTexture::WrapMode wrapT);
 
@@ -0,0 +1,584 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "textureloader.h"
+#include "texture2d.h"
+#include "../core/logger.h"
+
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_3_2_Core>
+#include <QOpenGLTexture>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QDataStream>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QImage>
+#include <QFile>
+#include <QDir>
+#include <QHash>
+#include <climits>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+namespace iris
+{
+
+namespace
+{
+
+const quint32 mipCacheMagic = 0x50494d49; // IMIP
+const quint32 mipCacheVersion = 1;
+
+struct TextureRequest
+{
+    QWeakPointer<Texture2D> texture;
+    QString path;
+    bool flipY;
+    bool compress;
+    // only uploaded by the context they were requested from, the thread rendering with
+    // that context is the only one using the texture
+    QOpenGLContext* context;
+
+    // set by the worker, levels[0] is the full size image
+    bool decoded;
+    bool failed;
+    GLenum format;
+    int width;
+    int height;
+    QVector<QByteArray> levels;
+
+    // upload state, levels go up from the smallest
+    QOpenGLTexture* glTexture;
+    int nextLevel;
+};
+
+typedef QSharedPointer<TextureRequest> TextureRequestPtr;
+
+QMutex requestsMutex;
+QWaitCondition requestDecoded;
+QList<TextureRequestPtr> requests;
+QHash<QOpenGLContext*, GLuint> pixelBuffers;
+
+int uploadBudget = 4 * 1024 * 1024;
+bool compressionEnabled = false;
+
+// BC1 and BC3 block compression, the endpoints are the corners of the block's color
+// bounding box which is quick and good enough for most textures
+// https://www.khronos.org/registry/OpenGL/extensions/EXT/EXT_texture_compression_s3tc.txt
+
+quint16 packColor565(const int* rgb)
+{
+    return ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+}
+
+void unpackColor565(quint16 color, int* rgb)
+{
+    int r = (color >> 11) & 31;
+    int g = (color >> 5) & 63;
+    int b = color & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+void writeLittleEndian(uchar* out, quint64 value, int bytes)
+{
+    for (int i = 0; i < bytes; i++)
+        out[i] = (value >> (8 * i)) & 0xff;
+}
+
+// block is 16 rgba pixels, writes 8 bytes
+void compressColorBlock(const uchar* block, uchar* out)
+{
+    int minColor[3] = {255, 255, 255};
+    int maxColor[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        for (int c = 0; c < 3; c++) {
+            minColor[c] = qMin(minColor[c], (int) block[i * 4 + c]);
+            maxColor[c] = qMax(maxColor[c], (int) block[i * 4 + c]);
+        }
+    }
+
+    // pulling the corners in a little puts the palette closer to the colors in the block
+    for (int c = 0; c < 3; c++) {
+        int inset = (maxColor[c] - minColor[c]) >> 4;
+        minColor[c] += inset;
+        maxColor[c] -= inset;
+    }
+
+    // packing keeps the per channel order so color0 >= color1, which picks the four color mode
+    quint16 color0 = packColor565(maxColor);
+    quint16 color1 = packColor565(minColor);
+    quint32 indices = 0;
+
+    if (color0 != color1) {
+        int palette[4][3];
+        unpackColor565(color0, palette[0]);
+        unpackColor565(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestDist = INT_MAX;
+            for (int p = 0; p < 4; p++) {
+                int dist = 0;
+                for (int c = 0; c < 3; c++) {
+                    int d = block[i * 4 + c] - palette[p][c];
+                    dist += d * d;
+                }
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    writeLittleEndian(out, color0, 2);
+    writeLittleEndian(out + 2, color1, 2);
+    writeLittleEndian(out + 4, indices, 4);
+}
+
+// block is 16 rgba pixels, writes 8 bytes
+void compressAlphaBlock(const uchar* block, uchar* out)
+{
+    int minAlpha = 255;
+    int maxAlpha = 0;
+    for (int i = 0; i < 16; i++) {
+        minAlpha = qMin(minAlpha, (int) block[i * 4 + 3]);
+        maxAlpha = qMax(maxAlpha, (int) block[i * 4 + 3]);
+    }
+
+    quint64 indices = 0;
+    if (maxAlpha != minAlpha) {
+        // alpha0 > alpha1 gives eight interpolated values
+        int palette[8];
+        palette[0] = maxAlpha;
+        palette[1] = minAlpha;
+        for (int i = 1; i < 7; i++)
+            palette[i + 1] = ((7 - i) * maxAlpha + i * minAlpha) / 7;
+
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            int bestDist = INT_MAX;
+            for (int p = 0; p < 8; p++) {
+                int dist = qAbs(block[i * 4 + 3] - palette[p]);
+                if (dist < bestDist) {
+                    bestDist = dist;
+                    best = p;
+                }
+            }
+            indices |= (quint64) best << (3 * i);
+        }
+    }
+
+    out[0] = maxAlpha;
+    out[1] = minAlpha;
+    writeLittleEndian(out + 2, indices, 6);
+}
+
+QByteArray compressLevel(const QImage& image, bool hasAlpha)
+{
+    const int width = image.width();
+    const int height = image.height();
+    const int blockSize = hasAlpha ? 16 : 8;
+    const int blocksX = (width + 3) / 4;
+    const int blocksY = (height + 3) / 4;
+
+    QByteArray data(blocksX * blocksY * blockSize, Qt::Uninitialized);
+    auto out = (uchar*) data.data();
+    uchar block[16 * 4];
+
+    for (int by = 0; by < blocksY; by++) {
+        for (int bx = 0; bx < blocksX; bx++) {
+            // edge blocks repeat the last row and column
+            for (int y = 0; y < 4; y++) {
+                auto line = image.constScanLine(qMin(by * 4 + y, height - 1));
+                for (int x = 0; x < 4; x++)
+                    memcpy(block + (y * 4 + x) * 4, line + qMin(bx * 4 + x, width - 1) * 4, 4);
+            }
+
+            if (hasAlpha) {
+                compressAlphaBlock(block, out);
+                compressColorBlock(block, out + 8);
+            } else {
+                compressColorBlock(block, out);
+            }
+            out += blockSize;
+        }
+    }
+
+    return data;
+}
+
+bool hasTransparency(const QImage& image)
+{
+    for (int y = 0; y < image.height(); y++) {
+        auto line = image.constScanLine(y);
+        for (int x = 0; x < image.width(); x++) {
+            if (line[x * 4 + 3] != 255)
+                return true;
+        }
+    }
+    return false;
+}
+
+// mip chains are only cached for files on disk, resources are small and can't be written beside
+QString getCacheFilePath(const TextureRequest& request)
+{
+    if (request.path.startsWith(":"))
+        return QString();
+
+    QFileInfo info(request.path);
+    auto name = info.fileName();
+    if (request.flipY)
+        name += ".flipped";
+    if (request.compress)
+        name += ".bc";
+
+    return info.absolutePath() + "/.texturecache/" + name + ".mips";
+}
+
+bool readCache(const QString& cachePath, TextureRequest& request)
+{
+    QFile file(cachePath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QFileInfo source(request.path);
+    QDataStream stream(&file);
+
+    quint32 magic, version, format;
+    qint64 sourceModified, sourceSize;
+    qint32 width, height;
+    QVector<QByteArray> levels;
+    stream >> magic >> version >> sourceModified >> sourceSize >> format >> width >> height >> levels;
+
+    if (stream.status() != QDataStream::Ok || magic != mipCacheMagic || version != mipCacheVersion)
+        return false;
+
+    // the image changed since the chain was cached
+    if (sourceModified != source.lastModified().toMSecsSinceEpoch() || sourceSize != source.size())
+        return false;
+
+    if (levels.isEmpty())
+        return false;
+
+    request.format = format;
+    request.width = width;
+    request.height = height;
+    request.levels = levels;
+    return true;
+}
+
+void writeCache(const QString& cachePath, const TextureRequest& request)
+{
+    if (!QDir().mkpath(QFileInfo(cachePath).absolutePath()))
+        return;
+
+    QSaveFile file(cachePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QFileInfo source(request.path);
+    QDataStream stream(&file);
+    stream << mipCacheMagic << mipCacheVersion
+           << (qint64) source.lastModified().toMSecsSinceEpoch() << (qint64) source.size()
+           << (quint32) request.format << (qint32) request.width << (qint32) request.height
+           << request.levels;
+    file.commit();
+}
+
+bool decode(TextureRequest& request)
+{
+    auto cachePath = getCacheFilePath(request);
+    if (!cachePath.isEmpty() && readCache(cachePath, request))
+        return true;
+
+    auto image = QImage(request.path);
+    if (image.isNull())
+        return false;
+
+    image = image.convertToFormat(QImage::Format_RGBA8888);
+    if (request.flipY)
+        image = image.mirrored(false, true);
+
+    bool hasAlpha = request.compress && hasTransparency(image);
+    if (request.compress)
+        request.format = hasAlpha ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else
+        request.format = GL_RGBA8;
+
+    request.width = image.width();
+    request.height = image.height();
+    request.levels.clear();
+
+    auto level = image;
+    while (true) {
+        if (request.compress)
+            request.levels.append(compressLevel(level, hasAlpha));
+        else // rgba8888 rows are already 4 byte aligned so the image can be copied as is
+            request.levels.append(QByteArray((const char*) level.constBits(), level.width() * level.height() * 4));
+
+        if (level.width() == 1 && level.height() == 1)
+            break;
+
+        level = level.scaled(qMax(level.width() / 2, 1), qMax(level.height() / 2, 1),
+                             Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+
+    if (!cachePath.isEmpty())
+        writeCache(cachePath, request);
+
+    return true;
+}
+
+class TextureDecoder : public QRunnable
+{
+    TextureRequestPtr request;
+
+public:
+    TextureDecoder(TextureRequestPtr request) : request(request)
+    {
+        setAutoDelete(true);
+    }
+
+    void run() override
+    {
+        bool decoded = decode(*request);
+
+        QMutexLocker locker(&requestsMutex);
+        request->failed = !decoded;
+        request->decoded = true;
+        requestDecoded.wakeAll();
+    }
+};
+
+bool isCompressed(GLenum format)
+{
+    return format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+// uploads the next level of request, returns the number of bytes uploaded
+int uploadLevel(QOpenGLFunctions_3_2_Core* gl, GLuint pixelBuffer, TextureRequest& request)
+{
+    if (request.glTexture == nullptr) {
+        auto tex = new QOpenGLTexture(QOpenGLTexture::Target2D);
+        tex->setSize(request.width, request.height);
+        tex->setMipLevels(request.levels.size());
+        tex->create();
+        tex->setMinMagFilters(QOpenGLTexture::LinearMipMapLinear, QOpenGLTexture::Linear);
+        tex->setMaximumAnisotropy(4);
+
+        request.glTexture = tex;
+        request.nextLevel = request.levels.size() - 1;
+    }
+
+    const int level = request.nextLevel;
+    const auto& data = request.levels[level];
+    const int width = qMax(request.width >> level, 1);
+    const int height = qMax(request.height >> level, 1);
+
+    // the buffer is orphaned so this doesn't wait on the last upload
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixelBuffer);
+    gl->glBufferData(GL_PIXEL_UNPACK_BUFFER, data.size(), nullptr, GL_STREAM_DRAW);
+    auto mapped = gl->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, data.size(),
+                                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped != nullptr) {
+        memcpy(mapped, data.constData(), data.size());
+        gl->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    gl->glActiveTexture(GL_TEXTURE0);
+    gl->glBindTexture(GL_TEXTURE_2D, request.glTexture->textureId());
+    gl->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (isCompressed(request.format))
+        gl->glCompressedTexImage2D(GL_TEXTURE_2D, level, request.format, width, height, 0, data.size(), nullptr);
+    else
+        gl->glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+    // only the levels that are in are sampled so the texture is usable straight away
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level);
+    gl->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, request.levels.size() - 1);
+
+    gl->glBindTexture(GL_TEXTURE_2D, 0);
+    gl->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    request.nextLevel--;
+    return data.size();
+}
+
+// swaps the uploaded texture in for the placeholder after the first level is in
+void swapTexture(TextureRequest& request, Texture2DPtr texture)
+{
+    if (texture->texture == request.glTexture)
+        return;
+
+    delete texture->texture;
+    texture->texture = request.glTexture;
+}
+
+// uploads the requests that belong to the current context, budget < 0 uploads everything
+void uploadRequests(int budget)
+{
+    auto context = QOpenGLContext::currentContext();
+    if (context == nullptr)
+        return;
+
+    auto gl = context->versionFunctions<QOpenGLFunctions_3_2_Core>();
+
+    QMutexLocker locker(&requestsMutex);
+
+    GLuint pixelBuffer = pixelBuffers.value(context, 0);
+    if (pixelBuffer == 0) {
+        gl->glGenBuffers(1, &pixelBuffer);
+        pixelBuffers.insert(context, pixelBuffer);
+    }
+
+    int uploaded = 0;
+    bool uploadedAny = false;
+
+    for (int i = 0; i < requests.size(); i++) {
+        auto request = requests[i];
+        if (!request->decoded || request->context != context)
+            continue;
+
+        auto texture = request->texture.toStrongRef();
+        if (!texture || request->failed) {
+            if (request->failed)
+                irisLog("error loading image: " + request->path);
+            delete request->glTexture;
+            requests.removeAt(i--);
+            continue;
+        }
+
+        while (request->nextLevel != -1 || request->glTexture == nullptr) {
+            if (budget >= 0 && uploadedAny && uploaded >= budget)
+                return;
+
+            uploaded += uploadLevel(gl, pixelBuffer, *request);
+            uploadedAny = true;
+            swapTexture(*request, texture);
+        }
+
+        requests.removeAt(i--);
+    }
+}
+
+}
+
+Texture2DPtr TextureLoader::load(const QString& path, bool flipY, const QColor& placeholder)
+{
+    QImage image(1, 1, QImage::Format_RGBA8888);
+    image.fill(placeholder);
+
+    auto texture = Texture2D::create(image);
+    texture->source = path;
+
+    auto context = QOpenGLContext::currentContext();
+
+    auto request = TextureRequestPtr(new TextureRequest());
+    request->texture = texture;
+    request->path = path;
+    request->flipY = flipY;
+    request->compress = false;
+    request->context = context;
+    request->decoded = false;
+    request->failed = false;
+    request->glTexture = nullptr;
+    request->nextLevel = -1;
+
+    {
+        QMutexLocker locker(&requestsMutex);
+        request->compress = compressionEnabled && context->hasExtension("GL_EXT_texture_compression_s3tc");
+        requests.append(request);
+    }
+
+    QThreadPool::globalInstance()->start(new TextureDecoder(request));
+
+    return texture;
+}
+
+void TextureLoader::update()
+{
+    int budget;
+    {
+        QMutexLocker locker(&requestsMutex);
+        if (requests.isEmpty())
+            return;
+        budget = uploadBudget;
+    }
+
+    uploadRequests(budget);
+}
+
+void TextureLoader::finish()
+{
+    auto context = QOpenGLContext::currentContext();
+    if (context == nullptr)
+        return;
+
+    {
+        QMutexLocker locker(&requestsMutex);
+        while (true) {
+            bool waiting = false;
+            for (auto& request : requests) {
+                if (request->context == context && !request->decoded) {
+                    waiting = true;
+                    break;
+                }
+            }
+
+            if (!waiting)
+                break;
+
+            requestDecoded.wait(&requestsMutex);
+        }
+    }
+
+    uploadRequests(-1);
+}
+
+void TextureLoader::setUploadBudget(int bytes)
+{
+    QMutexLocker locker(&requestsMutex);
+    uploadBudget = bytes;
+}
+
+void TextureLoader::setCompressionEnabled(bool enabled)
+{
+    QMutexLocker locker(&requestsMutex);
+    compressionEnabled = enabled;
+}
+
+int TextureLoader::getPendingCount()
+{
+    QMutexLocker locker(&requestsMutex);
+    return requests.size();
+}
+
+}
@@ -0,0 +1,72 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef TEXTURELOADER_H
+#define TEXTURELOADER_H
+
+#include <QString>
+#include <QColor>
+#include "../irisglfwd.h"
+
+namespace iris
+{
+
+/**
+ * Loads textures in the background so opening a project or assigning a texture doesn't stall a frame
+ * Images are decoded and their mip chains built on the global thread pool. The levels are then
+ * uploaded from the smallest up through a pixel buffer, a few each frame, so the texture sharpens
+ * in over a couple of frames. Until its first level arrives a texture is a 1x1 placeholder
+ *
+ * Decoded mip chains of files on disk are cached in a .texturecache folder beside the image,
+ * later loads read those instead of decoding the image again
+ */
+class TextureLoader
+{
+public:
+    /**
+     * Queues path for loading and returns a texture holding a placeholder of the given color
+     * The texture's QOpenGLTexture is replaced once the real one is uploaded
+     */
+    static Texture2DPtr load(const QString& path, bool flipY = true,
+                             const QColor& placeholder = QColor(128, 128, 128));
+
+    /**
+     * Uploads loaded textures until the frame's budget is spent
+     * Has to be called with a current context, only textures requested from that
+     * context are uploaded
+     */
+    static void update();
+
+    /**
+     * Waits for every texture requested from the current context and uploads
+     * them all, for rendering that can't show placeholders such as thumbnails
+     */
+    static void finish();
+
+    /**
+     * Bytes of texture data update() uploads each frame, at least one mip level is
+     * always uploaded so large levels still get through
+     */
+    static void setUploadBudget(int bytes);
+
+    /**
+     * Stores the cached mip chains BC1/BC3 compressed, this needs GL_EXT_texture_compression_s3tc
+     * Compression is lossy so it's off by default
+     */
+    static void setCompressionEnabled(bool enabled);
+
+    // number of textures that are still decoding or uploading
+    static int getPendingCount();
+};
+
+}
+
+#endif // TEXTURELOADER_H
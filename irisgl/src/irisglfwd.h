@@ -73,6 +73,9 @@ typedef Key<float> FloatKey;
 class BoundingSphere;
 class VertexBuffer;
 class IndexBuffer;
+class UniformBuffer;
+class TextureBuffer;
+class VertexArray;
 class GraphicsDevice;
 class ContentManager;
 class SpriteBatch;
@@ -107,6 +110,9 @@ typedef QSharedPointer<Skeleton> SkeletonPtr;
 typedef QSharedPointer<SkeletalAnimation> SkeletalAnimationPtr;
 typedef QSharedPointer<VertexBuffer> VertexBufferPtr;
 typedef QSharedPointer<IndexBuffer> IndexBufferPtr;
+typedef QSharedPointer<UniformBuffer> UniformBufferPtr;
+typedef QSharedPointer<TextureBuffer> TextureBufferPtr;
+typedef QSharedPointer<VertexArray> VertexArrayPtr;
 typedef QSharedPointer<GraphicsDevice> GraphicsDevicePtr;
 typedef QSharedPointer<ContentManager> ContentManagerPtr;
 typedef QSharedPointer<SpriteBatch> SpriteBatchPtr;
@@ -12,11 +12,13 @@ For more information see the LICENSE file
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QJsonDocument>
+#include <QFileInfo>
 
 #include <QOpenGLShaderProgram>
 
 #include "custommaterial.h"
 #include "../graphics/texture2d.h"
+#include "../graphics/textureloader.h"
 #include "../graphics/shader.h"
 #include "../graphics/graphicsdevice.h"
 #include "../core/irisutils.h"
@@ -26,12 +28,15 @@ namespace iris
 
 void CustomMaterial::setTextureWithUniform(const QString &uniform, const QString &texturePath)
 {
-    auto texture = iris::Texture2D::load(texturePath);
-    if (!!texture) {
-        addTexture(uniform, texture);
-    } else {
+    if (!QFileInfo(texturePath).isFile()) {
         removeTexture(uniform);
+        return;
     }
+
+    // a flat normal stands in for normal maps while the texture loads
+    auto placeholder = uniform.contains("normal", Qt::CaseInsensitive) ? QColor(128, 128, 255)
+                                                                        : QColor(128, 128, 128);
+    addTexture(uniform, iris::TextureLoader::load(texturePath, true, placeholder));
 }
 
 void CustomMaterial::setValue(const QString &name, const QVariant &value)
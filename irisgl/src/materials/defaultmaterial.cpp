@@ -64,7 +64,7 @@ DefaultMaterial::DefaultMaterial()
 
 void DefaultMaterial::begin(GraphicsDevicePtr device,ScenePtr scene)
 {
-	device->setShader(shader);
+	device->setShader(getActiveShader());
 
     bindTextures(device);
 
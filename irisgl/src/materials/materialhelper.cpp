@@ -10,6 +10,7 @@ For more information see the LICENSE file
 *************************************************************************/
 
 #include <QDir>
+#include <QFileInfo>
 #include <QJsonObject>
 
 #include "materialhelper.h"
@@ -22,6 +23,7 @@ For more information see the LICENSE file
 #include "assimp/quaternion.h"
 #include "defaultmaterial.h"
 #include "../graphics/texture2d.h"
+#include "../graphics/textureloader.h"
 #include "../graphics/mesh.h"
 
 namespace iris
@@ -71,8 +73,9 @@ DefaultMaterialPtr MaterialHelper::createMaterial(aiMaterial* aiMat,QString asse
     if(!assetPath.isEmpty())
     {
         auto diffuseTex = getAiMaterialTexture(aiMat, aiTextureType_DIFFUSE);
-        mat->setDiffuseTexture(Texture2D::load(
-                                   QDir::cleanPath(assetPath + QDir::separator() + diffuseTex)));
+        auto diffusePath = QDir::cleanPath(assetPath + QDir::separator() + diffuseTex);
+        if (!diffuseTex.isEmpty() && QFileInfo(diffusePath).isFile())
+            mat->setDiffuseTexture(TextureLoader::load(diffusePath));
     }
 
     return mat;
@@ -46,6 +46,35 @@ public:
         scale.setZ(sz * matrix.column(2).toVector3D().length());
     }
 
+    // builds translate * rotate * scale directly instead of going
+    // through three QMatrix4x4 multiplications
+    static void composeTransform(const QVector3D& pos, const QQuaternion& rot, const QVector3D& scale, QMatrix4x4& out)
+    {
+        const float x = rot.x();
+        const float y = rot.y();
+        const float z = rot.z();
+        const float w = rot.scalar();
+
+        const float xx = 2.0f * x * x;
+        const float yy = 2.0f * y * y;
+        const float zz = 2.0f * z * z;
+        const float xy = 2.0f * x * y;
+        const float xz = 2.0f * x * z;
+        const float yz = 2.0f * y * z;
+        const float xw = 2.0f * x * w;
+        const float yw = 2.0f * y * w;
+        const float zw = 2.0f * z * w;
+
+        const float sx = scale.x();
+        const float sy = scale.y();
+        const float sz = scale.z();
+
+        out = QMatrix4x4((1.0f - yy - zz) * sx, (xy - zw) * sy,        (xz + yw) * sz,        pos.x(),
+                         (xy + zw) * sx,        (1.0f - xx - zz) * sy, (yz - xw) * sz,        pos.y(),
+                         (xz - yw) * sx,        (yz + xw) * sy,        (1.0f - xx - yy) * sz, pos.z(),
+                         0.0f,                  0.0f,                  0.0f,                  1.0f);
+    }
+
     static float lerp(float norm, float min, float max) {
         return (max - min) * norm + min;
     }
@@ -11,11 +11,13 @@ btTriangleMesh *PhysicsHelper::btTriangleMeshShapeFromMesh(iris::MeshPtr mesh)
 {
     btTriangleMesh *triMesh = new btTriangleMesh;
 
-    for (int i = 0; i < mesh->getTriMesh()->triangles.count(); ++i) {
-        auto triangle = mesh->getTriMesh()->triangles[i];
-        btVector3 btVertexA(triangle.a.x(), triangle.a.y(), triangle.a.z());
-        btVector3 btVertexB(triangle.b.x(), triangle.b.y(), triangle.b.z());
-        btVector3 btVertexC(triangle.c.x(), triangle.c.y(), triangle.c.z());
+    auto meshTris = mesh->getTriMesh();
+    for (int i = 0; i < meshTris->getTriangleCount(); ++i) {
+        QVector3D a, b, c;
+        meshTris->getTriangle(i, a, b, c);
+        btVector3 btVertexA(a.x(), a.y(), a.z());
+        btVector3 btVertexB(b.x(), b.y(), b.z());
+        btVector3 btVertexC(c.x(), c.y(), c.z());
         triMesh->addTriangle(btVertexA, btVertexB, btVertexC);
     }
 
@@ -27,14 +29,9 @@ btConvexHullShape *PhysicsHelper::btConvexHullShapeFromMesh(iris::MeshPtr mesh)
 {
     btConvexHullShape *shape = new btConvexHullShape;
 
-    for (int i = 0; i < mesh->getTriMesh()->triangles.count(); ++i) {
-        auto triangle = mesh->getTriMesh()->triangles[i];
-        btVector3 btVertexA(triangle.a.x(), triangle.a.y(), triangle.a.z());
-        btVector3 btVertexB(triangle.b.x(), triangle.b.y(), triangle.b.z());
-        btVector3 btVertexC(triangle.c.x(), triangle.c.y(), triangle.c.z());
-        shape->addPoint(btVertexA);
-        shape->addPoint(btVertexB);
-        shape->addPoint(btVertexC);
+    // vertices are shared between triangles so each point only needs to be added once
+    for (const auto &vertex : mesh->getTriMesh()->vertices) {
+        shape->addPoint(btVector3(vertex.x(), vertex.y(), vertex.z()));
     }
 
     return shape;
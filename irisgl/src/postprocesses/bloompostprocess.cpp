@@ -30,11 +30,6 @@ BloomPostProcess::BloomPostProcess()
     combineShader = GraphicsHelper::loadShader(":assets/shaders/postprocesses/default.vs",
                                         ":assets/shaders/postprocesses/bloom_combine.fs");
 
-    threshold = Texture2D::create(100, 100);
-    hBlur = Texture2D::create(100, 100);
-    vBlur = Texture2D::create(100, 100);
-    final = Texture2D::create(100, 100);
-
     bloomThreshold = 0.5f;
     bloomStrength = 0.5f;
     dirtStrength = 2.0f;
@@ -42,33 +37,28 @@ BloomPostProcess::BloomPostProcess()
 
 void BloomPostProcess::process(iris::PostProcessContext *ctx)
 {
-    //todo: only resize of the sizes are different
-    auto screenWidth = ctx->sceneTexture->texture->width();
-    auto screenHeight = ctx->sceneTexture->texture->height();
+    auto screenWidth = ctx->getWidth();
+    auto screenHeight = ctx->getHeight();
 
     int div = 16;
-    final->resize(screenWidth, screenHeight);
-    threshold->resize(screenWidth/div, screenHeight/div);
-    hBlur->resize(screenWidth/div, screenHeight/div);
-    vBlur->resize(screenWidth/div, screenHeight/div);
+    auto threshold = ctx->manager->acquireTexture(screenWidth/div, screenHeight/div);
+    auto hBlur = ctx->manager->acquireTexture(screenWidth/div, screenHeight/div);
+    auto vBlur = ctx->manager->acquireTexture(screenWidth/div, screenHeight/div);
 
     // THRESHOLD
-    ctx->sceneTexture->bind();
     thresholdShader->bind();
     thresholdShader->setUniformValue("u_sceneTexture", 0);
     thresholdShader->setUniformValue("threshold", bloomThreshold);
-    //ctx->manager->blit(ctx->sceneTexture, threshold, thresholdShader);
     ctx->manager->blit(ctx->finalTexture, threshold, thresholdShader);
 
     // HORIZONTAL BLUR
-    //threshold->bind();
     blurShader->bind();
     blurShader->setUniformValue("u_sceneTexture", 0);
     blurShader->setUniformValue("u_blurMode", BLUR_HORIZONTAL);
     ctx->manager->blit(threshold, hBlur, blurShader);
+    ctx->manager->releaseTexture(threshold);
 
     // VERTICAL BLUR
-    //threshold->bind();
     blurShader->bind();
     blurShader->setUniformValue("u_sceneTexture", 0);
     blurShader->setUniformValue("u_blurMode", BLUR_VERTICAL);
@@ -77,14 +67,12 @@ void BloomPostProcess::process(iris::PostProcessContext *ctx)
     for(int i=0;i<10;i++)
     {
         // HORIZONTAL BLUR
-        //threshold->bind();
         blurShader->bind();
         blurShader->setUniformValue("u_sceneTexture", 0);
         blurShader->setUniformValue("u_blurMode", BLUR_HORIZONTAL);
         ctx->manager->blit(vBlur, hBlur, blurShader);
 
         // VERTICAL BLUR
-        //threshold->bind();
         blurShader->bind();
         blurShader->setUniformValue("u_sceneTexture", 0);
         blurShader->setUniformValue("u_blurMode", BLUR_VERTICAL);
@@ -92,8 +80,10 @@ void BloomPostProcess::process(iris::PostProcessContext *ctx)
     }
 
     // COMBINE
+    // rendered straight into the output rather than into a texture that's then copied
+    auto output = ctx->createOutput();
+
     combineShader->bind();
-    //ctx->sceneTexture->bind(0);
     ctx->finalTexture->bind(0);
     combineShader->setUniformValue("u_sceneTexture", 0);
 
@@ -113,11 +103,13 @@ void BloomPostProcess::process(iris::PostProcessContext *ctx)
     }
 
     combineShader->setUniformValue("u_bloomStrength", bloomStrength);
-    ctx->manager->blit(Texture2D::null(), final, combineShader);
-    //ctx->manager->blit(hBlur, ctx->finalTexture, nullptr);
+    ctx->manager->blit(Texture2D::null(), output, combineShader);
     combineShader->release();
 
-    ctx->manager->blit(final, ctx->finalTexture);
+    ctx->manager->releaseTexture(hBlur);
+    ctx->manager->releaseTexture(vBlur);
+
+    ctx->setOutput(output);
 }
 
 QList<Property *> BloomPostProcess::getProperties()
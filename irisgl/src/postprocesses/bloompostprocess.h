@@ -20,11 +20,6 @@ public:
     QOpenGLShaderProgram* blurShader;
     QOpenGLShaderProgram* combineShader;
 
-    Texture2DPtr threshold;
-    Texture2DPtr hBlur;
-    Texture2DPtr vBlur;
-    Texture2DPtr final;
-
     float bloomThreshold;
     float bloomStrength;
     float dirtStrength;
@@ -33,29 +33,24 @@ ColorOverlayPostProcess::ColorOverlayPostProcess()
     name = "color_overlay";
     displayName = "Color Overlay";
 
-    shader = GraphicsHelper::loadShader(":assets/shaders/postprocesses/default.vs",
-                                        ":assets/shaders/postprocesses/coloroverlay.fs");
-
     //setOverlayColor(QColor(255,200,200));
     setOverlayColor(QColor(255,255,255));
-
-    final = Texture2D::create(100, 100);
 }
 
 void ColorOverlayPostProcess::process(iris::PostProcessContext *ctx)
 {
-    //todo: only resize of the sizes are different
-    auto screenWidth = ctx->sceneTexture->texture->width();
-    auto screenHeight = ctx->sceneTexture->texture->height();
-    final->resize(screenWidth, screenHeight);
-
-    shader->bind();
-    shader->setUniformValue("u_colorOverlay", col);
-    shader->setUniformValue("u_sceneTexture", 0);
-    ctx->manager->blit(ctx->sceneTexture, final, shader);
-    shader->release();
-
-    ctx->manager->blit(final, ctx->finalTexture);
+    QMatrix4x4 matrix;
+    getColorMatrix(matrix);
+    ctx->manager->applyColorMatrix(ctx, matrix);
+}
+
+bool ColorOverlayPostProcess::getColorMatrix(QMatrix4x4 &matrix)
+{
+    matrix = QMatrix4x4(col.x(), 0,       0,       0,
+                        0,       col.y(), 0,       0,
+                        0,       0,       col.z(), 0,
+                        0,       0,       0,       1);
+    return true;
 }
 
 QList<Property *> ColorOverlayPostProcess::getProperties()
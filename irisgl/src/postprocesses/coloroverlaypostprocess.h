@@ -15,12 +15,11 @@ class ColorOverlayPostProcess : public PostProcess
 {
     QColor overlayColor;
     QVector3D col;
-    QOpenGLShaderProgram* shader;
-    Texture2DPtr final;
 public:
     ColorOverlayPostProcess();
 
     virtual void process(PostProcessContext* ctx) override;
+    virtual bool getColorMatrix(QMatrix4x4& matrix) override;
 
     QList<Property *> getProperties();
     void setProperty(Property *prop) override;
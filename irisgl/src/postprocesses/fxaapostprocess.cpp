@@ -24,9 +24,6 @@ FxaaPostProcess::FxaaPostProcess()
     fxaaShader = GraphicsHelper::loadShader(":assets/shaders/postprocesses/default.vs",
                                         ":assets/shaders/postprocesses/aa.fs");
 
-    tonemapTex = Texture2D::create(100, 100);
-    fxaaTex = Texture2D::create(100, 100);
-
     quality = 1;
 }
 
@@ -61,18 +58,19 @@ int FxaaPostProcess::getQuality()
 
 void FxaaPostProcess::process(PostProcessContext *ctx)
 {
-    auto screenWidth = ctx->sceneTexture->texture->width();
-    auto screenHeight = ctx->sceneTexture->texture->height();
-    tonemapTex->resize(screenWidth, screenHeight);
-    fxaaTex->resize(screenWidth, screenHeight);
+    auto screenWidth = ctx->getWidth();
+    auto screenHeight = ctx->getHeight();
+    auto tonemapTex = ctx->createOutput();
 
     tonemapShader->bind();
     tonemapShader->setUniformValue("u_screenTex", 0);
-    ctx->manager->blit(ctx->sceneTexture, tonemapTex, tonemapShader);
+    ctx->manager->blit(ctx->finalTexture, tonemapTex, tonemapShader);
     tonemapShader->release();
 
     tonemapTex->texture->generateMipMaps();
+    ctx->setOutput(tonemapTex);
 
+    auto fxaaTex = ctx->createOutput();
 
     fxaaShader->bind();
     fxaaShader->setUniformValue("u_screenTex", 0);
@@ -80,7 +78,7 @@ void FxaaPostProcess::process(PostProcessContext *ctx)
     ctx->manager->blit(tonemapTex, fxaaTex, fxaaShader);
     fxaaShader->release();
 
-    ctx->manager->blit(fxaaTex, ctx->finalTexture);
+    ctx->setOutput(fxaaTex);
 }
 
 FxaaPostProcessPtr FxaaPostProcess::create()
@@ -16,9 +16,6 @@ typedef QSharedPointer<FxaaPostProcess> FxaaPostProcessPtr;
 class FxaaPostProcess : public PostProcess
 {
 public:
-    Texture2DPtr tonemapTex;
-    Texture2DPtr fxaaTex;
-
     QOpenGLShaderProgram* tonemapShader;
     QOpenGLShaderProgram* fxaaShader;
 
@@ -15,19 +15,23 @@ GreyscalePostProcess::GreyscalePostProcess()
 {
     name = "greyscale";
     displayName = "GreyScale";
-    shader = GraphicsHelper::loadShader(":assets/shaders/postprocesses/default.vs",
-                                        ":assets/shaders/postprocesses/greyscale.fs");
-    final = Texture2D::create(100, 100);
 }
 
 void GreyscalePostProcess::process(iris::PostProcessContext *ctx)
 {
-    shader->bind();
-    shader->setUniformValue("u_sceneTexture", 0);
-    ctx->manager->blit(ctx->sceneTexture, final, shader);
-    shader->release();
+    QMatrix4x4 matrix;
+    getColorMatrix(matrix);
+    ctx->manager->applyColorMatrix(ctx, matrix);
+}
 
-    ctx->manager->blit(final, ctx->finalTexture, shader);
+bool GreyscalePostProcess::getColorMatrix(QMatrix4x4 &matrix)
+{
+    // every channel becomes the luminance
+    matrix = QMatrix4x4(0.2126f, 0.7152f, 0.0722f, 0,
+                        0.2126f, 0.7152f, 0.0722f, 0,
+                        0.2126f, 0.7152f, 0.0722f, 0,
+                        0,       0,       0,       1);
+    return true;
 }
 
 GreyscalePostProcessPtr GreyscalePostProcess::create()
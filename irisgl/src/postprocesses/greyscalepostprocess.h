@@ -13,12 +13,11 @@ typedef QSharedPointer<GreyscalePostProcess> GreyscalePostProcessPtr;
 
 class GreyscalePostProcess : public PostProcess
 {
-    QOpenGLShaderProgram* shader;
-    Texture2DPtr final;
 public:
     GreyscalePostProcess();
 
     virtual void process(PostProcessContext* ctx) override;
+    virtual bool getColorMatrix(QMatrix4x4& matrix) override;
 
     static GreyscalePostProcessPtr create();
 };
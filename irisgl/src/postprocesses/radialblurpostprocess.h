@@ -17,7 +17,6 @@ class RadialBlurPostProcess : public PostProcess
     QOpenGLShaderProgram* shader;
 
     float blurSize;
-    Texture2DPtr final;
 public:
     RadialBlurPostProcess();
 
@@ -101,8 +101,10 @@ void SSAOPostProcess::setProperty(Property *prop)
 
 void SSAOPostProcess::process(PostProcessContext *ctx)
 {
+    auto output = ctx->createOutput();
+
     shader->bind();
-    ctx->sceneTexture->bind(0);
+    ctx->finalTexture->bind(0);
     ctx->depthTexture->bind(1);
     normals->bind(2);
     shader->setUniformValue("u_sceneTexture", 0);
@@ -116,8 +118,10 @@ void SSAOPostProcess::process(PostProcessContext *ctx)
     shader->setUniformValue("gdisplace",gaussBellCenter);
     shader->setUniformValue("lumInfluence",lumInfluence);
 
-    ctx->manager->blit(Texture2D::null(), ctx->finalTexture, shader);
+    ctx->manager->blit(Texture2D::null(), output, shader);
     shader->release();
+
+    ctx->setOutput(output);
 }
 
 SSAOPostProcessPtr SSAOPostProcess::create()
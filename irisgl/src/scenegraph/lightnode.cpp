@@ -63,7 +63,7 @@ QVariant LightNode::getPropertyValue(QString valueName)
     return SceneNode::getPropertyValue(valueName);
 }
 
-void LightNode::updateAnimation(float time)
+void LightNode::applyAnimatedProperties(float time)
 {
     if (!!animation) {
         if(animation->hasPropertyAnim("intensity"))
@@ -77,8 +77,6 @@ void LightNode::updateAnimation(float time)
         if(animation->hasPropertyAnim("spotCutOffSoftness"))
             spotCutOffSoftness = animation->getFloatPropertyAnim("spotCutOffSoftness")->getValue(time);
     }
-
-    SceneNode::updateAnimation(time);
 }
 
 LightNode::LightNode()
@@ -119,6 +117,8 @@ SceneNodePtr LightNode::createDuplicate()
 	light->shadowMap->bias = this->shadowMap->bias;
 	light->shadowMap->shadowType = this->shadowMap->shadowType;
 	light->shadowMap->setResolution(this->shadowMap->resolution);
+	light->shadowMap->setCascadeCount(this->shadowMap->cascadeCount);
+	light->shadowMap->shadowDistance = this->shadowMap->shadowDistance;
 	light->icon = this->icon;
 	light->iconSize = this->iconSize;
 
@@ -77,6 +77,7 @@ public:
     void setLightType(LightType type)
     {
         this->lightType = type;
+        shadowMap->invalidate();
     }
 
     LightType getLightType()
@@ -97,8 +98,10 @@ public:
     virtual QList<Property*> getProperties() override;
     virtual QVariant getPropertyValue(QString valueName) override;
 
-    void updateAnimation(float time) override;
+protected:
+    void applyAnimatedProperties(float time) override;
 
+public:
 	ShadowMap* getShadowMap()
 	{
 		return shadowMap;
@@ -107,6 +110,7 @@ public:
 	void setShadowMapType(ShadowMapType shadowType)
 	{
 		shadowMap->shadowType = shadowType;
+		shadowMap->invalidate();
 	}
 
 	ShadowMapType getShadowMapType()
@@ -42,6 +42,7 @@ For more information see the LICENSE file
 
 #include "../graphics/skeleton.h"
 #include "../graphics/renderlist.h"
+#include "../geometry/trimesh.h"
 
 namespace iris
 {
@@ -53,6 +54,7 @@ MeshNode::MeshNode() {
     renderItem->type = RenderItemType::Mesh;
 
     faceCullingMode = FaceCullingMode::DefinedInMaterial;
+    shadowCasting = false;
 }
 
 // @todo: cleanup previous mesh item
@@ -81,6 +83,8 @@ void MeshNode::setMesh(QString source)
     meshIndex = 0;
 
     renderItem->mesh = mesh;
+    if (!!scene) scene->markBoundsDirty(this);
+    invalidateAnimationBinding();
 }
 
 //should not be used on plain scene meshes
@@ -88,6 +92,8 @@ void MeshNode::setMesh(MeshPtr mesh)
 {
     this->mesh = mesh;
     renderItem->mesh = mesh;
+    if (!!scene) scene->markBoundsDirty(this);
+    invalidateAnimationBinding();
 }
 
 MeshPtr MeshNode::getMesh()
@@ -102,8 +108,46 @@ void MeshNode::setMaterial(MaterialPtr material)
     renderItem->renderStates = material->renderStates;
 }
 
+void MeshNode::trackShadowCaster()
+{
+    bool casting = visible && getShadowCastingEnabled() && !!mesh;
+    if (!casting) {
+        if (shadowCasting)
+            scene->markShadowCasterDirty(shadowBounds);
+        shadowCasting = false;
+        return;
+    }
+
+    bool changed = !shadowCasting || shadowMesh != mesh || shadowTransform != globalTransform;
+
+    if (mesh->hasSkeleton()) {
+        // posed vertices can leave the bind pose bounds so all shadows are redrawn
+        auto& boneTransforms = mesh->getSkeleton()->boneTransforms;
+        if (boneTransforms != shadowBoneTransforms) {
+            shadowBoneTransforms = boneTransforms;
+            scene->markShadowsDirty();
+        }
+    }
+
+    if (!changed)
+        return;
+
+    // both where it was and where it is now have to be redrawn
+    if (shadowCasting)
+        scene->markShadowCasterDirty(shadowBounds);
+
+    shadowBounds = getTransformedBoundingSphere();
+    scene->markShadowCasterDirty(shadowBounds);
+
+    shadowCasting = true;
+    shadowMesh = mesh;
+    shadowTransform = globalTransform;
+}
+
 void MeshNode::submitRenderItems()
 {
+    trackShadowCaster();
+
     if (visible) {
         QMatrix4x4 transform = this->globalTransform;
 
@@ -111,10 +155,13 @@ void MeshNode::submitRenderItems()
         renderItem->physicsObject = isPhysicsBody;
 		renderItem->worldMatrix = transform;
         renderItem->guid = guid;
- 
-        if (!!mesh && renderItem->cullable) {
+
+        // skinned meshes can be posed outside of their bind pose bounds and meshes
+        // built by hand may not have any bounds, neither is culled
+        if (!!mesh) {
             renderItem->boundingSphere.pos = transform * mesh->boundingSphere.pos;
             renderItem->boundingSphere.radius = mesh->boundingSphere.radius * getMeshRadius();
+            renderItem->cullable = !mesh->hasSkeleton() && !mesh->getAABB().isEmpty();
         }
 
         if (!!material) {
@@ -156,6 +203,22 @@ float MeshNode::getMeshRadius()
     return qMax(qMax(scaleX, scaleY), scaleZ);
 }
 
+bool MeshNode::getWorldBounds(AABB& bounds)
+{
+    if (!mesh)
+        return false;
+
+    // the triangle bounds are only needed if the mesh didnt calculate its own
+    auto localBounds = mesh->aabb;
+    if (localBounds.isEmpty() && mesh->getTriMesh() != nullptr)
+        localBounds = mesh->getTriMesh()->getBounds();
+    if (localBounds.isEmpty())
+        return false;
+
+    bounds = localBounds.transformed(globalTransform);
+    return true;
+}
+
 BoundingSphere MeshNode::getTransformedBoundingSphere()
 {
     BoundingSphere boundingSphere;
@@ -148,6 +148,7 @@ public:
 
     SceneNodePtr createDuplicate() override;
     virtual void submitRenderItems() override;
+    virtual bool getWorldBounds(AABB& bounds) override;
     float getMeshRadius();
     BoundingSphere getTransformedBoundingSphere();
 
@@ -156,6 +157,16 @@ public:
 
 private:
     MeshNode();
+
+    // reports changes to the scene since the shadow maps were last drawn
+    void trackShadowCaster();
+
+    // what the shadow maps last saw of this mesh
+    bool shadowCasting;
+    BoundingSphere shadowBounds;
+    QMatrix4x4 shadowTransform;
+    MeshPtr shadowMesh;
+    QVector<QMatrix4x4> shadowBoneTransforms;
 };
 
 }
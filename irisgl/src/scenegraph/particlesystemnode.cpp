@@ -28,6 +28,7 @@ For more information see the LICENSE file
 #include "../graphics/renderitem.h"
 #include "../graphics/particle.h"
 #include "../graphics/particlerender.h"
+#include "../graphics/gpuparticlesimulator.h"
 #include "../graphics/renderlist.h"
 
 #include "../scenegraph/scene.h"
@@ -64,6 +65,11 @@ ParticleSystemNode::ParticleSystemNode() {
 
     renderer = new ParticleRenderer();
 
+    simulationMode = ParticleSimulationMode::Cpu;
+    gpuSimulator = nullptr;
+    pendingGpuDelta = 0;
+    pendingGpuEmissions = 0;
+
     renderItem = new RenderItem();
     renderItem->type = RenderItemType::ParticleSystem;
 
@@ -81,6 +87,7 @@ ParticleSystemNode::~ParticleSystemNode()
     delete renderItem;
     delete boundsRenderItem;
     delete renderer;
+    delete gpuSimulator;
 }
 
 void ParticleSystemNode::setBlendMode(bool useAddittive)
@@ -88,6 +95,21 @@ void ParticleSystemNode::setBlendMode(bool useAddittive)
     renderer->useAdditive = this->useAdditive = useAddittive;
 }
 
+void ParticleSystemNode::setSimulationMode(ParticleSimulationMode mode)
+{
+    if (simulationMode == mode)
+        return;
+
+    simulationMode = mode;
+    particles.clear();
+
+    // the gpu slots are cleared the next time they're simulated
+    pendingGpuDelta = 0;
+    pendingGpuEmissions = 0;
+    if (gpuSimulator != nullptr)
+        gpuSimulator->setCapacity(0);
+}
+
 void ParticleSystemNode::setBillboardScale(float scale)
 {
 //    billboardScale = scale;
@@ -120,6 +142,12 @@ void ParticleSystemNode::generateParticles(float delta) {
 }
 
 void ParticleSystemNode::emitParticle() {
+    // gpu particles are spawned by the simulation shader
+    if (simulationMode == ParticleSimulationMode::Gpu) {
+        pendingGpuEmissions++;
+        return;
+    }
+
     QVector4D dir = QVector4D(QVector3D(0, 1, 0), 0);
     QVector4D particleDirection = this->globalTransform * dir;
 
@@ -132,15 +160,13 @@ void ParticleSystemNode::emitParticle() {
     float scl = generateValue(particleScale, scaleError);
     float ll = generateValue(lifeLength, lifeError);
 
-    // reuse particles! this is bad.
-    // change later after atlases
     boundDimension = QVector3D(1, 1, 1) * this->scale;
-    addParticle(new Particle(this->getGlobalPosition() + boundDimension * generateRandomUnitVector(),
-                             velocity,
-                             gravityComplement,
-                             ll,
-                             generateRotation(),
-                             scl));
+    particles.add(this->getGlobalPosition() + boundDimension * generateRandomUnitVector(),
+                  velocity,
+                  gravityComplement,
+                  ll,
+                  generateRotation(),
+                  scl);
 }
 
 float ParticleSystemNode::generateValue(float average, float errorMargin) {
@@ -169,39 +195,92 @@ void ParticleSystemNode::update(float delta) {
     SceneNode::update(delta);
 
     generateParticles(delta);
-    //std::list<Particle*>::iterator it = particles.begin();
 
-	for (int i = 0; i < particles.size(); i++) {
-		auto p = particles[i];
+    if (simulationMode == ParticleSimulationMode::Gpu) {
+        pendingGpuDelta += delta;
+        return;
+    }
+
+    particles.integrate(delta);
+
+    float* scale = particles.scale.data();
+    const float* elapsedTime = particles.elapsedTime.constData();
+    const float* lifeLength = particles.lifeLength.constData();
 
-        p->velocity += QVector3D(0, p->GRAVITY * p->gravityEffect * delta, 0);
-        //p.velocity.setY(p.velocity.y() + GRAVITY * gravityEffect * delta);
-        QVector3D change = p->velocity;
-        change *= delta;
-        p->position += change;
-        //p.position += p->velocity * delta;
-        p->elapsedTime += delta;
+    // in the future we can call behavior management here, add more forces such as wind
+    if (dissipate) {
+        for (int i = 0; i < particles.size(); i++) {
+            if (elapsedTime[i] <= 0)
+                continue;
 
-        // in the future we can call behavior management here, add more forces such as wind
-        if (dissipate && p->elapsedTime > 0) {
             if (dissipateInv) {
-                p->scale = MathHelper::lerp((p->elapsedTime / p->lifeLength), 0, particleScale);
+                scale[i] = MathHelper::lerp((elapsedTime[i] / lifeLength[i]), 0, particleScale);
             } else {
-                p->scale *= 1.0f - (p->elapsedTime / p->lifeLength);
+                scale[i] *= 1.0f - (elapsedTime[i] / lifeLength[i]);
             }
         }
+    }
 
-        if (p->elapsedTime > p->lifeLength) {
-			particles.erase(particles.begin() + i);
-			i--;
-        }
+    // going backwards means the particle swapped into a removed one's place was already checked
+    for (int i = particles.size() - 1; i >= 0; i--) {
+        if (particles.elapsedTime.at(i) > particles.lifeLength.at(i))
+            particles.remove(i);
     }
 }
 
 void ParticleSystemNode::renderParticles(GraphicsDevicePtr device, RenderData* renderData, ShaderPtr shader)
 {
     renderer->icon = texture;
-    renderer->render(device, shader, renderData, this->particles);
+
+    if (simulationMode == ParticleSimulationMode::Gpu) {
+        simulateGpuParticles();
+        renderer->renderInstances(device, shader, renderData,
+                                  gpuSimulator->getParticleBuffer(),
+                                  gpuSimulator->getCapacity(),
+                                  GPU_PARTICLE_TEXELS);
+    } else {
+        renderer->render(device, shader, renderData, this->particles);
+    }
+}
+
+void ParticleSystemNode::simulateGpuParticles()
+{
+    if (gpuSimulator == nullptr)
+        gpuSimulator = new GpuParticleSimulator();
+
+    // enough slots for every particle to live out its longest life
+    // changing the emission settings restarts the simulation
+    int capacity = (int) ceil(particlesPerSecond * (lifeLength + fabs(lifeError))) + 1;
+    gpuSimulator->setCapacity(capacity);
+
+    // the scene can be rendered more than once a frame, only the first render simulates
+    if (pendingGpuDelta <= 0)
+        return;
+
+    QVector4D dir = QVector4D(QVector3D(0, 1, 0), 0);
+    QVector3D direction = QVector3D(this->globalTransform * dir).normalized();
+
+    GpuParticleEmission emission;
+    emission.delta = pendingGpuDelta;
+    emission.count = pendingGpuEmissions;
+    emission.emitterPos = this->getGlobalPosition();
+    emission.boundDimension = QVector3D(1, 1, 1) * this->scale;
+    emission.direction = direction;
+    emission.speed = speed;
+    emission.speedError = speedError;
+    emission.particleScale = particleScale;
+    emission.scaleError = scaleError;
+    emission.lifeLength = lifeLength;
+    emission.lifeError = lifeError;
+    emission.gravity = gravityComplement;
+    emission.randomRotation = randomRotation;
+    emission.dissipate = dissipate;
+    emission.dissipateInv = dissipateInv;
+
+    gpuSimulator->simulate(emission);
+
+    pendingGpuDelta = 0;
+    pendingGpuEmissions = 0;
 }
 
 SceneNodePtr ParticleSystemNode::createDuplicate()
@@ -236,6 +315,8 @@ SceneNodePtr ParticleSystemNode::createDuplicate()
 	ps->posDir				= this->posDir;
 	ps->boundDimension		= this->boundDimension;
 
+	ps->setSimulationMode(this->simulationMode);
+
 	return ps;
 }
 
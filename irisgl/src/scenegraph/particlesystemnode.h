@@ -16,6 +16,7 @@ For more information see the LICENSE file
 #include "../scenegraph/scenenode.h"
 #include "../core/irisutils.h"
 #include "../graphics/texture2d.h"
+#include "../graphics/particle.h"
 
 class QOpenGLShaderProgram;
 
@@ -23,8 +24,16 @@ namespace iris
 {
 
 class RenderItem;
-class Particle;
 class ParticleRenderer;
+class GpuParticleSimulator;
+
+enum class ParticleSimulationMode
+{
+    // particles are simulated on the cpu and uploaded for drawing every frame
+    Cpu,
+    // particles never leave the gpu, for emitters too big to upload every frame
+    Gpu
+};
 
 class ParticleSystemNode : public SceneNode
 {
@@ -145,22 +154,28 @@ public:
     }
 
     void setPos(QVector3D p) {
-        this->pos = p;
+        setLocalPos(p);
     }
 
     void setTexture(QSharedPointer<iris::Texture2D> tex) {
         this->texture = tex;
     }
 
+    /**
+     * Switching modes discards the particles that are alive
+     */
+    void setSimulationMode(ParticleSimulationMode mode);
+
+    ParticleSimulationMode getSimulationMode() {
+        return simulationMode;
+    }
+
     void setBillboardScale(float scale);
 
     void update(float delta) override;
 
     void renderParticles(GraphicsDevicePtr device, RenderData* renderData, ShaderPtr shader);
-
-    void addParticle(Particle *particle) {
-        particles.push_back(particle);
-    }
+    void simulateGpuParticles();
 
     ~ParticleSystemNode();
 
@@ -170,7 +185,14 @@ public:
 
     ParticleSystemNode();
 
-    std::vector<Particle*> particles;
+    ParticlePool particles;
+
+    ParticleSimulationMode simulationMode;
+    GpuParticleSimulator* gpuSimulator;
+    // the time and emissions since the gpu particles were last simulated
+    // the simulation runs when the particles are rendered since it needs the gl context
+    float pendingGpuDelta;
+    int pendingGpuEmissions;
 
     MaterialPtr material;
     RenderItem* renderItem;
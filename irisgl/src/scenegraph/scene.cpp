@@ -21,7 +21,9 @@ For more information see the LICENSE file
 #include "../materials/defaultskymaterial.h"
 #include "../geometry/trimesh.h"
 #include "../core/irisutils.h"
+#include "../core/jobsystem.h"
 #include "../graphics/renderlist.h"
+#include "transformhierarchy.h"
 
 #include "physics/environment.h"
 #include "math/intersectionhelper.h"
@@ -71,6 +73,9 @@ Scene::Scene()
     shadowRenderList = new RenderList();
     gizmoRenderList = new RenderList();
 
+    transformHierarchy = new TransformHierarchy();
+    shadowsDirty = true;
+
 	time = 0;
 
     environment = QSharedPointer<Environment>(new Environment(geometryRenderList));
@@ -106,13 +111,42 @@ void Scene::setAmbientColor(QColor color)
 
 void Scene::updateSceneAnimation(float time)
 {
-    rootNode->updateAnimation(time);
+    skeletalAnimationJobs.clear();
+    rootNode->updatePropertyAnimations(time, skeletalAnimationJobs);
+
+    // sampling only writes to the skeleton's own binding so characters are sampled
+    // in parallel, then their poses are written back to the scene from this thread
+    const SkeletalAnimationJob* jobs = skeletalAnimationJobs.constData();
+    JobSystem::parallelFor(skeletalAnimationJobs.size(), [jobs](int index) {
+        if (!jobs[index].nested)
+            jobs[index].binding->sample(jobs[index].time);
+    });
+
+    for (const auto& job : skeletalAnimationJobs) {
+        if (!job.nested)
+            job.binding->writePose();
+    }
+
+    // skeletons inside other skeletons override their pose so they're done last, in order
+    for (const auto& job : skeletalAnimationJobs) {
+        if (job.nested)
+            job.binding->evaluate(job.time);
+    }
 }
 
 void Scene::update(float dt)
 {
 	time += dt < 0 ? 0 : dt;
-    rootNode->update(dt);
+    if (transformHierarchy->update(rootNode)) {
+        for (auto node : transformHierarchy->getChangedNodes())
+            markBoundsDirty(node);
+    }
+    updateSpatialIndex();
+
+    // transforms are handled above, particle systems still need to simulate
+    for (const auto &particle : particleSystems) {
+        particle->update(dt);
+    }
 
     // cameras aren't always a part of the scene hierarchy, so their matrices are updated here
     if (!!camera) {
@@ -164,7 +198,14 @@ void Scene::rayCast(const QVector3D& segStart,
                     const QVector3D& segEnd,
                     QList<PickingResult>& hitList)
 {
-    rayCast(rootNode, segStart, segEnd, hitList);
+    updateSpatialIndex();
+
+    spatialIndex.traverseSegment(segStart, segEnd, [&](void* userData, float& maxT) {
+        auto node = static_cast<SceneNode*>(userData);
+        if (node->getSceneNodeType() == SceneNodeType::Mesh)
+            rayCastMesh(node->sharedFromThis().staticCast<MeshNode>(), segStart, segEnd, hitList);
+        return true;
+    });
 }
 
 void Scene::rayCast(const QSharedPointer<iris::SceneNode>& sceneNode,
@@ -172,43 +213,8 @@ void Scene::rayCast(const QSharedPointer<iris::SceneNode>& sceneNode,
                     const QVector3D& segEnd,
                     QList<iris::PickingResult>& hitList)
 {
-    if ((sceneNode->getSceneNodeType() == iris::SceneNodeType::Mesh) &&
-         sceneNode->isPickable())
-    {
-        auto meshNode = sceneNode.staticCast<iris::MeshNode>();
-        auto mesh = meshNode->getMesh();
-        if(mesh != nullptr)
-        {
-            
-            // transform segment to local space
-            auto invTransform = meshNode->globalTransform.inverted();
-            auto a = invTransform * segStart;
-            auto b = invTransform * segEnd;
-
-			// ray-sphere intersection first
-			auto mesh = meshNode->getMesh();
-			auto sphere = mesh->getBoundingSphere();
-			float t;
-			QVector3D hitPoint;
-			if (IntersectionHelper::raySphereIntersects(a, (b - a).normalized(), sphere.pos, sphere.radius, t, hitPoint)) {
-				auto triMesh = meshNode->getMesh()->getTriMesh();
-
-				QList<iris::TriangleIntersectionResult> results;
-				if (int resultCount = triMesh->getSegmentIntersections(a, b, results)) {
-					for (auto triResult : results) {
-						// convert hit to world space
-						auto hitPoint = meshNode->globalTransform * triResult.hitPoint;
-
-						PickingResult pick;
-						pick.hitNode = sceneNode;
-						pick.hitPoint = hitPoint;
-						pick.distanceFromStartSqrd = (hitPoint - segStart).lengthSquared();
-
-						hitList.append(pick);
-					}
-				}
-			}
-        }
+    if (sceneNode->getSceneNodeType() == iris::SceneNodeType::Mesh) {
+        rayCastMesh(sceneNode.staticCast<iris::MeshNode>(), segStart, segEnd, hitList);
     }
 
     for (auto child : sceneNode->children) {
@@ -216,8 +222,127 @@ void Scene::rayCast(const QSharedPointer<iris::SceneNode>& sceneNode,
     }
 }
 
+bool Scene::rayCastClosest(const QVector3D& segStart,
+                           const QVector3D& segEnd,
+                           PickingResult& result)
+{
+    updateSpatialIndex();
+
+    bool hit = false;
+    spatialIndex.traverseSegment(segStart, segEnd, [&](void* userData, float& maxT) {
+        auto node = static_cast<SceneNode*>(userData);
+        if (node->getSceneNodeType() != SceneNodeType::Mesh || !node->isPickable())
+            return true;
+
+        auto meshNode = static_cast<MeshNode*>(node);
+        auto mesh = meshNode->getMesh();
+        if (mesh == nullptr || mesh->getTriMesh() == nullptr)
+            return true;
+        auto triMesh = mesh->getTriMesh();
+
+        // t is the same in local space since the transform is affine
+        auto invTransform = meshNode->globalTransform.inverted();
+        auto a = invTransform * segStart;
+        auto b = invTransform * segEnd;
+
+        TriangleIntersectionResult triResult;
+        if (triMesh->getClosestSegmentIntersection(a, b, triResult) && triResult.t < maxT) {
+            maxT = triResult.t;
+
+            result.hitNode = meshNode->sharedFromThis();
+            result.hitPoint = meshNode->globalTransform * triResult.hitPoint;
+            result.distanceFromStartSqrd = (result.hitPoint - segStart).lengthSquared();
+            hit = true;
+        }
+
+        return true;
+    });
+
+    return hit;
+}
+
+void Scene::markBoundsDirty(SceneNode* node)
+{
+    if (node->spatialBoundsDirty)
+        return;
+
+    node->spatialBoundsDirty = true;
+    boundsDirtyNodes.append(node);
+}
+
+const DynamicAabbTree& Scene::getSpatialIndex()
+{
+    updateSpatialIndex();
+    return spatialIndex;
+}
+
+void Scene::updateSpatialIndex()
+{
+    for (auto node : boundsDirtyNodes) {
+        node->spatialBoundsDirty = false;
+
+        AABB bounds;
+        if (node->getWorldBounds(bounds)) {
+            if (node->spatialProxy < 0)
+                node->spatialProxy = spatialIndex.createProxy(bounds, node);
+            else
+                spatialIndex.moveProxy(node->spatialProxy, bounds);
+        } else if (node->spatialProxy >= 0) {
+            spatialIndex.destroyProxy(node->spatialProxy);
+            node->spatialProxy = -1;
+        }
+    }
+
+    boundsDirtyNodes.clear();
+}
+
+void Scene::rayCastMesh(const MeshNodePtr& meshNode,
+                        const QVector3D& segStart,
+                        const QVector3D& segEnd,
+                        QList<iris::PickingResult>& hitList)
+{
+    if (!meshNode->isPickable())
+        return;
+
+    auto mesh = meshNode->getMesh();
+    if (mesh == nullptr || mesh->getTriMesh() == nullptr)
+        return;
+
+    // transform segment to local space
+    auto invTransform = meshNode->globalTransform.inverted();
+    auto a = invTransform * segStart;
+    auto b = invTransform * segEnd;
+
+    // ray-sphere intersection first
+    auto sphere = mesh->getBoundingSphere();
+    float t;
+    QVector3D hitPoint;
+    if (IntersectionHelper::raySphereIntersects(a, (b - a).normalized(), sphere.pos, sphere.radius, t, hitPoint)) {
+        auto triMesh = mesh->getTriMesh();
+
+        QList<iris::TriangleIntersectionResult> results;
+        if (triMesh->getSegmentIntersections(a, b, results)) {
+            for (auto triResult : results) {
+                // convert hit to world space
+                auto hitPoint = meshNode->globalTransform * triResult.hitPoint;
+
+                PickingResult pick;
+                pick.hitNode = meshNode;
+                pick.hitPoint = hitPoint;
+                pick.distanceFromStartSqrd = (hitPoint - segStart).lengthSquared();
+
+                hitList.append(pick);
+            }
+        }
+    }
+}
+
 void Scene::addNode(SceneNodePtr node)
 {
+    transformHierarchy->markStructureDirty();
+    markBoundsDirty(node.data());
+    shadowsDirty = true;
+
     if (!!node->scene)
     {
         //qDebug() << "Node already has scene";
@@ -251,6 +376,22 @@ void Scene::addNode(SceneNodePtr node)
 
 void Scene::removeNode(SceneNodePtr node)
 {
+    node->transformIndex = -1;
+    node->setTransformDirty();
+    transformHierarchy->markStructureDirty();
+    shadowsDirty = true;
+
+    // the node may be deleted once it's out of the scene so nothing can refer to it
+    if (node->spatialBoundsDirty) {
+        boundsDirtyNodes.removeOne(node.data());
+        node->spatialBoundsDirty = false;
+    }
+
+    if (node->spatialProxy >= 0) {
+        spatialIndex.destroyProxy(node->spatialProxy);
+        node->spatialProxy = -1;
+    }
+
     if (node->sceneNodeType == SceneNodeType::Light) {
         lights.removeOne(node.staticCast<iris::LightNode>());
     }
@@ -317,12 +458,17 @@ void Scene::cleanup()
 
     lights.clear();
     meshes.clear();
+    boundsDirtyNodes.clear();
+    spatialIndex.clear();
     particleSystems.clear();
     viewers.clear();
 
     delete geometryRenderList;
     delete shadowRenderList;
     delete gizmoRenderList;
+
+    delete transformHierarchy;
+    transformHierarchy = nullptr;
 }
 
 }
@@ -17,6 +17,9 @@ For more information see the LICENSE file
 #include "../graphics/texture2d.h"
 #include "../materials/defaultskymaterial.h"
 #include "../geometry/frustum.h"
+#include "../geometry/boundingsphere.h"
+#include "../geometry/dynamicaabbtree.h"
+#include "../animation/skeletalanimationbinding.h"
 
 namespace iris
 {
@@ -24,6 +27,7 @@ namespace iris
 class RenderItem;
 class RenderList;
 class Environment;
+class TransformHierarchy;
 
 enum class SceneRenderFlags : int
 {
@@ -42,6 +46,21 @@ class Scene: public QEnableSharedFromThis<Scene>
 {
     QSharedPointer<Environment> environment;
 
+    // world bounds of shadow casters that changed since the last shadow pass
+    // a light only redraws its shadow map if one of them is inside it
+    QVector<BoundingSphere> shadowDirtyBounds;
+    // set for changes that can't be bounded, every shadow map gets redrawn
+    bool shadowsDirty;
+
+    // world bounds of the scene's nodes for picking and visibility queries
+    // nodes are moved in it as their transforms change instead of it being rebuilt
+    DynamicAabbTree spatialIndex;
+    // nodes whose bounds have to be updated in the index before it's used again
+    QVector<SceneNode*> boundsDirtyNodes;
+
+    // skeletal animations found by the last updateSceneAnimation, kept to reuse the storage
+    QVector<SkeletalAnimationJob> skeletalAnimationJobs;
+
 public:
     CameraNodePtr camera;
     SceneNodePtr rootNode;
@@ -84,6 +103,9 @@ public:
     RenderList* shadowRenderList;
     RenderList* gizmoRenderList;// for gizmos and lines
 
+    // flattened node hierarchy used to update transforms each frame
+    TransformHierarchy* transformHierarchy;
+
     QString skyBoxTextures[6];
 
     /*
@@ -139,6 +161,63 @@ public:
                  const QVector3D& segEnd,
                  QList<iris::PickingResult>& hitList);
 
+    /**
+     * Finds the pickable mesh hit closest to segStart
+     * Returns false if nothing was hit
+     */
+    bool rayCastClosest(const QVector3D& segStart,
+                        const QVector3D& segEnd,
+                        PickingResult& result);
+
+    /**
+     * Flags node's bounds to be updated in the spatial index
+     * Should be called when a node's bounds change without its transform changing
+     */
+    void markBoundsDirty(SceneNode* node);
+
+    /**
+     * Returns the index over the world bounds of the scene's nodes, for frustum, sphere,
+     * box and ray queries. The user data of each proxy is the SceneNode* it belongs to
+     * Nodes changed since the last update are brought up to date first
+     */
+    const DynamicAabbTree& getSpatialIndex();
+
+    /**
+     * Flags the shadows of lights that reach bounds to be redrawn
+     * Mesh nodes call this when a shadow caster moves, changes or disappears
+     */
+    void markShadowCasterDirty(const BoundingSphere& bounds)
+    {
+        shadowDirtyBounds.append(bounds);
+    }
+
+    /**
+     * Flags every light's shadows to be redrawn
+     */
+    void markShadowsDirty()
+    {
+        shadowsDirty = true;
+    }
+
+    const QVector<BoundingSphere>& getShadowDirtyBounds()
+    {
+        return shadowDirtyBounds;
+    }
+
+    bool areShadowsDirty()
+    {
+        return shadowsDirty;
+    }
+
+    /**
+     * Called by the renderer once the shadow maps are up to date
+     */
+    void clearShadowDirtyState()
+    {
+        shadowDirtyBounds.clear();
+        shadowsDirty = false;
+    }
+
     /**
      * Adds node to scene. If node is a LightNode then it is added to a list of lights.
      * @param node
@@ -170,6 +249,13 @@ public:
     void setOutlineColor(QColor color);
 
     void cleanup();
+
+private:
+    void updateSpatialIndex();
+    void rayCastMesh(const MeshNodePtr& meshNode,
+                     const QVector3D& segStart,
+                     const QVector3D& segEnd,
+                     QList<iris::PickingResult>& hitList);
 };
 
 }
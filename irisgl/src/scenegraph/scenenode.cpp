@@ -11,20 +11,20 @@ For more information see the LICENSE file
 
 #include "scenenode.h"
 
-#include <functional>
-
 #include "animation/animation.h"
 #include "animation/animableproperty.h"
 #include "animation/keyframeanimation.h"
 #include "animation/keyframeset.h"
 #include "animation/propertyanim.h"
 #include "animation/skeletalanimation.h"
+#include "animation/skeletalanimationbinding.h"
 #include "core/property.h"
 #include "graphics/mesh.h"
 #include "graphics/skeleton.h"
 #include "math/mathhelper.h"
 #include "scene.h"
 #include "scenegraph/meshnode.h"
+#include "scenegraph/transformhierarchy.h"
 
 #include <QUuid>
 
@@ -58,6 +58,10 @@ SceneNode::SceneNode():
 
     transformDirty = true;
     hasDirtyChildren = true;
+    transformIndex = -1;
+    spatialProxy = -1;
+    spatialBoundsDirty = false;
+    animationBindingDirty = true;
 
     //keyFrameSet = KeyFrameSet::create();
     //animation = iris::Animation::create("");
@@ -76,6 +80,7 @@ QString SceneNode::getName()
 void SceneNode::setName(QString name)
 {
     this->name = name;
+    invalidateAnimationBinding();
 }
 
 long SceneNode::getNodeId()
@@ -119,6 +124,13 @@ void SceneNode::setLocalTransform(QMatrix4x4 transformMatrix)
 void SceneNode::setTransformDirty()
 {
     transformDirty = true;
+
+    // the scene's hierarchy tracks dirty ancestors itself
+    if (transformIndex >= 0 && !!scene && scene->transformHierarchy) {
+        scene->transformHierarchy->markDirty(transformIndex);
+        return;
+    }
+
     if (!!parent)
     {
         parent->setHasDirtyChildren();
@@ -157,6 +169,7 @@ QList<AnimationPtr> SceneNode::getAnimations()
 void SceneNode::setAnimation(AnimationPtr anim)
 {
     animation = anim;
+    animationBindingDirty = true;
 }
 
 AnimationPtr SceneNode::getAnimation()
@@ -236,6 +249,7 @@ void SceneNode::insertChild(int position, SceneNodePtr node, bool keepTransform)
 
     children.insert(position, node);
     node->setParent(self);
+    invalidateAnimationBinding();
     if (!!scene) {
         node->setScene(self->scene);
         //scene->addNode(node);
@@ -261,6 +275,8 @@ void SceneNode::insertChild(int position, SceneNodePtr node, bool keepTransform)
         node->scale.setY(diff.column(1).toVector3D().length());
         node->scale.setZ(diff.column(2).toVector3D().length());
     }
+
+    node->setTransformDirty();
 }
 
 void SceneNode::removeFromParent()
@@ -274,6 +290,7 @@ void SceneNode::removeChild(SceneNodePtr node)
 {
     children.removeOne(node);
     node->parent = QSharedPointer<SceneNode>(Q_NULLPTR);
+    invalidateAnimationBinding();
     node->removeFromScene();
 }
 
@@ -284,8 +301,20 @@ bool SceneNode::isRootNode()
 }
 
 void SceneNode::updateAnimation(float time)
+{
+    QVector<SkeletalAnimationJob> skeletalJobs;
+    updatePropertyAnimations(time, skeletalJobs);
+
+    // nested skeletons come after the skeletons they're in and override their pose
+    for (const auto& job : skeletalJobs) {
+        job.binding->evaluate(job.time);
+    }
+}
+
+void SceneNode::updatePropertyAnimations(float time, QVector<SkeletalAnimationJob>& skeletalJobs, bool insideSkeleton)
 {
     if (!!animation) {
+        applyAnimatedProperties(time);
 
         time = animation->getSampleTime(time);
         if (animation->hasPropertyAnim("position")) {
@@ -298,82 +327,29 @@ void SceneNode::updateAnimation(float time)
         if (animation->hasPropertyAnim("scale")) {
             scale = animation->getVector3PropertyAnim("scale")->getValue(time);
         }
+        setTransformDirty();
 
         if (animation->hasSkeletalAnimation()) {
-            QMap<QString, QMatrix4x4> skeletonSpaceMatrices;
-            // The skeleton begins at this node, the root
-
-            // recursively update the animation for each node
-            std::function<void(SkeletalAnimationPtr anim, SceneNodePtr node, QMatrix4x4 parentTransform)> animateHierarchy;
-            animateHierarchy = [&animateHierarchy, time, &skeletonSpaceMatrices](SkeletalAnimationPtr anim, SceneNodePtr node, QMatrix4x4 parentTransform)
-            {
-                // skeleton-space transform of current node
-                QMatrix4x4 skelTrans;
-                skelTrans.setToIdentity();
-
-                if (anim->boneAnimations.contains(node->name)) {
-                    auto boneAnim = anim->boneAnimations[node->name];
-
-                    node->pos = boneAnim->posKeys->getValueAt(time);
-                    node->rot = boneAnim->rotKeys->getValueAt(time).normalized();
-                    //node->scale = QVector3D(1,1,1);
-                    node->scale = boneAnim->scaleKeys->getValueAt(time);
-                }
-
-                auto localTrans = node->getLocalTransform(); //calculates the local transform matrix
-                skelTrans = parentTransform * localTrans; //skeleton space transform
-                skeletonSpaceMatrices.insert(node->name, skelTrans);
-
-                for(auto child : node->children) {
-                    animateHierarchy(anim, child, skelTrans);
-                }
-            };
-
-            QMatrix4x4 rootTransform;
-            //rootTransform.setToIdentity();
-            rootTransform = this->getLocalTransform();
-            animateHierarchy(animation->getSkeletalAnimation(), this->sharedFromThis(), rootTransform);
-
-            applyAnimationPose(this->sharedFromThis(), skeletonSpaceMatrices);
+            // the binding samples the keys into the skeleton's nodes and updates the skinned meshes' bones
+            SkeletalAnimationJob job;
+            job.binding = getAnimationBinding();
+            job.time = time;
+            job.nested = insideSkeleton;
+            skeletalJobs.append(job);
+
+            insideSkeleton = true;
         }
     }
 
     for (auto child : children) {
-        child->updateAnimation(time);
+        child->updatePropertyAnimations(time, skeletalJobs, insideSkeleton);
     }
 }
 
 void SceneNode::applyDefaultPose()
 {
-    if (!!animation) {
-    if (animation->hasSkeletalAnimation()) {
-        QMap<QString, QMatrix4x4> skeletonSpaceMatrices;
-        // The skeleton begins at this node, the root
-
-        // recursively update the animation for each node
-        std::function<void(SkeletalAnimationPtr anim, SceneNodePtr node, QMatrix4x4 parentTransform)> animateHierarchy;
-        animateHierarchy = [&animateHierarchy, &skeletonSpaceMatrices](SkeletalAnimationPtr anim, SceneNodePtr node, QMatrix4x4 parentTransform)
-        {
-            // skeleton-space transform of current node
-            QMatrix4x4 skelTrans;
-            skelTrans.setToIdentity();
-
-            auto localTrans = node->getLocalTransform(); //calculates the local transform matrix
-            skelTrans = parentTransform * localTrans; //skeleton space transform
-            skeletonSpaceMatrices.insert(node->name, skelTrans);
-
-            for(auto child : node->children) {
-                animateHierarchy(anim, child, skelTrans);
-            }
-        };
-
-        QMatrix4x4 rootTransform;
-        rootTransform.setToIdentity();
-        rootTransform = this->getLocalTransform();
-        animateHierarchy(animation->getSkeletalAnimation(), this->sharedFromThis(), rootTransform);
-
-        applyAnimationPose(this->sharedFromThis(), skeletonSpaceMatrices);
-    }
+    if (!!animation && animation->hasSkeletalAnimation()) {
+        getAnimationBinding()->applyPose();
     }
 
     for (auto child : children) {
@@ -381,26 +357,35 @@ void SceneNode::applyDefaultPose()
     }
 }
 
-void SceneNode::applyAnimationPose(SceneNodePtr node, QMap<QString, QMatrix4x4> skeletonSpaceMatrices)
+void SceneNode::invalidateAnimationBinding()
 {
-    if (skeletonSpaceMatrices.contains(node->name)) {
-        if (node->sceneNodeType == SceneNodeType::Mesh) {
-            auto meshNode = node.staticCast<MeshNode>();
-            auto mesh = meshNode->getMesh();
-            if (mesh != nullptr && mesh->hasSkeleton()) {
-                auto inverseMeshMatrix = skeletonSpaceMatrices[node->name].inverted();
-                mesh->getSkeleton()->applyAnimation(inverseMeshMatrix, skeletonSpaceMatrices);
-            }
-        }
+    animationBindingDirty = true;
+    if (!!parent) {
+        parent->invalidateAnimationBinding();
+    }
+}
+
+SkeletalAnimationBinding* SceneNode::getAnimationBinding()
+{
+    auto skelAnim = animation->getSkeletalAnimation();
+
+    if (!animationBinding) {
+        animationBinding = QSharedPointer<SkeletalAnimationBinding>(new SkeletalAnimationBinding());
     }
 
-    for (auto child : node->children) {
-        applyAnimationPose(child, skeletonSpaceMatrices);
+    if (animationBindingDirty || !animationBinding->isBoundTo(skelAnim)) {
+        animationBinding->bind(this, skelAnim);
+        animationBindingDirty = false;
     }
+
+    return animationBinding.data();
 }
 
 void SceneNode::update(float dt)
 {
+    // the scene's transform hierarchy takes care of nodes that are part of it
+    if (transformIndex >= 0) return;
+
     if (transformDirty) {
         localTransform.setToIdentity();
 
@@ -413,9 +398,18 @@ void SceneNode::update(float dt)
         } else {
             globalTransform = localTransform;
         }
+
+        transformDirty = false;
+
+        // children depend on this node's global transform
+        for (auto child : children) {
+            child->transformDirty = true;
+        }
+        hasDirtyChildren = hasChildren();
     }
 
     if (hasDirtyChildren) {
+        hasDirtyChildren = false;
         for (auto child : children) {
             child->update(dt);
         }
@@ -504,6 +498,7 @@ void SceneNode::setGlobalPos(QVector3D pos)
 {
 	if (!parent) {
 		this->pos = pos;
+		this->setTransformDirty();
 		return;
 	}
 
@@ -519,6 +514,7 @@ void SceneNode::setGlobalRot(QQuaternion rot)
 {
 	if (!parent) {
 		this->rot = rot;
+		this->setTransformDirty();
 		return;
 	}
 
@@ -576,6 +572,6 @@ SceneNodePtr SceneNode::duplicate()
     return node.staticCast<SceneNode>();
 }
 
-long SceneNode::nextId = 0;
+std::atomic<long> SceneNode::nextId(0);
 
 }
@@ -16,6 +16,8 @@ For more information see the LICENSE file
 #include <QQuaternion>
 #include <QMatrix4x4>
 #include <QVector3D>
+#include <QVector>
+#include <atomic>
 
 #include "irisglfwd.h"
 #include "physics/physicsproperties.h"
@@ -37,6 +39,9 @@ class PhysicsProperty;
 class Property;
 class Animation;
 class PropertyAnim;
+class SkeletalAnimationBinding;
+class AABB;
+struct SkeletalAnimationJob;
 typedef QSharedPointer<Animation> AnimationPtr;
 
 class SceneNode : public QEnableSharedFromThis<SceneNode>
@@ -45,12 +50,24 @@ protected:
     QList<AnimationPtr> animations;
     AnimationPtr animation;
 
+    // the active skeletal animation's bones resolved against this node's hierarchy
+    QSharedPointer<SkeletalAnimationBinding> animationBinding;
+    bool animationBindingDirty;
+
     QVector3D pos;
     QVector3D scale;
     QQuaternion rot;
 
     bool transformDirty;
     bool hasDirtyChildren;
+
+    // position in the scene's flattened transform hierarchy, -1 if it isnt in one
+    int transformIndex;
+
+    // proxy of the node's world bounds in the scene's spatial index, -1 if it isnt in it
+    int spatialProxy;
+    // set while the node is waiting for its bounds to be updated in the spatial index
+    bool spatialBoundsDirty;
 public:
     // cached local and global transform
     QMatrix4x4 localTransform;
@@ -82,6 +99,7 @@ public:
 
     friend class Renderer;
     friend class Scene;
+    friend class TransformHierarchy;
 
     // If a node is attached to parents then it inherits animations
     // It also cant have its own animation
@@ -244,13 +262,25 @@ public:
 
     /*
      * This function does multiple things:
-     * - Calculates the transformation of the objects
+     * - Calculates the transformation of the objects that aren't part of a scene
+     *   (nodes in a scene are updated by the scene's TransformHierarchy)
      * - Particle systems use this to update animations
      */
     virtual void update(float dt);
-    virtual void updateAnimation(float time);
+    void updateAnimation(float time);
+
+    /**
+     * Same as updateAnimation, except skeletal animations are only collected into skeletalJobs
+     * for the caller to sample, in depth-first order
+     */
+    void updatePropertyAnimations(float time, QVector<SkeletalAnimationJob>& skeletalJobs, bool insideSkeleton = false);
     void applyDefaultPose();
-    void applyAnimationPose(SceneNodePtr node, QMap<QString, QMatrix4x4> skeletonSpaceMatrices);
+
+    /**
+     * Flags the skeletal animation bindings of this node and its ancestors to be rebuilt
+     * Called when something a binding depends on changes: children, names or meshes
+     */
+    void invalidateAnimationBinding();
 
     /*
      * This is the function used to add render items
@@ -259,13 +289,29 @@ public:
      */
     virtual void submitRenderItems(){}
 
+    /**
+     * Gets the node's world space bounds for the scene's spatial index
+     * Returns false for nodes without any, which aren't put in the index
+     */
+    virtual bool getWorldBounds(AABB& bounds) { Q_UNUSED(bounds); return false; }
+
+protected:
+    /**
+     * Lets subclasses sample the properties they add from the active animation
+     * Called before the transform is sampled
+     */
+    virtual void applyAnimatedProperties(float time){ Q_UNUSED(time); }
+
 private:
+    SkeletalAnimationBinding* getAnimationBinding();
+
     void setParent(SceneNodePtr node);
     void setScene(ScenePtr scene);
     void removeFromScene();
 
     static long generateNodeId();
-    static long nextId;
+    // atomic since nodes are also made on the thumbnail threads
+    static std::atomic<long> nextId;
 };
 
 }
@@ -0,0 +1,153 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "transformhierarchy.h"
+#include "scenenode.h"
+#include "../math/mathhelper.h"
+
+namespace iris
+{
+
+TransformHierarchy::TransformHierarchy()
+{
+    structureDirty = true;
+}
+
+void TransformHierarchy::markDirty(int index)
+{
+    if (index < 0 || index >= dirty.size())
+        return;
+
+    dirty[index] = 1;
+
+    // parents come before their children so this stops at the first
+    // ancestor that was already flagged
+    int parent = parents[index];
+    while (parent >= 0 && !childrenDirty[parent]) {
+        childrenDirty[parent] = 1;
+        parent = parents[parent];
+    }
+}
+
+bool TransformHierarchy::update(SceneNodePtr rootNode)
+{
+    changedNodes.clear();
+    if (structureDirty)
+        rebuild(rootNode);
+
+    bool changed = false;
+    const int count = nodes.size();
+    int i = 0;
+    while (i < count) {
+        if (dirty[i]) {
+            updateSubtree(i);
+            i = subtreeEnds[i];
+            changed = true;
+        } else if (childrenDirty[i]) {
+            childrenDirty[i] = 0;
+            nodes[i]->hasDirtyChildren = false;
+            i++;
+        } else {
+            // nothing changed below this node
+            i = subtreeEnds[i];
+        }
+    }
+
+    return changed;
+}
+
+void TransformHierarchy::clear()
+{
+    nodes.clear();
+    parents.clear();
+    subtreeEnds.clear();
+    positions.clear();
+    rotations.clear();
+    scales.clear();
+    localTransforms.clear();
+    globalTransforms.clear();
+    dirty.clear();
+    childrenDirty.clear();
+    changedNodes.clear();
+
+    structureDirty = true;
+}
+
+void TransformHierarchy::rebuild(SceneNodePtr rootNode)
+{
+    clear();
+
+    if (!!rootNode)
+        addSubtree(rootNode.data(), -1);
+
+    const int count = nodes.size();
+    positions.resize(count);
+    rotations.resize(count);
+    scales.resize(count);
+    localTransforms.resize(count);
+    globalTransforms.resize(count);
+
+    // every node gets recalculated after a rebuild
+    dirty.fill(1, count);
+    childrenDirty.fill(1, count);
+
+    structureDirty = false;
+}
+
+void TransformHierarchy::addSubtree(SceneNode* node, int parentIndex)
+{
+    const int index = nodes.size();
+    node->transformIndex = index;
+
+    nodes.append(node);
+    parents.append(parentIndex);
+    subtreeEnds.append(index + 1);
+
+    for (auto& child : node->children)
+        addSubtree(child.data(), index);
+
+    subtreeEnds[index] = nodes.size();
+}
+
+void TransformHierarchy::updateSubtree(int start)
+{
+    const int end = subtreeEnds[start];
+
+    // every node in the range has a changed ancestor (or is the changed node)
+    // so only the local transforms need to be checked
+    for (int i = start; i < end; i++) {
+        auto node = nodes[i];
+
+        if (dirty[i]) {
+            positions[i] = node->pos;
+            rotations[i] = node->rot;
+            scales[i] = node->scale;
+            MathHelper::composeTransform(positions[i], rotations[i], scales[i], localTransforms[i]);
+            dirty[i] = 0;
+        }
+
+        const int parent = parents[i];
+        if (parent >= 0)
+            globalTransforms[i] = globalTransforms[parent] * localTransforms[i];
+        else
+            globalTransforms[i] = localTransforms[i];
+
+        childrenDirty[i] = 0;
+
+        node->localTransform = localTransforms[i];
+        node->globalTransform = globalTransforms[i];
+        node->transformDirty = false;
+        node->hasDirtyChildren = false;
+        changedNodes.append(node);
+    }
+}
+
+}
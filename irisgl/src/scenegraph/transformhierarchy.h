@@ -0,0 +1,104 @@
+/**************************************************************************
+This file is part of IrisGL
+http://www.irisgl.org
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef TRANSFORMHIERARCHY_H
+#define TRANSFORMHIERARCHY_H
+
+#include <QVector>
+#include <QVector3D>
+#include <QQuaternion>
+#include <QMatrix4x4>
+
+#include "../irisglfwd.h"
+
+namespace iris
+{
+
+/**
+ * Flattened copy of a scene's node hierarchy used to update transforms.
+ * Nodes are stored in depth-first order so a node's parent always comes before
+ * it and its descendants occupy the range [index, subtreeEnds[index]).
+ * This lets the update run as a single linear pass that skips clean subtrees.
+ */
+class TransformHierarchy
+{
+    // the nodes aren't owned by the hierarchy, the scene marks the structure
+    // dirty when a node is removed so they're never accessed after that
+    QVector<SceneNode*> nodes;
+    QVector<int> parents;
+    QVector<int> subtreeEnds;
+
+    QVector<QVector3D> positions;
+    QVector<QQuaternion> rotations;
+    QVector<QVector3D> scales;
+    QVector<QMatrix4x4> localTransforms;
+    QVector<QMatrix4x4> globalTransforms;
+
+    // nodes whose local transform changed
+    QVector<char> dirty;
+    // nodes with a dirty node somewhere below them
+    QVector<char> childrenDirty;
+
+    bool structureDirty;
+
+    // nodes whose global transform was recalculated by the last update
+    QVector<SceneNode*> changedNodes;
+
+public:
+    TransformHierarchy();
+
+    /**
+     * Flags the hierarchy to be rebuilt on the next update
+     * Should be called whenever nodes are added, removed or reparented
+     */
+    void markStructureDirty()
+    {
+        structureDirty = true;
+    }
+
+    /**
+     * Marks the node at index as having a changed local transform
+     * @param index the node's transformIndex
+     */
+    void markDirty(int index);
+
+    /**
+     * Recalculates the transforms of dirty nodes and their descendants
+     * Rebuilds the flattened arrays first if the structure changed
+     * Returns true if any transform was recalculated
+     */
+    bool update(SceneNodePtr rootNode);
+
+    int getNodeCount()
+    {
+        return nodes.size();
+    }
+
+    /**
+     * Nodes whose global transform changed in the last update, only valid until the
+     * hierarchy is updated or rebuilt again
+     */
+    const QVector<SceneNode*>& getChangedNodes()
+    {
+        return changedNodes;
+    }
+
+    void clear();
+
+private:
+    void rebuild(SceneNodePtr rootNode);
+    void addSubtree(SceneNode* node, int parentIndex);
+    void updateSubtree(int start);
+};
+
+}
+
+#endif // TRANSFORMHIERARCHY_H
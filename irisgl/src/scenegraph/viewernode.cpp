@@ -40,6 +40,7 @@ void ViewerNode::setViewScale(float scale)
 {
     this->viewScale = scale;
     this->scale = QVector3D(scale, scale, scale);
+    setTransformDirty();
 }
 
 float ViewerNode::getViewScale()
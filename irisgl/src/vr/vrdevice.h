@@ -123,6 +123,16 @@ public:
     QQuaternion getHeadRotation();
     QVector3D getHeadPos();
 
+    int getEyeWidth()
+    {
+        return eyeWidth;
+    }
+
+    int getEyeHeight()
+    {
+        return eyeHeight;
+    }
+
 private:
     GLuint createDepthTexture(int width,int height);
     ovrTextureSwapChain createTextureChain(ovrSession session,ovrTextureSwapChain &swapChain,int width,int height);
@@ -804,6 +804,27 @@ bool Database::updateProject(const QByteArray &sceneBlob, const QByteArray &thum
     return executeAndCheckQuery(query, "UpdateProject");
 }
 
+bool Database::updateProject(const QSqlDatabase &connection,
+                             const QString &guid,
+                             const QByteArray &sceneBlob,
+                             const QByteArray &thumbnail,
+                             QString *error)
+{
+    QSqlQuery query(connection);
+    query.prepare("UPDATE projects SET scene = ?, last_written = datetime(), thumbnail = ? WHERE guid = ?");
+    query.addBindValue(sceneBlob);
+    query.addBindValue(thumbnail);
+    query.addBindValue(guid);
+
+    // not logged here since the logger isn't safe to use from other threads
+    if (!query.exec()) {
+        if (error) *error = query.lastError().text();
+        return false;
+    }
+
+    return true;
+}
+
 bool Database::updateAssetThumbnail(const QString &guid, const QByteArray &thumbnail)
 {
 	QSqlQuery query;
@@ -2308,6 +2329,27 @@ QString Database::fetchAssetGUIDByName(const QString & name)
 	return QString();
 }
 
+// names aren't unique, the first asset found for a name is used like in fetchAssetGUIDByName
+QHash<QString, QString> Database::fetchAssetGUIDs()
+{
+	QSqlQuery query;
+	query.prepare("SELECT name, guid FROM assets WHERE project_guid = ?");
+	query.addBindValue(Globals::project->getProjectGuid());
+
+	QHash<QString, QString> guids;
+	if (query.exec()) {
+		while (query.next()) {
+			const QString name = query.value(0).toString();
+			if (!guids.contains(name)) guids.insert(name, query.value(1).toString());
+		}
+	}
+	else {
+		irisLog("There was an error fetching asset guids " + query.lastError().text());
+	}
+
+	return guids;
+}
+
 QString Database::fetchObjectMesh(const QString &guid, const int ertype, const int eetype)
 {
 	QSqlQuery query;
@@ -17,6 +17,7 @@ For more information see the LICENSE file
 #include <QSqlError>
 #include <QSqlQuery>
 #include <QJsonArray>
+#include <QHash>
 #include <QCryptographicHash>
 
 #include "../project.h"
@@ -97,6 +98,12 @@ public:
     bool renameCollection(const int &collectionId, const QString &newName);
     bool renameAsset(const QString &guid, const QString &newName);
     bool updateProject(const QByteArray &sceneBlob, const QByteArray &thumbnail);
+    // for writing from another thread, connection has to belong to that thread
+    static bool updateProject(const QSqlDatabase &connection,
+                              const QString &guid,
+                              const QByteArray &sceneBlob,
+                              const QByteArray &thumbnail,
+                              QString *error = nullptr);
     bool updateAssetThumbnail(const QString &guid, const QByteArray &thumbnail);
     bool updateAssetAsset(const QString &guid, const QByteArray &asset);
     bool updateSceneThumbnail(const QString &guid, const QByteArray &asset);
@@ -131,6 +138,7 @@ public:
     QStringList fetchAssetDependenciesByType(const QString &guid, const ModelTypes&);
     QStringList fetchAssetAndDependencies(const QString &guid);
     QString fetchAssetGUIDByName(const QString &name);
+    QHash<QString, QString> fetchAssetGUIDs();
     QString fetchObjectMesh(const QString &guid, const int ertype, const int eetype);
     QString fetchMeshObject(const QString &guid, const int ertype, const int eetype);
 
@@ -18,10 +18,12 @@ For more information see the LICENSE file
 #include <QtMath>
 #include <QStandardPaths>
 
+#include "irisgl/src/core/logger.h"
 #include "irisgl/src/graphics/forwardrenderer.h"
 #include "irisgl/src/graphics/mesh.h"
 #include "irisgl/src/graphics/rendertarget.h"
 #include "irisgl/src/graphics/texture2d.h"
+#include "irisgl/src/graphics/textureloader.h"
 #include "irisgl/src/scenegraph/cameranode.h"
 #include "irisgl/src/scenegraph/lightnode.h"
 #include "irisgl/src/scenegraph/meshnode.h"
@@ -33,56 +35,67 @@ For more information see the LICENSE file
 
 ThumbnailGenerator* ThumbnailGenerator::instance = nullptr;
 
-void RenderThread::requestThumbnail(const ThumbnailRequest &request)
-{
-    QMutexLocker locker(&requestMutex);
-    requests.append(request);
-    requestsAvailable.release();
-    locker.unlock();
-}
-
 void RenderThread::run()
 {
     this->setPriority(QThread::LowestPriority);
     context->makeCurrent(surface);
+    gl = context->versionFunctions<QOpenGLFunctions_3_2_Core>();
     initScene();
 
     renderTarget = iris::RenderTarget::create(512, 512);
     tex = iris::Texture2D::create(512, 512);
     renderTarget->addTexture(tex);
 
-    shutdown = false;
+    for (auto& readback : readbacks) {
+        gl->glGenBuffers(1, &readback.pixelBuffer);
+        gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+        gl->glBufferData(GL_PIXEL_PACK_BUFFER, 512 * 512 * 4, nullptr, GL_STREAM_READ);
+        readback.fence = nullptr;
+        readback.pending = false;
+    }
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-    while(!shutdown) {
-        requestsAvailable.acquire();
-        // the size still has to be checked because there is a case where the size
-        // of the requests isnt equal to the available locks in the semaphore i.e.
-        // when the thread needs to die but the semaphore is waiting for a lock in order
-        // to continue execution
-        if (requests.size() > 0) {
-            QMutexLocker locker(&requestMutex);
-            auto request = requests.takeFirst();
-            locker.unlock();
+    int current = 0;
 
-            prepareScene(request);
+    while (true) {
+        auto& previous = readbacks[1 - current];
 
-            scene->update(0);
-            renderer->renderSceneToRenderTarget(renderTarget, cam, true, false);
+        // don't sleep on the queue while a thumbnail is still waiting to be read back
+        ThumbnailRequest request;
+        if (!generator->takeRequest(request, !previous.pending)) {
+            if (previous.pending)
+                finishReadback(previous);
 
-            cleanupScene();
+            // the flag is checked instead of going back to the semaphore since
+            // the take above may have used up this thread's shutdown release
+            if (generator->shuttingDown())
+                break;
+            continue;
+        }
 
-            // save contents to file
-            auto img = renderTarget->toImage();
+        prepareScene(request);
 
-            auto result = new ThumbnailResult;
-            result->id			= request.id;
-            result->type		= request.type;
-            result->path		= request.path;
-            result->preview     = request.preview;
-            result->thumbnail	= img;
+        // thumbnails can't show placeholder textures
+        iris::TextureLoader::finish();
 
-            emit thumbnailComplete(result);
-        }
+        scene->update(0);
+        renderer->renderSceneToRenderTarget(renderTarget, cam, true, false);
+
+        cleanupScene();
+
+        startReadback(readbacks[current], request);
+
+        // the last thumbnail's copy had this whole render to finish in
+        if (previous.pending)
+            finishReadback(previous);
+
+        current = 1 - current;
+    }
+
+    for (auto& readback : readbacks) {
+        if (readback.pending)
+            finishReadback(readback);
+        gl->glDeleteBuffers(1, &readback.pixelBuffer);
     }
 
     // move to main thread to be cleaned up
@@ -92,6 +105,51 @@ void RenderThread::run()
     surface->moveToThread(mainThread);
 }
 
+void RenderThread::startReadback(Readback &readback, const ThumbnailRequest &request)
+{
+    renderTarget->bind();
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+    gl->glReadPixels(0, 0, renderTarget->getWidth(), renderTarget->getHeight(), GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    renderTarget->unbind();
+
+    readback.fence = gl->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    gl->glFlush();
+    readback.request = request;
+    readback.pending = true;
+}
+
+void RenderThread::finishReadback(Readback &readback)
+{
+    const int width = renderTarget->getWidth();
+    const int height = renderTarget->getHeight();
+
+    // one second, normally the copy is long done by now
+    gl->glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+    gl->glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+    readback.pending = false;
+
+    QImage img;
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixelBuffer);
+    auto pixels = (const uchar*) gl->glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, width * height * 4, GL_MAP_READ_BIT);
+    if (pixels != nullptr) {
+        // same conversion as RenderTarget::toImage, rgbSwapped copies the pixels out of the buffer
+        img = QImage(pixels, width, height, QImage::Format_ARGB32_Premultiplied).rgbSwapped().mirrored(false, true);
+        gl->glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    gl->glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    auto result = new ThumbnailResult;
+    result->id			= readback.request.id;
+    result->type		= readback.request.type;
+    result->path		= readback.request.path;
+    result->preview     = readback.request.preview;
+    result->thumbnail	= img;
+
+    generator->completeRequest(result);
+}
+
 void RenderThread::initScene()
 {
     auto gl = context->versionFunctions<QOpenGLFunctions_3_2_Core>();
@@ -155,7 +213,7 @@ void RenderThread::prepareScene(const ThumbnailRequest &request)
     auto guid = request.id;
 
     if (request.type == ThumbnailRequestType::ImportedMesh) {
-        QJsonDocument document = QJsonDocument::fromBinaryData(db->fetchAssetData(guid));
+        QJsonDocument document = QJsonDocument::fromBinaryData(request.assetData);
         QJsonObject objectHierarchy = document.object();
 
         SceneReader *reader = new SceneReader;
@@ -382,8 +440,11 @@ void RenderThread::createMaterial(QJsonObject &matObj, iris::CustomMaterialPtr m
 
 ThumbnailGenerator::ThumbnailGenerator()
 {
-    renderThread = new RenderThread();
-    renderThread->setDatabase(db);
+    db = nullptr;
+    isShuttingDown = false;
+    outstanding = 0;
+    batchCompleted = 0;
+    thumbnailsPerSecond = 0;
 
     auto curCtx = QOpenGLContext::currentContext();
     if (curCtx != Q_NULLPTR) curCtx->doneCurrent();
@@ -395,19 +456,36 @@ ThumbnailGenerator::ThumbnailGenerator()
     format.setProfile(QSurfaceFormat::CoreProfile);
     format.setSamples(1);
 
-    auto context = new QOpenGLContext();
-    context->setFormat(format);
-    context->create();
-    context->moveToThread(renderThread);
-    renderThread->context = context;
-
-    auto surface = new QOffscreenSurface();
-    surface->setFormat(context->format());
-    surface->create();
-    surface->moveToThread(renderThread);
-    renderThread->surface = surface;
+    // drivers mostly serialize work from different contexts so a few threads is plenty,
+    // they mainly keep the gpu busy while the others load meshes and textures
+    const int threadCount = qBound(1, QThread::idealThreadCount() / 2, 4);
+
+    QOpenGLContext* firstContext = nullptr;
+    for (int i = 0; i < threadCount; i++) {
+        auto renderThread = new RenderThread();
+        renderThread->generator = this;
+
+        auto context = new QOpenGLContext();
+        context->setFormat(format);
+        if (firstContext != nullptr)
+            context->setShareContext(firstContext);
+        context->create();
+        if (firstContext == nullptr)
+            firstContext = context;
+        context->moveToThread(renderThread);
+        renderThread->context = context;
+
+        auto surface = new QOffscreenSurface();
+        surface->setFormat(context->format());
+        surface->create();
+        surface->moveToThread(renderThread);
+        renderThread->surface = surface;
+
+        renderThreads.append(renderThread);
+    }
 
-    renderThread->start();
+    for (auto renderThread : renderThreads)
+        renderThread->start();
 }
 
 ThumbnailGenerator *ThumbnailGenerator::getSingleton()
@@ -423,12 +501,126 @@ void ThumbnailGenerator::requestThumbnail(ThumbnailRequestType type, QString pat
     req.path	= path;
     req.id		= id;
     req.preview = preview;
-    renderThread->requestThumbnail(req);
+
+    if (type == ThumbnailRequestType::ImportedMesh && db != nullptr)
+        req.assetData = db->fetchAssetData(id);
+
+    QMutexLocker locker(&requestMutex);
+
+    // a queued request for the same asset is updated instead of rendering it twice
+    auto key = id.isEmpty() ? path : id;
+    for (auto& queued : requests) {
+        auto queuedKey = queued.id.isEmpty() ? queued.path : queued.id;
+        if (queuedKey == key && queued.type == type && queued.preview == preview) {
+            queued = req;
+            return;
+        }
+    }
+
+    if (outstanding == 0) {
+        batchTimer.start();
+        batchCompleted = 0;
+    }
+    outstanding++;
+
+    requests.append(req);
+    requestsAvailable.release();
+}
+
+void ThumbnailGenerator::prioritize(const QStringList &ids)
+{
+    QMutexLocker locker(&requestMutex);
+    priorityIds = ids.toSet();
+}
+
+bool ThumbnailGenerator::takeRequest(ThumbnailRequest &request, bool wait)
+{
+    if (wait)
+        requestsAvailable.acquire();
+    else if (!requestsAvailable.tryAcquire())
+        return false;
+
+    QMutexLocker locker(&requestMutex);
+
+    // the size still has to be checked because shutdown releases the semaphore
+    // without adding requests so the threads can leave their loops
+    if (isShuttingDown || requests.isEmpty())
+        return false;
+
+    int index = 0;
+    if (!priorityIds.isEmpty()) {
+        for (int i = 0; i < requests.size(); i++) {
+            if (priorityIds.contains(requests[i].id)) {
+                index = i;
+                break;
+            }
+        }
+    }
+
+    request = requests.takeAt(index);
+    return true;
+}
+
+void ThumbnailGenerator::completeRequest(ThumbnailResult *result)
+{
+    bool batchDone;
+    int count;
+    qint64 elapsed;
+    float perSecond;
+
+    {
+        QMutexLocker locker(&requestMutex);
+        outstanding--;
+        batchCompleted++;
+
+        elapsed = batchTimer.elapsed();
+        if (elapsed > 0)
+            thumbnailsPerSecond = batchCompleted * 1000.0f / elapsed;
+
+        batchDone = outstanding == 0;
+        count = batchCompleted;
+        perSecond = thumbnailsPerSecond;
+    }
+
+    if (batchDone) {
+        QMetaObject::invokeMethod(this, "reportBatch", Qt::QueuedConnection,
+                                  Q_ARG(int, count), Q_ARG(qint64, elapsed), Q_ARG(float, perSecond));
+    }
+
+    emit thumbnailComplete(result);
+}
+
+void ThumbnailGenerator::reportBatch(int count, qint64 elapsed, float perSecond)
+{
+    irisLog(QString("Thumbnails: %1 in %2 ms, %3 per second").arg(count).arg(elapsed).arg(perSecond));
+}
+
+bool ThumbnailGenerator::shuttingDown()
+{
+    QMutexLocker locker(&requestMutex);
+    return isShuttingDown;
+}
+
+float ThumbnailGenerator::getThumbnailsPerSecond()
+{
+    QMutexLocker locker(&requestMutex);
+    return thumbnailsPerSecond;
+}
+
+void ThumbnailGenerator::setDatabase(Database *db)
+{
+    this->db = db;
 }
 
 void ThumbnailGenerator::shutdown()
 {
-    renderThread->shutdown = true;
-    renderThread->requestsAvailable.release();// release 1 so the thread's main loop continues;
-    renderThread->wait();
-}
\ No newline at end of file
+    {
+        QMutexLocker locker(&requestMutex);
+        isShuttingDown = true;
+    }
+
+    // release one per thread so each thread's main loop continues
+    requestsAvailable.release(renderThreads.size());
+    for (auto renderThread : renderThreads)
+        renderThread->wait();
+}
@@ -25,6 +25,8 @@ For more information see the LICENSE file
 #include <QSemaphore>
 #include <QImage>
 #include <QJsonObject>
+#include <QElapsedTimer>
+#include <QSet>
 
 #include "core/database/database.h"
 
@@ -41,6 +43,9 @@ struct ThumbnailRequest
     QString path;
     QString id;
     bool preview;
+    // the asset's blob for ImportedMesh requests, read by requestThumbnail since
+    // database connections can't be used from the render threads
+    QByteArray assetData;
 };
 
 struct ThumbnailResult
@@ -52,6 +57,8 @@ struct ThumbnailResult
     QImage thumbnail;
 };
 
+class ThumbnailGenerator;
+
 class RenderThread : public QThread
 {
     Q_OBJECT
@@ -72,53 +79,103 @@ public:
     iris::CameraNodePtr cam;
     iris::CustomMaterialPtr material;
 
-    QMutex requestMutex;
-    QList<ThumbnailRequest> requests;
-    QSemaphore requestsAvailable;
-
 	iris::SceneSource *ssource;
-    bool shutdown;
+
+    ThumbnailGenerator* generator;
 
     void run() override;
     void initScene();
     void cleanupScene();
-    void requestThumbnail(const ThumbnailRequest& request);
     void prepareScene(const ThumbnailRequest& request);
 
 	void createMaterial(QJsonObject &matObj, iris::CustomMaterialPtr mat);
 
-    Database *db;
-    void setDatabase(Database *db) {
-        this->db = db;
-    }
-
-signals:
-    void thumbnailComplete(ThumbnailResult* result);
-
 private:
+    // a thumbnail being copied into a pixel buffer, the render thread moves on to the next
+    // request while the copy finishes and only maps the buffer after that
+    struct Readback
+    {
+        GLuint pixelBuffer;
+        GLsync fence;
+        bool pending;
+        ThumbnailRequest request;
+    };
+
+    QOpenGLFunctions_3_2_Core* gl;
+    Readback readbacks[2];
+
+    void startReadback(Readback& readback, const ThumbnailRequest& request);
+    void finishReadback(Readback& readback);
+
     float getBoundingRadius(iris::SceneNodePtr node);
     void getBoundingSpheres(iris::SceneNodePtr node, QList<iris::BoundingSphere>& spheres);
 };
 
+/**
+ * Renders thumbnails on a few worker threads, each with its own context and scene
+ * Requests for an id that's already queued are merged, and ids passed to prioritize
+ * are rendered before the rest of the queue
+ */
 // http://doc.qt.io/qt-5/qtquick-scenegraph-textureinthread-threadrenderer-cpp.html
-class ThumbnailGenerator
+class ThumbnailGenerator : public QObject
 {
+    Q_OBJECT
+
+    friend class RenderThread;
+
 public:
-    RenderThread* renderThread;
+    QList<RenderThread*> renderThreads;
     static ThumbnailGenerator* getSingleton();
     void requestThumbnail(ThumbnailRequestType type, QString path, QString id = "", bool preview = false);
 
+    /**
+     * Moves the queued requests for these ids to the front, e.g. the items visible in the asset view
+     * Replaces the ids given by the last call
+     */
+    void prioritize(const QStringList& ids);
+
     // must be called to properly shutdown ui components
     void shutdown();
 
     Database *db;
-    void setDatabase(Database *db) {
-        this->db = db;
-    }
+    void setDatabase(Database *db);
+
+    /**
+     * Thumbnails finished per second over the current or last batch of requests
+     * A batch starts when a request comes in with nothing queued and ends once the queue empties
+     */
+    float getThumbnailsPerSecond();
+
+signals:
+    // emitted from the render threads
+    void thumbnailComplete(ThumbnailResult* result);
+
+private slots:
+    // logs the rate of a batch that just drained, queued to the main thread
+    // since the logger isn't safe to use from the render threads
+    void reportBatch(int count, qint64 elapsed, float perSecond);
 
 private:
 	static ThumbnailGenerator* instance;
 	ThumbnailGenerator();
+
+    // blocks until there's a request unless wait is false, returns false when there's
+    // nothing to take or the generator is shutting down
+    bool takeRequest(ThumbnailRequest& request, bool wait);
+    void completeRequest(ThumbnailResult* result);
+    bool shuttingDown();
+
+    QMutex requestMutex;
+    QList<ThumbnailRequest> requests;
+    QSemaphore requestsAvailable;
+    QSet<QString> priorityIds;
+    bool isShuttingDown;
+
+    // requests that are queued or being rendered
+    int outstanding;
+    int batchCompleted;
+    QElapsedTimer batchTimer;
+    float thumbnailsPerSecond;
 };
 
 #endif // THUMBNAILGENERATOR_H
@@ -494,6 +494,7 @@ iris::LightNodePtr SceneReader::createLight(QJsonObject& nodeObj)
     auto res = qBound(512, nodeObj["shadowSize"].toInt(1024), 4096);
     shadowMap->setResolution(res);
     shadowMap->shadowType = evalShadowMapType(nodeObj["shadowType"].toString());
+    shadowMap->setCascadeCount(nodeObj["shadowCascades"].toInt(3));
 
     //TODO: move this to the sceneview widget or somewhere more appropriate
     if (lightNode->lightType == iris::LightType::Directional) {
@@ -531,6 +532,8 @@ iris::ParticleSystemNodePtr SceneReader::createParticleSystem(QJsonObject& nodeO
     particleNode->setLife((float) nodeObj["lifeLength"].toDouble(1.0f));
     particleNode->setName(nodeObj["name"].toString());
     particleNode->setSpeed((float) nodeObj["speed"].toDouble(1.0f));
+    if (nodeObj["simulationMode"].toString() == "gpu")
+        particleNode->setSimulationMode(iris::ParticleSimulationMode::Gpu);
 
     QString textureStr = QDir(assetDirectory).filePath(handle->fetchAsset(nodeObj["texture"].toString()).name);
 
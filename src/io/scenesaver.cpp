@@ -0,0 +1,129 @@
+/**************************************************************************
+This file is part of JahshakaVR, VR Authoring Toolkit
+http://www.jahshaka.com
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#include "scenesaver.h"
+
+#include <QBuffer>
+#include <QJsonDocument>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QtConcurrent/QtConcurrent>
+
+#include "../constants.h"
+#include "../core/database/database.h"
+#include "../irisgl/src/core/logger.h"
+
+// only one save runs at a time so the worker's connection name can be fixed
+#define SCENE_SAVER_CONNECTION "SceneSaver"
+
+SceneSaver::SceneSaver(QObject *parent) : QObject(parent)
+{
+    finished = true;
+    hasPendingJob = false;
+
+    connect(&watcher, &QFutureWatcher<SaveResult>::finished, this, &SceneSaver::finish);
+}
+
+SceneSaver::~SceneSaver()
+{
+    waitForFinished();
+}
+
+void SceneSaver::save(const QString &databasePath,
+                      const QString &projectGuid,
+                      const QJsonObject &sceneObject,
+                      const QImage &thumbnail)
+{
+    SaveJob job;
+    job.databasePath = databasePath;
+    job.projectGuid = projectGuid;
+    job.sceneObject = sceneObject;
+    job.thumbnail = thumbnail;
+
+    if (!finished) {
+        pendingJob = job;
+        hasPendingJob = true;
+        return;
+    }
+
+    start(job);
+}
+
+void SceneSaver::waitForFinished()
+{
+    // finish() starts the pending job if there is one so keep going until nothing is left
+    while (!finished) {
+        future.waitForFinished();
+        finish();
+    }
+}
+
+bool SceneSaver::isSaving() const
+{
+    return !finished;
+}
+
+void SceneSaver::start(const SaveJob &job)
+{
+    finished = false;
+    future = QtConcurrent::run(&SceneSaver::write, job);
+    watcher.setFuture(future);
+}
+
+void SceneSaver::finish()
+{
+    // the watcher's signal can come after waitForFinished already handled the result
+    if (finished || !future.isFinished()) return;
+    finished = true;
+
+    auto result = future.result();
+    if (result.success) {
+        emit saved(result.projectGuid, result.thumbnail);
+    } else {
+        irisLog(QString("Failed to save the scene! %1").arg(result.error));
+    }
+
+    if (hasPendingJob) {
+        hasPendingJob = false;
+        start(pendingJob);
+        pendingJob = SaveJob();
+    }
+}
+
+SceneSaver::SaveResult SceneSaver::write(const SaveJob &job)
+{
+    SaveResult result;
+    result.projectGuid = job.projectGuid;
+    result.success = false;
+
+    QBuffer buffer(&result.thumbnail);
+    buffer.open(QIODevice::WriteOnly);
+    job.thumbnail.save(&buffer, "PNG");
+
+    auto sceneBlob = QJsonDocument(job.sceneObject).toBinaryData();
+
+    // connections can only be used from the thread that made them, this one is
+    // removed before returning so every save opens its own
+    {
+        auto db = QSqlDatabase::addDatabase(Constants::DB_DRIVER, SCENE_SAVER_CONNECTION);
+        db.setDatabaseName(job.databasePath);
+
+        if (db.open()) {
+            result.success = Database::updateProject(db, job.projectGuid, sceneBlob, result.thumbnail, &result.error);
+            db.close();
+        } else {
+            result.error = db.lastError().text();
+        }
+    }
+    QSqlDatabase::removeDatabase(SCENE_SAVER_CONNECTION);
+
+    return result;
+}
@@ -0,0 +1,84 @@
+/**************************************************************************
+This file is part of JahshakaVR, VR Authoring Toolkit
+http://www.jahshaka.com
+Copyright (c) 2016  GPLv3 Jahshaka LLC <coders@jahshaka.com>
+
+This is free software: you may copy, redistribute
+and/or modify it under the terms of the GPLv3 License
+
+For more information see the LICENSE file
+*************************************************************************/
+
+#ifndef SCENESAVER_H
+#define SCENESAVER_H
+
+#include <QObject>
+#include <QImage>
+#include <QJsonObject>
+#include <QFuture>
+#include <QFutureWatcher>
+
+/**
+ * Writes scene snapshots to the project database on a worker thread
+ * The main thread only builds the scene's json and renders the thumbnail, converting
+ * the json to binary, encoding the thumbnail and the sql update happen on the worker
+ * with its own database connection
+ *
+ * One save runs at a time, a snapshot queued while one is running replaces any
+ * snapshot that was already waiting since only the newest one needs to be written
+ */
+class SceneSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SceneSaver(QObject *parent = nullptr);
+    ~SceneSaver();
+
+    void save(const QString &databasePath,
+              const QString &projectGuid,
+              const QJsonObject &sceneObject,
+              const QImage &thumbnail);
+
+    // blocks until every queued snapshot is written, call before reading the scene
+    // back from the database or closing it
+    void waitForFinished();
+
+    bool isSaving() const;
+
+signals:
+    // emitted on the main thread once a snapshot is written, thumbnail is png encoded
+    void saved(const QString &projectGuid, const QByteArray &thumbnail);
+
+private:
+    struct SaveJob
+    {
+        QString databasePath;
+        QString projectGuid;
+        QJsonObject sceneObject;
+        QImage thumbnail;
+    };
+
+    struct SaveResult
+    {
+        QString projectGuid;
+        QByteArray thumbnail;
+        bool success;
+        QString error;
+    };
+
+    static SaveResult write(const SaveJob &job);
+
+    void start(const SaveJob &job);
+    void finish();
+
+    QFuture<SaveResult> future;
+    QFutureWatcher<SaveResult> watcher;
+    // set once the running save's result was handled, either by the watcher or waitForFinished
+    bool finished;
+
+    SaveJob pendingJob;
+    bool hasPendingJob;
+};
+
+#endif // SCENESAVER_H
@@ -43,6 +43,8 @@ For more information see the LICENSE file
 #include "../core/database/database.h"
 
 Database *SceneWriter::handle = 0;
+QHash<QString, QString> SceneWriter::assetGuids;
+bool SceneWriter::assetGuidsFetched = false;
 
 void SceneWriter::writeScene(QString filePath,
                              iris::ScenePtr scene,
@@ -72,6 +74,14 @@ QByteArray SceneWriter::getSceneObject(QString projectPath,
                                        iris::ScenePtr scene,
                                        iris::PostProcessManagerPtr postMan,
                                        EditorData *editorData)
+{
+    return QJsonDocument(getSceneSnapshot(projectPath, scene, postMan, editorData)).toBinaryData();
+}
+
+QJsonObject SceneWriter::getSceneSnapshot(QString projectPath,
+                                          iris::ScenePtr scene,
+                                          iris::PostProcessManagerPtr postMan,
+                                          EditorData *editorData)
 {
     dir = projectPath;
     QJsonObject projectObj;
@@ -89,7 +99,7 @@ QByteArray SceneWriter::getSceneObject(QString projectPath,
 
     //qDebug() << projectObj;
 
-    return QJsonDocument(projectObj).toBinaryData();
+    return projectObj;
 }
 
 void SceneWriter::writeScene(QJsonObject& projectObj, iris::ScenePtr scene)
@@ -125,10 +135,19 @@ void SceneWriter::writeScene(QJsonObject& projectObj, iris::ScenePtr scene)
 	
 
 
+    // fetch every asset guid up front instead of a query per texture
+    if (handle) {
+        assetGuids = handle->fetchAssetGUIDs();
+        assetGuidsFetched = true;
+    }
+
     QJsonObject rootNodeObj;
     writeSceneNode(rootNodeObj,scene->getRootNode());
     sceneObj["rootNode"] = rootNodeObj;
 
+    assetGuids.clear();
+    assetGuidsFetched = false;
+
     projectObj["scene"] = sceneObj;
 }
 
@@ -376,8 +395,9 @@ void SceneWriter::writeParticleData(QJsonObject& sceneNodeObject, iris::Particle
     sceneNodeObject["blendMode"]            = node->useAdditive;
     sceneNodeObject["lifeLength"]           = node->lifeLength;
     sceneNodeObject["speed"]                = node->speed;
+    sceneNodeObject["simulationMode"]       = node->getSimulationMode() == iris::ParticleSimulationMode::Gpu ? "gpu" : "cpu";
 	sceneNodeObject["visible"]				= node->isVisible();
-    sceneNodeObject["texture"]              = handle->fetchAssetGUIDByName(QFileInfo(node->texture->getSource()).fileName());
+    sceneNodeObject["texture"]              = fetchAssetGuid(QFileInfo(node->texture->getSource()).fileName());
 }
 
 void SceneWriter::writeSceneNodeMaterial(QJsonObject& matObj, iris::CustomMaterialPtr mat, bool relative)
@@ -401,12 +421,18 @@ void SceneWriter::writeSceneNodeMaterial(QJsonObject& matObj, iris::CustomMateri
         if (prop->type == iris::PropertyType::Texture) {
 			//matObj[prop->name] = relative ? getRelativePath(prop->getValue().toString()) : QFileInfo(prop->getValue().toString()).fileName();
 			matObj[prop->name] = relative
-									? handle->fetchAssetGUIDByName(QFileInfo(prop->getValue().toString()).fileName())
+									? fetchAssetGuid(QFileInfo(prop->getValue().toString()).fileName())
 									: getRelativePath(prop->getValue().toString());
         }
     }
 }
 
+QString SceneWriter::fetchAssetGuid(const QString &name)
+{
+    if (assetGuidsFetched) return assetGuids.value(name);
+    return handle->fetchAssetGUIDByName(name);
+}
+
 QJsonObject SceneWriter::jsonColor(QColor color)
 {
     QJsonObject colObj;
@@ -458,6 +484,7 @@ void SceneWriter::writeLightData(QJsonObject& sceneNodeObject,iris::LightNodePtr
     sceneNodeObject["shadowType"] = evalShadowTypeName(shadowMap->shadowType);
     sceneNodeObject["shadowSize"] = shadowMap->resolution;
     sceneNodeObject["shadowBias"] = shadowMap->bias;
+    sceneNodeObject["shadowCascades"] = shadowMap->cascadeCount;
 	sceneNodeObject["visible"] = lightNode->isVisible();
 }
 
@@ -19,6 +19,7 @@ For more information see the LICENSE file
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonDocument>
+#include <QHash>
 //#include "../irisgl/src/core/scenenode.h"
 #include "../irisgl/src/scenegraph/lightnode.h"
 #include "../irisgl/src/animation/keyframeanimation.h"
@@ -39,6 +40,12 @@ public:
                               iris::ScenePtr scene,
                               iris::PostProcessManagerPtr postMan,
                               EditorData *editorData);
+    // same as getSceneObject but leaves converting to binary to the caller
+    // so it can be done off the main thread
+    QJsonObject getSceneSnapshot(QString projectPath,
+                                 iris::ScenePtr scene,
+                                 iris::PostProcessManagerPtr postMan,
+                                 EditorData *editorData);
 
 public:
     void writeScene(QJsonObject& projectObj, iris::ScenePtr scene);
@@ -60,6 +67,12 @@ public:
 	static QString getLightNodeTypeName(iris::LightType lightType);
 	static QString getKeyTangentTypeName(iris::TangentType tangentType);
 	static QString getKeyHandleModeName(iris::HandleMode handleMode);
+
+private:
+    // asset guids by name, only filled while a whole scene is being written
+    static QHash<QString, QString> assetGuids;
+    static bool assetGuidsFetched;
+    static QString fetchAssetGuid(const QString &name);
 };
 
 #endif // SCENEWRITER_H
@@ -103,6 +103,7 @@ For more information see the LICENSE file
 
 #include "io/scenewriter.h"
 #include "io/scenereader.h"
+#include "io/scenesaver.h"
 
 #include "constants.h"
 #include <src/io/materialreader.hpp>
@@ -541,6 +542,9 @@ void MainWindow::closeEvent(QCloseEvent *event)
 	settings->setValue("geometry", saveGeometry());
 	settings->setValue("windowState", saveState());
 
+	// the save can carry on while the dialog is up, it has to be done before quitting
+	sceneSaver->waitForFinished();
+
     ThumbnailGenerator::getSingleton()->shutdown();
 }
 
@@ -581,6 +585,11 @@ void MainWindow::setupProjectDB()
 	if (db->initializeDatabase(path)) {
 		db->createAllTables();
 	}
+
+	sceneSaver = new SceneSaver(this);
+	connect(sceneSaver, &SceneSaver::saved, this, [this](const QString &guid, const QByteArray &thumb) {
+		pmContainer->updateTile(guid, thumb);
+	});
 }
 
 void MainWindow::setupUndoRedo()
@@ -753,21 +762,18 @@ void MainWindow::switchSpace(WindowSpaces space)
     }
 }
 
+// only the scene's json and the screenshot are made here, the rest is done by sceneSaver
 void MainWindow::saveScene(const QString &filename, const QString &projectPath)
 {
 	SceneWriter writer;
-	auto sceneObject = writer.getSceneObject(projectPath,
-											 this->scene,
-											 sceneView->getRenderer()->getPostProcessManager(),
-											 sceneView->getEditorData());
+	auto sceneObject = writer.getSceneSnapshot(projectPath,
+											   this->scene,
+											   sceneView->getRenderer()->getPostProcessManager(),
+											   sceneView->getEditorData());
 
 	auto img = sceneView->takeScreenshot(Constants::TILE_SIZE * 2);
-	QByteArray thumb;
-	QBuffer buffer(&thumb);
-	buffer.open(QIODevice::WriteOnly);
-	img.save(&buffer, "PNG");
 
-	db->updateProject(sceneObject, thumb);
+	sceneSaver->save(db->getDb().databaseName(), Globals::project->getProjectGuid(), sceneObject, img);
 
 	undoStackCount = UiManager::getUndoStackCount();
 }
@@ -775,19 +781,14 @@ void MainWindow::saveScene(const QString &filename, const QString &projectPath)
 void MainWindow::saveScene()
 {
 	SceneWriter writer;
-    auto blob = writer.getSceneObject(Globals::project->getProjectFolder(),
-                                      scene,
-                                      sceneView->getRenderer()->getPostProcessManager(),
-                                      sceneView->getEditorData());
+    auto sceneObject = writer.getSceneSnapshot(Globals::project->getProjectFolder(),
+                                               scene,
+                                               sceneView->getRenderer()->getPostProcessManager(),
+                                               sceneView->getEditorData());
 
     auto img = sceneView->takeScreenshot(Constants::TILE_SIZE * 2);
-    QByteArray thumb;
-    QBuffer buffer(&thumb);
-    buffer.open(QIODevice::WriteOnly);
-    img.save(&buffer, "PNG");
 
-    db->updateProject(blob, thumb);
-	pmContainer->updateTile(Globals::project->getProjectGuid(), thumb);
+    sceneSaver->save(db->getDb().databaseName(), Globals::project->getProjectGuid(), sceneObject, img);
 
 	undoStackCount = UiManager::getUndoStackCount();
 }
@@ -797,6 +798,8 @@ void MainWindow::openProject(bool playMode)
     removeScene();
     sceneView->makeCurrent();
 
+    sceneSaver->waitForFinished();
+
     std::unique_ptr<SceneReader> reader(new SceneReader);
 	reader->setDatabaseHandle(db);
 
@@ -858,6 +861,8 @@ void MainWindow::closeProject()
             if (settings->getValue("auto_save", true).toBool()) saveScene();
         }
 
+        sceneSaver->waitForFinished();
+
         scene->getPhysicsEnvironment()->destroyPhysicsWorld();
 
         //UiManager::stopPhysicsSimulation();
@@ -2117,6 +2122,8 @@ void MainWindow::exportSceneAsZip()
 
     if (filePath.isEmpty() || filePath.isNull()) return;
     if (!!scene) saveScene();
+    // the export copies the scene from the database
+    sceneSaver->waitForFinished();
 
     // Maybe in the future one could add a way to using an in memory database
     // and saving that as a blob which can be put into the zip as bytes (iKlsR)
@@ -3099,6 +3106,9 @@ void MainWindow::showProjectManagerInternal()
         }
     }
 
+    // the desktop reads the projects' thumbnails from the database
+    sceneSaver->waitForFinished();
+
     if (UiManager::isScenePlaying) enterEditMode();
     hide();
     pmContainer->populateDesktop(true);
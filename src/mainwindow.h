@@ -121,6 +121,7 @@ enum class Widget
 #include "irisgl/src/graphics/texture2d.h"
 
 class Database;
+class SceneSaver;
 class MainWindow : public QMainWindow
 {
     Q_OBJECT
@@ -424,6 +425,7 @@ private:
     QActionGroup* cameraGroup;
 
     Database *db;
+    SceneSaver *sceneSaver;
     ProjectManager *pmContainer;
 
     QUndoStack* undoStack;
@@ -29,6 +29,7 @@ For more information see the LICENSE file
 #include <QPointer>
 #include <QProgressDialog>
 #include <QProcess>
+#include <QScrollBar>
 #include <QTemporaryDir>
 #include <QComboBox>
 
@@ -116,8 +117,11 @@ AssetWidget::AssetWidget(Database *handle, QWidget *parent) : QWidget(parent), u
 	connect(ui->importBtn, SIGNAL(pressed()), SLOT(importAssetB()));
 
 	// The signal will be emitted from another thread (Nick)
-	connect(ThumbnailGenerator::getSingleton()->renderThread,   SIGNAL(thumbnailComplete(ThumbnailResult*)),
-		    this,                                               SLOT(onThumbnailResult(ThumbnailResult*)));
+	connect(ThumbnailGenerator::getSingleton(),   SIGNAL(thumbnailComplete(ThumbnailResult*)),
+		    this,                                 SLOT(onThumbnailResult(ThumbnailResult*)));
+
+	// thumbnails of the items in view are rendered first
+	connect(ui->assetView->verticalScrollBar(), SIGNAL(valueChanged(int)), SLOT(prioritizeVisibleThumbnails()));
 
 	breadCrumbLayout = new QHBoxLayout;
 	breadCrumbLayout->setSpacing(0);
@@ -631,6 +635,20 @@ void AssetWidget::updateAssetView(const QString &path, int filter, bool showDepe
     }
 
     goUpOneControl->setEnabled(false);
+    prioritizeVisibleThumbnails();
+}
+
+void AssetWidget::prioritizeVisibleThumbnails()
+{
+    QStringList ids;
+    auto viewRect = ui->assetView->viewport()->rect();
+    for (int i = 0; i < ui->assetView->count(); i++) {
+        auto item = ui->assetView->item(i);
+        if (!item->isHidden() && ui->assetView->visualItemRect(item).intersects(viewRect))
+            ids.append(item->data(MODEL_GUID_ROLE).toString());
+    }
+
+    ThumbnailGenerator::getSingleton()->prioritize(ids);
 }
 
 void AssetWidget::updateAssetContentsView(const QString &guid)
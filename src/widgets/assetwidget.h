@@ -295,6 +295,7 @@ protected slots:
     void importJafAssets(const QList<directory_tuple>&);
 
     void onThumbnailResult(ThumbnailResult* result);
+    void prioritizeVisibleThumbnails();
 
 private:
     Ui::AssetWidget *ui;
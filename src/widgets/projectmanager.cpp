@@ -32,6 +32,7 @@ For more information see the LICENSE file
 
 #include "irisgl/src/assimp/include/assimp/Importer.hpp"
 #include "irisgl/src/core/irisutils.h"
+#include "irisgl/src/graphics/meshcache.h"
 #include "irisgl/src/materials/custommaterial.h"
 #include "irisgl/src/zip/zip.h"
 
@@ -532,6 +533,12 @@ ModelData ProjectManager::loadAiSceneFromModel(const QPair<QString, QString> ass
 	//file.open(QFile::ReadOnly);
 	//auto data = file.readAll();
 
+	// the scene reader gets the meshes from the cache, the aiScene is imported later
+	// only if something like dragging the model into the scene asks for it
+	if (iris::MeshCache::isValid(asset.first)) {
+		return ModelData(asset.first, asset.second, nullptr);
+	}
+
 	Assimp::Importer *importer = new Assimp::Importer;
 	 //const aiScene *scene = importer->ReadFile(asset.first.toStdString().c_str(), aiProcessPreset_TargetRealtime_Fast);
 	//const aiScene *scene = sceneSource->importer.ReadFileFromMemory((void*)data.data(),
@@ -46,6 +46,7 @@ EmitterPropertyWidget::EmitterPropertyWidget()
     dissipate       = this->addCheckBox("Dissipate Over Time", false);
     dissipateInv    = this->addCheckBox("Invert dissipation", false);
     useAdditive     = this->addCheckBox("Use Additive Blending", false);
+    gpuSimulation   = this->addCheckBox("Simulate On GPU", false);
     blendMode       = this->addComboBox("Col Box");
     preset          = this->addComboBox("Particle Preset");
 
@@ -74,6 +75,7 @@ EmitterPropertyWidget::EmitterPropertyWidget()
     connect(dissipate,      SIGNAL(valueChanged(bool)),  SLOT(onDissipateChanged(bool)));
     connect(dissipateInv,   SIGNAL(valueChanged(bool)),  SLOT(onDissipateInvChanged(bool)));
     connect(useAdditive,    SIGNAL(valueChanged(bool)),  SLOT(onAdditiveChanged(bool)));
+    connect(gpuSimulation,  SIGNAL(valueChanged(bool)),  SLOT(onGpuSimulationChanged(bool)));
     connect(billboardImage, SIGNAL(valueChanged(QString)),
             this,           SLOT(onBillboardImageChanged(QString)));
 }
@@ -124,6 +126,7 @@ void EmitterPropertyWidget::setSceneNode(QSharedPointer<iris::SceneNode> sceneNo
         useAdditive->setValue(ps->useAdditive);
         dissipate->setValue(ps->dissipate);
         dissipateInv->setValue(ps->dissipateInv);
+        gpuSimulation->setValue(ps->getSimulationMode() == iris::ParticleSimulationMode::Gpu);
 
         if (ps->texture) {
             billboardImage->setTexture(ps->texture->getSource());
@@ -223,4 +226,11 @@ void EmitterPropertyWidget::onAdditiveChanged(bool val)
     }
 }
 
+void EmitterPropertyWidget::onGpuSimulationChanged(bool val)
+{
+    if (!!this->ps) {
+        ps->setSimulationMode(val ? iris::ParticleSimulationMode::Gpu : iris::ParticleSimulationMode::Cpu);
+    }
+}
+
 
@@ -58,6 +58,7 @@ protected slots:
     void onDissipateChanged(bool val);
     void onDissipateInvChanged(bool val);
     void onAdditiveChanged(bool val);
+    void onGpuSimulationChanged(bool val);
     void onBillboardImageChanged(QString);
 
 private:
@@ -78,6 +79,7 @@ private:
     CheckBoxWidget* dissipate;
     CheckBoxWidget* dissipateInv;
     CheckBoxWidget* useAdditive;
+    CheckBoxWidget* gpuSimulation;
     ComboBoxWidget* blendMode;
 
     Database *db;
@@ -43,6 +43,11 @@ LightPropertyWidget::LightPropertyWidget(QWidget* parent):
     shadowSize->addItem("1024");
     shadowSize->addItem("2048");
     shadowSize->addItem("4096");
+    shadowCascades = this->addComboBox("Shadow Cascades");
+    shadowCascades->addItem("1");
+    shadowCascades->addItem("2");
+    shadowCascades->addItem("3");
+    shadowCascades->addItem("4");
     //shadowBias = this->addFloatValueSlider("Shadow Bias",0,1);
 
 	shadowAlpha = this->addFloatValueSlider("Shadow Transparency", 0, 1.f);
@@ -62,6 +67,7 @@ LightPropertyWidget::LightPropertyWidget(QWidget* parent):
 
     connect(shadowType, SIGNAL(currentIndexChanged(QString)), this, SLOT(shadowTypeChanged(QString)));
     connect(shadowSize, SIGNAL(currentIndexChanged(QString)), this, SLOT(shadowSizeChanged(QString)));
+    connect(shadowCascades, SIGNAL(currentIndexChanged(QString)), this, SLOT(shadowCascadesChanged(QString)));
     //connect(shadowBias, SIGNAL(valueChanged(float)), this, SLOT(shadowBiasChanged(float)));
 }
 
@@ -92,6 +98,7 @@ void LightPropertyWidget::setSceneNode(QSharedPointer<iris::SceneNode> sceneNode
 
         shadowSize->setCurrentItem(QString("%1").arg(lightNode->shadowMap->resolution));
         shadowType->setCurrentItem(evalShadowTypeName(lightNode->shadowMap->shadowType));
+        shadowCascades->setCurrentItem(QString("%1").arg(lightNode->shadowMap->cascadeCount));
         //shadowBias->setValue(lightNode->shadowMap->bias);
 
         // hide shadow params for point lights
@@ -108,6 +115,12 @@ void LightPropertyWidget::setSceneNode(QSharedPointer<iris::SceneNode> sceneNode
 			shadowAlpha->show();
             //shadowBias->show();
         }
+
+        // only directional lights are split into cascades
+        if (lightNode->getLightType()==iris::LightType::Directional)
+            shadowCascades->show();
+        else
+            shadowCascades->hide();
     }
     else
     {
@@ -157,6 +170,11 @@ void LightPropertyWidget::shadowSizeChanged(QString size)
     lightNode->shadowMap->setResolution(res);
 }
 
+void LightPropertyWidget::shadowCascadesChanged(QString count)
+{
+    lightNode->shadowMap->setCascadeCount(count.toInt());
+}
+
 void LightPropertyWidget::shadowBiasChanged(float bias)
 {
     lightNode->shadowMap->bias = bias;
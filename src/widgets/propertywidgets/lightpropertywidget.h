@@ -73,6 +73,7 @@ protected slots:
 
     void shadowTypeChanged(QString name);
     void shadowSizeChanged(QString size);
+    void shadowCascadesChanged(QString count);
 	void shadowBiasChanged(float bias);
 
 	void shadowColorChanged(QColor color);
@@ -98,6 +99,7 @@ private:
 
     ComboBoxWidget* shadowType;
     ComboBoxWidget* shadowSize;
+    ComboBoxWidget* shadowCascades;
     HFloatSliderWidget* shadowBias;
 };
 
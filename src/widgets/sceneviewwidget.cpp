@@ -1290,6 +1290,20 @@ void SceneViewWidget::doScenePicking(const QSharedPointer<iris::SceneNode>& scen
                                      const QVector3D& segEnd,
                                      QList<PickingResult>& hitList)
 {
+    // only the closest hit is used when picking from the root so the scene's bvh can be used
+    if (sceneNode == scene->getRootNode()) {
+        iris::PickingResult hit;
+        if (scene->rayCastClosest(segStart, segEnd, hit)) {
+            PickingResult pick;
+            pick.hitNode = hit.hitNode;
+            pick.hitPoint = hit.hitPoint;
+            pick.distanceFromCameraSqrd = (hit.hitPoint - editorCam->getGlobalPosition()).lengthSquared();
+
+            hitList.append(pick);
+        }
+        return;
+    }
+
     if ((sceneNode->getSceneNodeType() == iris::SceneNodeType::Mesh) &&
          sceneNode->isPickable())
     {